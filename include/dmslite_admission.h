@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_ADMISSION_H
+#define OHOS_DMSLITE_ADMISSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dmsfwk_interface.h"
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/* start requests one caller uid or one remote peer may have queued on the dms task at a time */
+#ifndef DMS_SOURCE_QUOTA
+#define DMS_SOURCE_QUOTA 4
+#endif
+
+/* start requests queued from all sources of one kind, remote starts leave ring room for session events */
+#define DMS_LOCAL_START_LIMIT 16
+#define DMS_REMOTE_START_LIMIT 48
+
+#define DMS_RETRY_AFTER_BASE_MS 200
+#define DMS_RETRY_AFTER_MAX_MS 5000
+
+typedef enum {
+    ADMISSION_LOCAL = 0,
+    ADMISSION_REMOTE,
+    ADMISSION_SOURCE_NUM
+} DmsAdmissionSource;
+
+/**
+* @brief Takes a queue slot for a start request, callable from any thread
+* @param source kind of the caller
+* @param key caller uid for local starts, a hash of the peer networkId for remote starts
+* @return true if admitted, the slot must then be given back with ReleaseAdmission once the request is handled
+*/
+bool AcquireAdmission(DmsAdmissionSource source, int32_t key);
+
+/**
+* @brief Gives back a slot taken by AcquireAdmission, a release without a matching acquire is ignored
+*/
+void ReleaseAdmission(DmsAdmissionSource source, int32_t key);
+
+/**
+* @brief Delay a refused caller should wait, grows with the number of queued start requests
+*/
+uint32_t GetRetryAfterMs();
+
+void GetAdmissionStats(DmsAdmissionSource source, DmsAdmissionStats *stats);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_ADMISSION_H
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_ALLOC_TRACKER_H
+#define OHOS_DMSLITE_ALLOC_TRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dmsfwk_interface.h"
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/*
+ * Instrumentation build only (DMS_ALLOC_TRACKING): DMS_ALLOC and DMS_FREE go through here, every block is
+ * remembered by address in a side table, so the pointers handed out are the ones of the underlying allocator.
+ * Blocks freed outside the dms, as request data released by samgr, are ended with DMS_HANDOFF.
+ */
+#define DMS_ALLOC_MAX_SITES 64
+
+typedef struct {
+    const char *file;
+    uint32_t line;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t bytes;
+    uint32_t liveBytes;
+    uint32_t peakLiveBytes;
+    /* microseconds from DMS_ALLOC to DMS_FREE or DMS_HANDOFF, percentiles above 65 ms share one bucket */
+    DmsLatencyStats lifetimeUs;
+} DmsAllocSiteStats;
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t bytes;
+    uint32_t liveBytes;
+    uint32_t peakLiveBytes;
+    /* the allocator returned NULL */
+    uint32_t failedAllocs;
+    /* blocks not remembered because the side table or the site table was full, they are never counted */
+    uint32_t untrackedAllocs;
+    /* frees of blocks the dms did not allocate itself, like strings handed over by the bms */
+    uint32_t untrackedFrees;
+} DmsAllocTotals;
+
+/**
+* @brief Allocates size bytes and records them against the call site, thread safe
+*/
+void *DmsTrackedAlloc(size_t size, const char *file, uint32_t line);
+
+/**
+* @brief Allocates size bytes from the system heap even in a pool build, and records them like DmsTrackedAlloc
+*/
+void *DmsTrackedSharedAlloc(size_t size, const char *file, uint32_t line);
+
+/**
+* @brief Ends the record of ptr and frees it, ptr may come from another allocator
+*/
+void DmsTrackedFree(void *ptr);
+
+/**
+* @brief Ends the record of ptr without freeing it, for blocks another module releases
+*/
+void DmsTrackHandoff(const void *ptr);
+
+/**
+* @brief Starts a new scenario: counters and lifetimes are cleared, peaks restart from the bytes still live
+*/
+void ResetAllocTracking();
+
+/**
+* @brief Gets the totals since the last reset
+* @return DMS_EC_SUCCESS, or DMS_EC_INVALID_PARAMETER when totals is NULL
+*/
+int32_t GetAllocTotals(DmsAllocTotals *totals);
+
+/**
+* @brief Copies the stats of up to maxNum call sites in the order they first allocated
+* @return the number of sites copied
+*/
+uint16_t GetAllocSites(DmsAllocSiteStats *sites, uint16_t maxNum);
+
+/**
+* @brief Writes the totals and every call site that allocated since the last reset to the log
+*/
+void DumpAllocTracking(const char *scenario);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_ALLOC_TRACKER_H
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_BMS_H
+#define OHOS_DMSLITE_BMS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bundle_info.h"
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/* flags of DmsGetBundleInfo, the permission check needs the signature of the bundle only */
+#define GET_BUNDLE_WITHOUT_ABILITIES 0
+
+/**
+* @brief Gets bundle info through the cached bms proxy, which is re-resolved only when a call fails
+* @return DMS_EC_GET_BUNDLEINFO_FAILURE only when the bundle is not installed, DMS_EC_GET_BMS_FAILURE
+*         when the bms could not answer
+*/
+int32_t DmsGetBundleInfo(const char *bundleName, int32_t flags, BundleInfo *bundleInfo);
+
+/**
+* @brief Gets the bundle name of uid through the cached bms proxy
+* @param bundleName set to an allocated bundle name, released with DMS_FREE
+* @return DmsLiteCommonErrorCode
+*/
+int32_t DmsGetBundleNameForUid(int32_t uid, char **bundleName);
+
+/**
+* @brief Starts fetching the bundle info in the background without blocking the caller
+* @return EC_SUCCESS if the fetch has been queued
+*/
+int32_t PrefetchBundleInfo(const char *bundleName);
+
+/**
+* @brief Takes the prefetched bundle info if its fetch has already finished, never waits for the fetch
+* @return DmsLiteCommonErrorCode of the fetch, or DMS_EC_FAILURE if the bundle has not been prefetched
+*         or is still being fetched, a fetch that has not started yet is dropped then
+*/
+int32_t TakePrefetchedBundleInfo(const char *bundleName, BundleInfo *bundleInfo);
+
+/**
+* @brief Tells whether the fetch of the bundle has finished and its info can be taken
+*/
+bool IsBundleInfoPrefetched(const char *bundleName);
+
+int32_t StartBmsPrefetch();
+void StopBmsPrefetch();
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_BMS_H
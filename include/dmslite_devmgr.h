@@ -16,7 +16,13 @@
 #ifndef OHOS_DMSLITE_DEVMGR_H
 #define OHOS_DMSLITE_DEVMGR_H
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
+
+#include "dmslite_histogram.h"
+#include "softbus_bus_center.h"
+#include "want.h"
 
 #ifdef __cplusplus
 #if __cplusplus
@@ -24,11 +30,222 @@ extern "C" {
 #endif
 #endif
 
+#define MAX_PEER_NUM 16
+#define RTT_SAMPLE_NUM 16
+#define MAX_PEER_BUNDLE_LEN 128
+
+/* a capability request without a response is sent again on a later session after this long */
+#ifndef DMS_CAPABILITY_TIMEOUT_MS
+#define DMS_CAPABILITY_TIMEOUT_MS 10000
+#endif
+
+typedef struct {
+    /* last dms session opened with the peer, -1 if there is none */
+    int32_t sessionId;
+    time_t linkTime;
+    /* callee bundle of the last start request from the peer, prefetched when it opens a session again */
+    char lastBundle[MAX_PEER_BUNDLE_LEN];
+} DmsPeerLink;
+
+typedef enum {
+    CAPABILITY_UNKNOWN = 0,
+    CAPABILITY_REQUESTED,
+    CAPABILITY_KNOWN,
+} DmsCapabilityState;
+
+/* negotiated once per peer, kept until the peer goes offline */
+typedef struct {
+    uint16_t version;
+    uint16_t maxFrameSize;
+    uint32_t features;
+    DmsCapabilityState state;
+    /* while CAPABILITY_REQUESTED: the session the request went out on and the monotonic ms it expires at */
+    int32_t requestSessionId;
+    uint64_t requestDeadline;
+} DmsPeerCapability;
+
+/* send->reply round trip times in milliseconds */
+typedef struct {
+    /* ewma scaled by 8, as the smoothed rtt of tcp */
+    uint32_t scaledEwma;
+    uint32_t samples[RTT_SAMPLE_NUM];
+    uint8_t next;
+    uint8_t sampleNum;
+} DmsPeerRtt;
+
+typedef struct {
+    uint32_t ewma;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint8_t sampleNum;
+} DmsRttStats;
+
+typedef struct {
+    NodeBasicInfo basicInfo;
+    /* stays the same when the networkId of the device changes, empty when the bus center did not report it */
+    char udid[UDID_BUF_LEN];
+    time_t onlineTime;
+    time_t updateTime;
+    DmsPeerLink link;
+    DmsPeerCapability capability;
+    DmsPeerRtt rtt;
+    /* remote starts from the peer refused by the permission check */
+    uint32_t rejectNum;
+    /* monotonic ms until which the peer asked not to be sent start requests, 0 if it never did */
+    uint64_t backoffUntil;
+    /* end-to-end latencies of the requests exchanged with the peer, per side */
+    DmsHistogram latency[DMS_LATENCY_SIDE_NUM];
+} DmsPeerInfo;
+
+/**
+* @brief Visitor of ForEachPeer, runs with the registry locked and must not call back into it
+* @return false to stop the iteration
+*/
+typedef bool (*PeerVisitor)(const DmsPeerInfo *peerInfo, void *context);
+
 int32_t AddDevMgrListener();
 
 int32_t UnRegisterDevMgrListener();
 
-char* GetPeerId();
+/**
+* @brief Adds an online peer to the registry or refreshes its basic info if it is already there
+* @return EC_SUCCESS, or EC_FAILURE when the registry is full
+*/
+int32_t AddPeer(const NodeBasicInfo *info);
+
+/**
+* @brief Adds a peer whose udid is already known, a device registered under another networkId
+*        is moved to the new one and keeps its link, capability and rtt
+* @param udid udid of the device, or an empty string to match the networkId only
+* @return EC_SUCCESS, or EC_FAILURE when the registry is full
+*/
+int32_t AddPeerWithUdid(const NodeBasicInfo *info, const char *udid);
+
+/**
+* @brief Removes an offline peer from the registry
+* @return EC_SUCCESS, or EC_FAILURE when the peer is unknown
+*/
+int32_t RemovePeer(const char *networkId);
+
+/**
+* @brief Applies a basic info change reported by the bus center
+*/
+int32_t UpdatePeer(NodeBasicInfoType type, const NodeBasicInfo *info);
+
+/**
+* @brief Records the dms session currently linked to the peer
+*/
+int32_t UpdatePeerLink(const char *networkId, int32_t sessionId);
+
+/**
+* @brief Records the callee bundle the peer asked to start
+*/
+int32_t SetPeerLastBundle(const char *networkId, const char *bundleName);
+
+/**
+* @brief Gets the callee bundle the peer asked to start last time
+* @return EC_SUCCESS, or EC_FAILURE when the peer is offline or has not started any ability
+*/
+int32_t GetPeerLastBundle(const char *networkId, char *bundleName, uint16_t len);
+
+/**
+* @brief Counts a remote start of the peer refused by the permission check
+*/
+int32_t CountPeerRejection(const char *networkId);
+
+/**
+* @brief Gets how many remote starts of the peer the permission check refused since it came online
+* @return EC_SUCCESS, or EC_FAILURE when the peer is offline
+*/
+int32_t GetPeerRejections(const char *networkId, uint32_t *rejectNum);
+
+/**
+* @brief Writes the refused remote starts of every online peer that had any to the log
+*/
+void DumpPeerRejections();
+
+/**
+* @brief Holds back start requests to the peer after it replied DMS_EC_OVERLOADED
+* @param retryAfterMs delay the peer asked for
+*/
+int32_t SetPeerBackoff(const char *networkId, uint32_t retryAfterMs);
+
+/**
+* @brief Tells whether the peer is still within the delay it asked for
+*/
+bool IsPeerBackingOff(const char *networkId);
+
+/**
+* @brief Claims the capability exchange with the peer, so it is requested only once while the peer is online;
+*        a request unanswered for DMS_CAPABILITY_TIMEOUT_MS may be claimed again
+* @param sessionId session the request is sent on
+* @return true if the caller should send the capability request
+*/
+bool ClaimPeerCapabilityRequest(const char *networkId, int32_t sessionId);
+
+/**
+* @brief Gives up the capability request sent on the session, so the next session with the peer asks again
+*/
+void ReleasePeerCapabilityRequest(int32_t sessionId);
+
+/**
+* @brief Stores the capability reported by the peer
+*/
+int32_t UpdatePeerCapability(const char *networkId, const DmsPeerCapability *capability);
+
+/**
+* @brief Gets the negotiated capability of the peer
+* @return EC_SUCCESS, or EC_FAILURE when the peer is offline or has not reported its capability
+*/
+int32_t GetPeerCapability(const char *networkId, DmsPeerCapability *capability);
+
+/**
+* @brief Adds one send->reply round trip of the peer to its ewma and recent samples
+*/
+int32_t RecordPeerRtt(const char *networkId, uint32_t rttMs);
+
+/**
+* @brief Gets the ewma and percentiles over the recent round trips of the peer
+* @return EC_SUCCESS, or EC_FAILURE when the peer is offline or has no samples
+*/
+int32_t GetPeerRttStats(const char *networkId, DmsRttStats *stats);
+
+/**
+* @brief Adds an end-to-end request latency to the histogram of the peer
+*/
+int32_t RecordPeerLatency(const char *networkId, DmsLatencySide side, uint32_t latencyMs);
+
+/**
+* @brief Gets the latency percentiles of the requests exchanged with the peer
+* @return EC_SUCCESS, EC_INVALID for a bad side, or EC_FAILURE when the peer is offline
+*/
+int32_t GetPeerLatency(const char *networkId, DmsLatencySide side, DmsLatencyStats *stats);
+
+/**
+* @brief Clears the latency histograms of every online peer
+*/
+void ResetPeerLatency();
+
+/**
+* @brief Selects the online peer with the lowest rtt ewma that can run the ability of want,
+*        peers without samples are chosen only when no peer has any, peers backing off are skipped
+* @param networkId buffer receiving the networkId of the selected peer
+* @param len length of networkId, at least NETWORK_ID_BUF_LEN
+* @return EC_SUCCESS, or EC_FAILURE when no peer is online and ready
+*/
+int32_t GetLowestLatencyPeer(const Want *want, char *networkId, uint16_t len);
+
+bool IsPeerOnline(const char *networkId);
+
+/**
+* @brief Copies the registry entry of a peer
+* @return EC_SUCCESS, or EC_FAILURE when the peer is not online
+*/
+int32_t GetPeerInfo(const char *networkId, DmsPeerInfo *peerInfo);
+uint8_t GetOnlinePeerNum();
+void ForEachPeer(PeerVisitor visitor, void *context);
+void ClearPeers();
 
 #ifdef __cplusplus
 #if __cplusplus
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_EVENT_H
+#define OHOS_DMSLITE_EVENT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/* last events kept for a dump, older ones are overwritten */
+#ifndef DMS_EVENT_RING_SIZE
+#define DMS_EVENT_RING_SIZE 128
+#endif
+
+#define DMS_EVENT_LINE_LEN 96
+
+/* the two arguments of each event are given next to it */
+typedef enum {
+    DMS_EVENT_NONE = 0,
+    /* sessionId, frame length */
+    DMS_EVENT_BYTES_RECEIVED,
+    /* tlv error code, frame length */
+    DMS_EVENT_PARSE_DONE,
+    /* node type, node length */
+    DMS_EVENT_TLV_NODE,
+    /* node type, string length including the ending zero */
+    DMS_EVENT_STRING_FIELD,
+    /* command id, sessionId */
+    DMS_EVENT_COMMAND,
+    /* sessionId, dms error code */
+    DMS_EVENT_COMMAND_DONE,
+    /* sessionId, reply error code */
+    DMS_EVENT_REPLY,
+    /* flow id << 16 | old state << 8 | new state, ms since the flow began */
+    DMS_EVENT_FLOW_STATE,
+    DMS_EVENT_ID_NUM
+} DmsEventId;
+
+typedef struct {
+    /* low 32 bits of the monotonic clock in microseconds */
+    uint32_t timeUs;
+    uint16_t id;
+    int32_t arg0;
+    int32_t arg1;
+} DmsEvent;
+
+/**
+* @brief Receives one decoded event line
+*/
+typedef void (*DmsEventSink)(const char *line, void *context);
+
+/**
+* @brief Records an event without formatting or locking, callable from any thread
+*/
+void RecordDmsEvent(DmsEventId id, int32_t arg0, int32_t arg1);
+
+/**
+* @brief Copies the buffered events, oldest first
+* @return number of events copied, at most num
+*/
+uint32_t CopyDmsEvents(DmsEvent *events, uint32_t num);
+
+/**
+* @brief Decodes the buffered events into text, oldest first
+* @param sink receives each line, the lines go to the log when it is NULL
+* @return number of events decoded
+*/
+uint32_t DumpDmsEvents(DmsEventSink sink, void *context);
+
+/**
+* @brief Drops the buffered events, must not race with RecordDmsEvent
+*/
+void ClearDmsEvents();
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_EVENT_H
@@ -29,26 +29,66 @@ extern "C" {
 #endif
 #endif
 
+/* RequestData, its Want, ElementName, CallerInfo, strings and payload share one allocation */
 typedef struct {
     Want *want;
     CallerInfo *callerInfo;
     IDmsListener *callback;
 } RequestData;
 
+/* RemoteStartData, its Want, ElementName and strings share one allocation */
+typedef struct {
+    Want *want;
+    int32_t sessionId;
+    StartAbilityCallback onStartAbilityDone;
+} RemoteStartData;
+
 /**
-* @brief Starts ability from remote
+* @brief Starts ability from remote asynchronously, the result is reported through onStartAbilityDone
 * @param bundleName callee bundle name, e.g. ohos.distributedschedule.helloworld
 * @param abilityName callee ability name, e.g. MainAbility
+* @param sessionId session on which the start request arrived
 * @param onStartAbilityDone called when ability started done
-* @return DmsLiteCommonErrorCode
+* @return DMS_EC_START_ABILITY_ASYNC_SUCCESS if the start has been scheduled, otherwise the failure code
 */
 int32_t StartAbilityFromRemote(const char *bundleName, const char *abilityName,
-    StartAbilityCallback onStartAbilityDone);
+    int32_t sessionId, StartAbilityCallback onStartAbilityDone);
+
+/**
+* @brief Starts the ability scheduled by StartAbilityFromRemote, runs on the dms task
+* @param data packed start request
+*/
+void HandleStartAbilityFromRemote(const RemoteStartData *data);
+
+/* BatchRequestData, its targets, Wants, CallerInfo, strings and payloads share one allocation */
+typedef struct {
+    uint8_t num;
+    DmsBatchTarget *targets;
+    CallerInfo *callerInfo;
+    IDmsBatchListener *callback;
+} BatchRequestData;
 
 int32_t StartRemoteAbility(const Want *want, CallerInfo *callerInfo, IDmsListener *callback);
-void FreeRequestData(const Want *want, CallerInfo *callerInfo);
+void FreeRequestData(RequestData *reqdata);
+
+/**
+* @brief Starts the same or different abilities on several remote devices in parallel
+* @param data packed batch request, identical wants are marshalled only once
+* @return DMS_EC_SUCCESS if the batch has been sent, results are then reported through data->callback,
+*         DMS_EC_OVERLOADED while another batch is still running, only one batch runs at a time
+*/
+int32_t StartRemoteAbilities(const BatchRequestData *data);
+
+/**
+* @brief Reports the same failure for every target of a batch that could not be sent
+* @param data packed batch request
+* @param result failure code
+*/
+void ReportBatchFailure(const BatchRequestData *data, int32_t result);
 int32_t StartRemoteAbilityInner(const Want *want, const CallerInfo *callerInfo,
     const IDmsListener *callback);
+int32_t StartRemoteAbilitiesInner(const DmsBatchTarget *targets, uint8_t num,
+    const CallerInfo *callerInfo, const IDmsBatchListener *callback);
 #ifdef __cplusplus
 #if __cplusplus
 }
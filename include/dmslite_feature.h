@@ -40,7 +40,13 @@ enum DmsMsgType {
     SESSION_CLOSE,
     BYTES_RECEIVED,
     START_REMOTE_ABILITY,
-    START_ABILITY_FROM_REMOTE
+    START_ABILITY_FROM_REMOTE,
+    START_REMOTE_ABILITIES,
+    SESSION_OPEN_FAILED,
+    REMOTE_START_DONE,
+    INGRESS_READY,
+    REMOTE_START_OVERLOADED,
+    FLOW_TIMER
 };
 
 DmsLite *GetDmsLiteFeature();
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_FLOW_H
+#define OHOS_DMSLITE_FLOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dmsfwk_interface.h"
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/* remote starts in progress at a time, a full batch and a few single starts fit together */
+#ifndef DMS_MAX_FLOWS
+#define DMS_MAX_FLOWS 12
+#endif
+
+#ifndef DMS_FLOW_TIMEOUT_MS
+#define DMS_FLOW_TIMEOUT_MS 60000
+#endif
+
+#define INVALID_BATCH_INDEX (-1)
+
+/*
+ * MARSHALLED -> OPENING -> SENT -> AWAITING_REPLY -> DONE, every state before DONE may also end in
+ * FAILED or TIMED_OUT. a flow is released as soon as it reaches one of the three final states
+ */
+typedef enum {
+    FLOW_IDLE = 0,
+    FLOW_MARSHALLED,
+    FLOW_OPENING,
+    FLOW_SENT,
+    FLOW_AWAITING_REPLY,
+    FLOW_DONE,
+    FLOW_FAILED,
+    FLOW_TIMED_OUT,
+    FLOW_STATE_NUM
+} DmsFlowState;
+
+typedef enum {
+    FLOW_EVENT_OPEN = 0,
+    FLOW_EVENT_OPENED,
+    FLOW_EVENT_SEND_DONE,
+    FLOW_EVENT_REPLY,
+    FLOW_EVENT_FAIL,
+    FLOW_EVENT_TIMEOUT,
+    FLOW_EVENT_NUM
+} DmsFlowEvent;
+
+typedef struct DmsFlow DmsFlow;
+
+/**
+* @brief Receives the result of a flow that reached a final state, the flow is already released then
+*        and only its fields may be read
+*/
+typedef void (*FlowDoneCallback)(const DmsFlow *flow, int32_t result);
+
+struct DmsFlow {
+    uint8_t id;
+    DmsFlowState state;
+    int32_t sessionId;
+    int32_t dataType;
+    char *frame;
+    uint16_t frameLen;
+    /* frames shared by several flows of a batch are owned by the batch instead */
+    bool ownsFrame;
+    uint64_t beginMs;
+    uint64_t sendMs;
+    const IDmsListener *listener;
+    int8_t batchIndex;
+    FlowDoneCallback onDone;
+};
+
+/**
+* @brief Takes a flow from the pool in the MARSHALLED state, flows are only touched on the dms task
+* @param frame marshalled start frame, released with the flow if ownsFrame is set
+* @return the flow, or NULL when every flow is in use, the frame is not taken then
+*/
+DmsFlow *CreateFlow(char *frame, uint16_t frameLen, bool ownsFrame, FlowDoneCallback onDone);
+
+/**
+* @brief Moves a flow on by one event, events not valid in the current state are logged and ignored
+* @param result reported to onDone when the event ends the flow, timeouts always report DMS_EC_FAILURE
+* @return true if the event was applied
+*/
+bool AdvanceFlow(DmsFlow *flow, DmsFlowEvent event, int32_t result);
+
+DmsFlow *FindFlowBySession(int32_t sessionId);
+
+/**
+* @brief Times out every flow begun more than DMS_FLOW_TIMEOUT_MS before nowMs
+* @return number of flows timed out
+*/
+uint8_t ExpireFlows(uint64_t nowMs);
+
+/**
+* @brief Gets the time the oldest flow in use times out at
+* @return false when no flow is in use
+*/
+bool GetNextFlowDeadline(uint64_t *deadlineMs);
+
+uint8_t GetActiveFlowNum();
+
+const char *GetFlowStateName(DmsFlowState state);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_FLOW_H
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_HISTOGRAM_H
+#define OHOS_DMSLITE_HISTOGRAM_H
+
+#include <stdint.h>
+
+#include "dmsfwk_interface.h"
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/*
+ * log bucketed: values below 2^SUB_BITS get a bucket each, every power of 2 above is split into
+ * 2^SUB_BITS buckets, so a percentile is at most 1/2^SUB_BITS above the true value
+ */
+#define DMS_HISTOGRAM_SUB_BITS 3
+#define DMS_HISTOGRAM_SUB_NUM (1 << DMS_HISTOGRAM_SUB_BITS)
+/* latencies from 2^MAX_BITS ms on share the last bucket, beyond the timeout of a flow */
+#define DMS_HISTOGRAM_MAX_BITS 16
+#define DMS_HISTOGRAM_BUCKET_NUM ((DMS_HISTOGRAM_MAX_BITS - DMS_HISTOGRAM_SUB_BITS + 1) * DMS_HISTOGRAM_SUB_NUM)
+
+typedef struct {
+    uint32_t counts[DMS_HISTOGRAM_BUCKET_NUM];
+    uint32_t total;
+    uint32_t max;
+} DmsHistogram;
+
+/**
+* @brief Adds a value to a histogram, the caller serializes the access
+*/
+void RecordHistogram(DmsHistogram *histogram, uint32_t value);
+
+/**
+* @brief Reads the percentiles of a histogram, all zero when it is empty
+*/
+void GetHistogramStats(const DmsHistogram *histogram, DmsLatencyStats *stats);
+
+/**
+* @brief Adds a latency to the histogram of a command without locking, callable from any thread
+* @param commandId DmsCommuMsgCmdType, commands without a request-reply exchange are ignored
+*/
+void RecordCommandLatency(uint16_t commandId, DmsLatencySide side, uint32_t latencyMs);
+
+/**
+* @brief Gets the latency percentiles of a command
+* @return DMS_EC_SUCCESS, or DMS_EC_INVALID_PARAMETER when the command or side is not tracked
+*/
+int32_t GetCommandLatency(uint16_t commandId, DmsLatencySide side, DmsLatencyStats *stats);
+
+/**
+* @brief Clears the histograms of all commands, samples recorded meanwhile may be kept or dropped
+*/
+void ResetCommandLatency();
+
+/**
+* @brief Writes the percentiles of every command with samples to the log
+*/
+void DumpCommandLatency();
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_HISTOGRAM_H
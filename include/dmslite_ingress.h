@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_INGRESS_H
+#define OHOS_DMSLITE_INGRESS_H
+
+#include <stdint.h>
+
+#include "dmsfwk_interface.h"
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/* events buffered between the softbus threads and the dms task, independent of the samgr queue size */
+#ifndef DMS_INGRESS_RING_SIZE
+#define DMS_INGRESS_RING_SIZE 64
+#endif
+
+typedef struct {
+    uint16_t msgId;
+    int32_t sessionId;
+    /* allocated with DMS_ALLOC, owned by the ring once pushed */
+    void *data;
+    uint32_t len;
+} DmsIngressEvent;
+
+typedef void (*IngressHandler)(const DmsIngressEvent *event);
+
+/**
+* @brief Pushes an event without locking, callable from any thread; the dms task is woken once per batch
+* @return EC_SUCCESS, or EC_FAILURE when the ring is full and the event is dropped, data is not taken then
+*/
+int32_t PushIngressEvent(uint16_t msgId, int32_t sessionId, void *data, uint32_t len);
+
+/**
+* @brief Hands every buffered event to handler and releases its data, runs on the dms task only
+* @return number of events handled
+*/
+uint32_t DrainIngressEvents(IngressHandler handler);
+
+void GetIngressStats(DmsIngressStats *stats);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_INGRESS_H
@@ -42,9 +42,10 @@ typedef void (*TlvParseCallback) (int8_t errCode, const void *dmsMsg);
 
 /**
 * @brief Callback for starting ability
+* @param sessionId session on which the start request arrived
 * @param errCode indicates the result of starting ability
 */
-typedef void (*StartAbilityCallback) (int8_t errCode);
+typedef void (*StartAbilityCallback) (int32_t sessionId, int8_t errCode);
 
 typedef struct {
     TlvParseCallback onTlvParseDone;
@@ -55,6 +56,8 @@ typedef struct {
     const char* calleeBundleName;
     const char* calleeAbilityName;
     const char* callerSignature;
+    /* SIGNATURE_DIGEST_LEN bytes, set instead of callerSignature by peers of DMS_VERSION_SIGNATURE_DIGEST */
+    const uint8_t* callerDigest;
 } PermissionCheckInfo;
 
 enum IntNumBytes {
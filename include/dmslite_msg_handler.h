@@ -19,7 +19,9 @@
 #include "dmslite_inner_common.h"
 #include "dmslite_tlv_common.h"
 
-int32_t StartAbilityFromRemoteHandler(const TlvNode *tlvHead, StartAbilityCallback onStartAbilityDone);
-int32_t ReplyMsgHandler(const TlvNode *tlvHead);
+int32_t StartAbilityFromRemoteHandler(const TlvNode *tlvHead, int32_t sessionId,
+    StartAbilityCallback onStartAbilityDone);
+int32_t ReplyMsgHandler(const TlvNode *tlvHead, int32_t sessionId);
+int32_t CapabilityMsgHandler(const TlvNode *tlvHead, int32_t sessionId, uint16_t commandId);
 
 #endif // OHOS_DMSLITE_MSG_HANDLER_H
\ No newline at end of file
@@ -37,6 +37,11 @@ bool MarshallInt32(int32_t field, FieldType fieldType);
 bool MarshallInt64(int64_t field, FieldType fieldType);
 bool MarshallString(const char* field, uint8_t type);
 bool MarshallRawData(const void *field, uint8_t type, uint16_t length);
+/**
+* @brief Puts the fixed header in front of the frame built so far, call it once the body is complete
+* @return false if the frame with the header would not fit the packet
+*/
+bool PrependFrameHeader(uint16_t commandId, uint32_t requestId);
 uint16_t GetPacketSize();
 const char* GetPacketBufPtr();
 void CleanBuild();
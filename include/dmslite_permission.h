@@ -36,6 +36,17 @@ extern "C" {
 * @return DmsLiteCommonErrorCode
 */
 int32_t CheckRemotePermission(const PermissionCheckInfo *permissionCheckInfo);
+
+/**
+* @brief Looks up a recent refusal of the same request from the peer, which needs no bms query
+* @return error code of the refusal, or DMS_EC_SUCCESS if the request has to be checked
+*/
+int32_t CheckRemoteDenial(const char *networkId, const PermissionCheckInfo *permissionCheckInfo);
+
+/**
+* @brief Remembers a refused request of the peer for a short time, until a bundle changes at the latest
+*/
+void RecordRemoteDenial(const char *networkId, const PermissionCheckInfo *permissionCheckInfo, int32_t errCode);
 char* GetCallerSignature(const char *remoteName, BundleInfo *bundleInfo);
 char* GetRemoteSignature(const char *remoteName, BundleInfo *bundleInfo);
 
@@ -47,6 +58,44 @@ char* GetRemoteSignature(const char *remoteName, BundleInfo *bundleInfo);
 */
 int32_t GetCallerBundleInfo(const CallerInfo *callerInfo, BundleInfo *bundleInfo);
 
+/**
+* @brief Get caller appId through a bounded uid cache, falling back to GetCallerBundleInfo on a miss
+* @param callerInfo caller information, which includes uid and bundleName
+* @param appId set to the cached appId, which stays valid until the next call
+* @return DmsLiteCommonErrorCode
+*/
+int32_t GetCallerAppId(const CallerInfo *callerInfo, const char **appId);
+
+/**
+* @brief Gets the cached appId of the caller together with its SIGNATURE_DIGEST_LEN bytes sha256 digest
+* @param digest optional, both outputs stay valid until the next caller lookup
+* @return DmsLiteCommonErrorCode
+*/
+int32_t GetCallerAppIdDigest(const CallerInfo *callerInfo, const char **appId, const uint8_t **digest);
+void GetCallerCacheStats(DmsCacheStats *stats);
+
+/**
+* @brief Hit/miss counters of the callee signature cache used by CheckRemotePermission
+*/
+void GetCalleeCacheStats(DmsCacheStats *stats);
+
+/**
+* @brief Starts fetching the callee bundle info ahead of the permission check, skipped if already cached
+*/
+void PrefetchCalleeBundleInfo(const char *calleeBundleName);
+
+/**
+* @brief Drops all cached bundle data, called when a bundle is installed, updated or uninstalled
+*/
+void InvalidatePermissionCache();
+
+/**
+* @brief Loads the native service appIds into a uid-indexed table, lookups after that need no file access
+*/
+void LoadNativeAppIdIndex();
+int32_t AddBundleStatusListener();
+int32_t RemoveBundleStatusListener();
+
 #ifdef __cplusplus
 #if __cplusplus
 }
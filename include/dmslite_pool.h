@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_POOL_H
+#define OHOS_DMSLITE_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/*
+ * Fixed size classes in static arenas, selected with DMS_ALLOC_POOL:
+ * 32 bytes for short strings, 64 and 128 for received messages and outgoing frames, 256 and 1024
+ * for frames with long names or payloads up to the largest frame size.
+ * Larger requests and requests to an exhausted class go to the system heap, as does DMS_ALLOC_SHARED.
+ */
+#define DMS_POOL_CLASS_NUM 5
+
+typedef struct {
+    uint16_t blockSize;
+    uint16_t blockNum;
+    uint16_t inUse;
+    uint16_t peakInUse;
+    uint32_t allocs;
+    /* bytes asked for by the allocs, the rest of their blocks is internal fragmentation */
+    uint32_t requestedBytes;
+    /* allocs sent to the system heap because every block of the class was in use */
+    uint32_t exhausted;
+} DmsPoolClassStats;
+
+typedef struct {
+    DmsPoolClassStats classes[DMS_POOL_CLASS_NUM];
+    /* allocs larger than the largest class */
+    uint32_t oversized;
+    /* frees of blocks outside the arena */
+    uint32_t heapFrees;
+} DmsPoolStats;
+
+/**
+* @brief Takes a block of the smallest class that fits size, in constant time, thread safe
+* @return the block, or memory of the system heap when no class fits or the class is exhausted
+*/
+void *DmsPoolAlloc(size_t size);
+
+/**
+* @brief Returns ptr to its class, or to the system heap when it lies outside the arena
+*/
+void DmsPoolFree(void *ptr);
+
+/**
+* @brief Allocates from the system heap, for blocks another module frees, like request data released by samgr
+*/
+void *DmsHeapAlloc(size_t size);
+
+/**
+* @brief Copies the usage of every class
+*/
+void GetDmsPoolStats(DmsPoolStats *stats);
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_POOL_H
@@ -19,6 +19,8 @@
 #include <stdint.h>
 
 #include "dmsfwk_interface.h"
+#include "dmslite_devmgr.h"
+#include "dmslite_ingress.h"
 
 #ifdef __cplusplus
 #if __cplusplus
@@ -26,17 +28,93 @@ extern "C" {
 #endif
 #endif
 
+typedef struct {
+    const char *deviceId;
+    char *frame;
+    uint16_t frameLen;
+    /* entries sharing a frame point to the same buffer, only one of them owns it */
+    bool ownsFrame;
+} DmsBatchEntry;
+
 int32_t CreateDMSSessionServer();
 int32_t CloseDMSSessionServer();
+
+/**
+* @brief Starts a flow sending data to deviceId, its result is reported through callback
+* @return EC_SUCCESS if the session is being opened, otherwise nothing is reported through callback
+*/
 int32_t SendDmsMessage(const char *data, int32_t len, const char *deviceId, IDmsListener *callback);
-int32_t OpenDMSSession();
-void CloseDMSSession();
-void InvokeCallback(const void *data, int32_t result);
 void HandleSessionClosed(int32_t sessionId);
 int32_t HandleSessionOpened(int32_t sessionId);
+void HandleSessionOpenFailed(int32_t sessionId);
 void HandleBytesReceived(int32_t sessionId, const void *data, uint32_t dataLen);
+
+/**
+* @brief Tells whether every flow is in use, timed out flows are reported and released first
+*/
 bool IsDmsBusy();
 
+/**
+* @brief Times out the flows past their deadline and re-arms the flow timer for the next one, runs on the dms task
+*/
+void ExpireDmsFlows();
+
+/**
+* @brief Opens one session per entry in parallel and sends each its frame once opened
+* @param entries batch entries, the owned frames are taken over and released by the session module
+* @param num number of entries, at most DMS_MAX_BATCH_TARGETS
+* @param callback receives one result per entry and the aggregate result
+* @return EC_SUCCESS if the batch has started, per-entry failures are then reported through callback
+*/
+int32_t SendDmsBatchMessage(DmsBatchEntry *entries, uint8_t num, const IDmsBatchListener *callback);
+
+/**
+* @brief Ends the flow of the session with the reply of the peer, recording the send->reply round trip
+* @return true if a flow was waiting for the reply on the session
+*/
+bool HandleFlowReply(int32_t sessionId, int32_t result);
+
+/**
+* @brief Dispatches a session event buffered by the softbus callbacks, runs on the dms task
+*/
+void HandleIngressEvent(const DmsIngressEvent *event);
+
+/**
+* @brief Sends the result of a start request from remote back to its caller, runs on the dms task
+*/
+void HandleRemoteStartDone(int32_t sessionId, int32_t errCode);
+
+/**
+* @brief Gets the networkId of the peer a session is opened with
+* @return EC_SUCCESS, or EC_FAILURE for an invalid session
+*/
+int32_t GetSessionPeerId(int32_t sessionId, char *networkId, uint16_t len);
+
+/**
+* @brief Sends the local capability, commandId tells whether it is a request or a response
+*/
+int32_t SendDmsCapability(int32_t sessionId, int32_t dataType, uint16_t commandId);
+
+/**
+* @brief Stores the capability reported on the session in the peer registry, answering it if requested
+* @return DmsLiteCommonErrorCode
+*/
+int32_t HandlePeerCapability(int32_t sessionId, const DmsPeerCapability *capability, bool needResponse);
+
+/**
+* @brief Tells whether a batch is still running, only one batch runs at a time
+*/
+bool IsDmsBatchBusy();
+
+/**
+* @brief Selects the softbus data type a flow session is opened in from the frame it carries, softbus refuses
+*        any later send on the session in the other mode
+* @param data marshalled frame
+* @param len length of the frame
+* @return TYPE_MESSAGE for small control frames, otherwise TYPE_BYTES
+*/
+int32_t SelectSessionDataType(const char *data, uint16_t len);
+
 #ifdef __cplusplus
 #if __cplusplus
 }
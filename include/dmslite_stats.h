@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_STATS_H
+#define OHOS_DMSLITE_STATS_H
+
+#include <stdint.h>
+
+#include "dmsfwk_interface.h"
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+typedef enum {
+    DMS_STAT_MESSAGES_IN = 0,
+    DMS_STAT_BYTES_IN,
+    DMS_STAT_MESSAGES_OUT,
+    DMS_STAT_BYTES_OUT,
+    DMS_STAT_PERMISSION_DENIALS,
+    DMS_STAT_BUSY_REJECTIONS,
+    DMS_STAT_TIMEOUTS,
+    DMS_STAT_SESSION_OPENS,
+    DMS_STAT_SESSION_OPEN_FAILURES,
+    DMS_STAT_SESSION_CLOSES,
+    DMS_STAT_REPLY_FAILURES,
+    DMS_STAT_COUNTER_NUM
+} DmsStatCounter;
+
+/**
+* @brief Adds value to a counter with a relaxed atomic add, callable from any thread
+*/
+void AddDmsStat(DmsStatCounter counter, uint32_t value);
+
+/**
+* @brief Counts a frame that failed to parse
+* @param errCode TlvErrorCode of the failure
+*/
+void CountParseError(int32_t errCode);
+
+/**
+* @brief Copies every counter, the counters are read one by one and may be a few events apart
+* @return DMS_EC_SUCCESS, or DMS_EC_INVALID_PARAMETER when stats is NULL
+*/
+int32_t GetDmsStats(DmsStats *stats);
+
+/**
+* @brief Writes the counters and the command latencies to the log
+*/
+void DumpDmsStats();
+
+/**
+* @brief Clears the latency histograms of every command and peer
+*/
+void ResetDmsLatency();
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_STATS_H
@@ -16,6 +16,7 @@
 #ifndef OHOS_DISTRIBUTEDSCHEDULE_TLVCOMMON_H
 #define OHOS_DISTRIBUTEDSCHEDULE_TLVCOMMON_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -28,12 +29,37 @@ extern "C" {
 #define TLV_MAX_LENGTH_BYTES 2
 #define TLV_TYPE_LEN         1
 #define MAX_DMS_MSG_LENGTH   1024
+#define DMS_VERSION_VALUE    202
+/* versions a start frame is encoded with, CALLER_SIGNATURE carries the appId before 201 and its digest after */
+#define DMS_VERSION_LEGACY           200
+#define DMS_VERSION_SIGNATURE_DIGEST 201
+/* peers of this version also take frames that start with the fixed header below */
+#define DMS_VERSION_FIXED_HEADER     202
+#define SIGNATURE_DIGEST_LEN         32
 
+/*
+ * Fixed header, big endian: magic(2) version(1) flags(1) command(2) body length(2) request id(4).
+ * The body is a whole tlv frame, the header lets a frame be checked and dispatched before it is parsed.
+ * Tlv frames start with the COMMAND_ID node, so the magic never begins a frame without the header.
+ */
+#define DMS_FRAME_MAGIC          0x444D
+#define DMS_FRAME_HEADER_VERSION 1
+#define DMS_FRAME_HEADER_LEN     12
+
+/* node types strictly increase within a frame, so this bounds the nodes of a frame as well */
+#define MAX_TLV_NODE_NUM     16
+
+/*
+ * All the nodes of one frame, as offsets into the frame rather than one allocation per node:
+ * five bytes a node, kept in arrays so that a lookup only scans the types.
+ * The frame must outlive it.
+ */
 typedef struct TlvNode {
-    uint8_t type;
-    uint16_t length;
-    const uint8_t *value;
-    struct TlvNode *next;
+    const uint8_t *buffer;
+    uint8_t num;
+    uint8_t types[MAX_TLV_NODE_NUM];
+    uint16_t offsets[MAX_TLV_NODE_NUM];
+    uint16_t lengths[MAX_TLV_NODE_NUM];
 } TlvNode;
 
 typedef enum {
@@ -45,6 +71,7 @@ typedef enum {
     DMS_TLV_ERR_BAD_NODE_NUM = 5,
     DMS_TLV_ERR_UNKNOWN_TYPE = 6,
     DMS_TLV_ERR_BAD_SOURCE = 7,
+    DMS_TLV_ERR_BAD_HEADER = 8,
 } TlvErrorCode;
 
 typedef enum {
@@ -54,19 +81,75 @@ typedef enum {
     CALLEE_ABILITY_NAME = 4,
     CALLER_SIGNATURE = 5,
     CALLER_PAYLOAD = 6,
+    MAX_FRAME_SIZE = 7,
+    FEATURE_FLAGS = 8,
+    /* delay in milliseconds a caller should wait before retrying, sent along DMS_EC_OVERLOADED */
+    RETRY_AFTER = 0xFE,
     REPLY_ERR_CODE = 0xFF
 } FieldType;
 
 typedef struct {
     uint16_t payloadLength;
     const uint8_t *payload;
+    /* session the message arrived on, replies are sent back through it */
+    int32_t sessionId;
 } CommuMessage;
 
+typedef struct {
+    uint8_t version;
+    /* no flag is defined yet, frames setting any are refused */
+    uint8_t flags;
+    uint16_t commandId;
+    uint16_t bodyLength;
+    /* chosen by the sender of a request, the reply carries it back */
+    uint32_t requestId;
+} DmsFrameHeader;
+
 enum DmsCommuMsgCmdType {
     DMS_MSG_CMD_START_FA = 0x01,
+    DMS_MSG_CMD_CAPABILITY_REQUEST = 0x02,
+    DMS_MSG_CMD_CAPABILITY_RESPONSE = 0x03,
     DMS_MSG_CMD_REPLY = 0xFFFF
 };
 
+/* optional protocol features advertised in FEATURE_FLAGS */
+enum DmsFeatureFlag {
+    DMS_FEATURE_COMPRESSION = 0x01,
+    DMS_FEATURE_MULTI_MESSAGE = 0x02,
+};
+
+#define DMS_LOCAL_FEATURES DMS_FEATURE_MULTI_MESSAGE
+
+/**
+* @brief Reads the command id of a marshalled frame without parsing the whole tlv list
+* @param payload marshalled frame, whose first node must be COMMAND_ID, or a frame with the fixed header
+* @param length length of the frame
+* @return command id, or 0 if the frame does not start with a valid COMMAND_ID node or a valid header
+*/
+uint16_t PeekCommandId(const uint8_t *payload, uint16_t length);
+
+/**
+* @brief Tells whether the frame starts with the magic of the fixed header, the header itself is not checked
+*/
+bool HasFrameHeader(const uint8_t *frame, uint16_t length);
+
+/**
+* @brief Reads and checks the fixed header of a frame in constant time
+* @return DMS_TLV_SUCCESS, DMS_TLV_ERR_LEN if the body length does not match the frame or exceeds
+*         MAX_DMS_MSG_LENGTH, or DMS_TLV_ERR_BAD_HEADER for a bad magic, an unknown version or flags
+*/
+TlvErrorCode ReadFrameHeader(const uint8_t *frame, uint16_t length, DmsFrameHeader *header);
+
+/**
+* @brief Writes header into the first DMS_FRAME_HEADER_LEN bytes of buffer, the version and magic are filled in
+* @return false if buffer is shorter than DMS_FRAME_HEADER_LEN
+*/
+bool WriteFrameHeader(const DmsFrameHeader *header, uint8_t *buffer, uint16_t bufferLen);
+
+/**
+* @brief Tells whether the command is one ProcessCommuMsg dispatches
+*/
+bool IsKnownCommand(uint16_t commandId);
 uint8_t UnMarshallUint8(const TlvNode *tlvHead, uint8_t nodeType);
 uint16_t UnMarshallUint16(const TlvNode *tlvHead, uint8_t nodeType);
 uint32_t UnMarshallUint32(const TlvNode *tlvHead, uint8_t nodeType);
@@ -76,6 +159,13 @@ int16_t UnMarshallInt16(const TlvNode *tlvHead, uint8_t nodeType);
 int32_t UnMarshallInt32(const TlvNode *tlvHead, uint8_t nodeType);
 int64_t UnMarshallInt64(const TlvNode *tlvHead, uint8_t nodeType);
 const char* UnMarshallString(const TlvNode *tlvHead, uint8_t nodeType);
+
+/**
+* @brief Gets the value of a node as raw bytes
+* @param length set to the length of the value
+* @return value of the node, or NULL if there is no such node
+*/
+const uint8_t *UnMarshallRawData(const TlvNode *tlvHead, uint8_t nodeType, uint16_t *length);
 #ifdef __cplusplus
 #if __cplusplus
 }
@@ -17,7 +17,13 @@
 #define OHOS_DISTRIBUTEDSCHEDULE_DMSLITE_UTILS_H
 
 #include <stdbool.h>
-#ifdef WEARABLE_PRODUCT
+#include <stdint.h>
+#include <time.h>
+#if defined(DMS_ALLOC_TRACKING)
+#include "dmslite_alloc_tracker.h"
+#elif defined(DMS_ALLOC_POOL)
+#include "dmslite_pool.h"
+#elif defined(WEARABLE_PRODUCT)
 #include "ohos_mem_pool.h"
 #endif
 
@@ -41,6 +47,33 @@
         } \
     } while (0)
 
+#define MS_PER_SECOND 1000
+#define NS_PER_MS 1000000
+
+/* milliseconds of the monotonic clock, 0 when it cannot be read */
+static inline uint64_t GetMonotonicMs()
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        return 0;
+    }
+    return (uint64_t)now.tv_sec * MS_PER_SECOND + (uint64_t)now.tv_nsec / NS_PER_MS;
+}
+
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+
+/* fnv-1a hash of a string of at most maxLen characters */
+static inline uint32_t HashString(const char *str, uint32_t maxLen)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (uint32_t i = 0; i < maxLen && str[i] != '\0'; i++) {
+        hash ^= (uint8_t)str[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
 static inline bool IsBigEndian()
 {
     union {
@@ -51,7 +84,29 @@ static inline bool IsBigEndian()
     return (c.b == 0);
 }
 
-#ifdef WEARABLE_PRODUCT
+#if defined(DMS_ALLOC_TRACKING)
+#define DMS_ALLOC(size) DmsTrackedAlloc((size), __FILE__, __LINE__)
+#define DMS_FREE(a) \
+    do { \
+        if ((a) != NULL) { \
+            DmsTrackedFree((void *)(a)); \
+            (a) = NULL; \
+        } \
+    } while (0)
+#define DMS_ALLOC_SHARED(size) DmsTrackedSharedAlloc((size), __FILE__, __LINE__)
+/* the block is released outside the dms, like request data by samgr once the message is handled */
+#define DMS_HANDOFF(a) DmsTrackHandoff(a)
+#elif defined(DMS_ALLOC_POOL)
+#define DMS_ALLOC(size) DmsPoolAlloc(size)
+#define DMS_FREE(a) \
+    do { \
+        if ((a) != NULL) { \
+            DmsPoolFree((void *)(a)); \
+            (a) = NULL; \
+        } \
+    } while (0)
+#define DMS_ALLOC_SHARED(size) DmsHeapAlloc(size)
+#elif defined(WEARABLE_PRODUCT)
 #define DMS_ALLOC(size) OhosMalloc(MEM_TYPE_APPFMK_LSRAM, size)
 #define DMS_FREE(a) \
     do { \
@@ -71,6 +126,15 @@ static inline bool IsBigEndian()
     } while (0)
 #endif
 
+/* for blocks another module frees, like request data released by samgr, never taken from the pool */
+#ifndef DMS_ALLOC_SHARED
+#define DMS_ALLOC_SHARED(size) DMS_ALLOC(size)
+#endif
+
+#ifndef DMS_HANDOFF
+#define DMS_HANDOFF(a) ((void)(a))
+#endif
+
 /*
  * convert u16 data from Big Endian to Little Endian
  * dataIn: pointer to start of u16 data
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMSLITE_WORKER_H
+#define OHOS_DMSLITE_WORKER_H
+
+#include <stdbool.h>
+
+#include "samgr_lite.h"
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+#define DMS_WORKER_SERVICE "dtbschedsrv_worker"
+
+/**
+* @brief Whether start requests from remote run on a worker task of their own (DMS_MULTI_WORKER),
+*        leaving the dms task to session events, replies and sending
+*/
+bool IsWorkerLaneEnabled();
+
+/**
+* @brief Identity the start requests from remote are posted to, the dms feature when there is no worker lane
+*/
+const Identity *GetStartLaneIdentity();
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMSLITE_WORKER_H
@@ -27,6 +27,7 @@ extern "C" {
 #endif
 #define DISTRIBUTED_SCHEDULE_SERVICE "dtbschedsrv"
 #define DMSLITE_FEATURE "dmslite"
+#define DMS_MAX_BATCH_TARGETS 8
 
 typedef enum {
     DMS_EC_SUCCESS = 0,
@@ -44,6 +45,7 @@ typedef enum {
     DMS_EC_START_ABILITY_ASYNC_FAILURE = 12,
     DMS_EC_FAILURE = 13,
     DMS_EC_INVALID_PARAMETER = 14,
+    DMS_EC_OVERLOADED = 15,
     DMS_REC_UNKNOWN_COMMAND_ID = 29360300,
     DMS_REC_PARSER_TLV_FAIL = 29360301,
     DMS_REC_PERMISSION_DENIED = 29360302,
@@ -54,19 +56,131 @@ typedef enum {
     DMS_REC_FREEINSTALL_FAIL = 29360307,
 } DmsLiteCommonErrorCode;
 
+/* service-level messages of DISTRIBUTED_SCHEDULE_SERVICE */
+typedef enum {
+    /* writes the runtime statistics and the recent trace events to the log */
+    DMS_SERVICE_DUMP_STATS = 1,
+    /* clears the latency histograms of every command and peer */
+    DMS_SERVICE_RESET_LATENCY = 2,
+} DmsServiceMsgType;
+
+/* one counter per tlv error code, index 0 is unused */
+#define DMS_PARSE_ERROR_NUM 9
+
+/* start requests let in or refused by the queue quotas, pending ones are queued right now */
+typedef struct {
+    uint32_t admitted;
+    uint32_t rejected;
+    uint32_t pending;
+} DmsAdmissionStats;
+
+/* lookups served from a permission cache and lookups that had to query the bms */
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+} DmsCacheStats;
+
+/* events handed from the softbus threads to the dms task, dropped ones found the ring full */
+typedef struct {
+    uint32_t pushed;
+    uint32_t dropped;
+    /* most events ever buffered at once */
+    uint32_t highWater;
+    uint32_t wakeups;
+    uint32_t drained;
+} DmsIngressStats;
+
+/* counters since the service started, each one wraps around at UINT32_MAX */
+typedef struct {
+    uint32_t messagesIn;
+    uint32_t bytesIn;
+    uint32_t messagesOut;
+    uint32_t bytesOut;
+    uint32_t parseErrors[DMS_PARSE_ERROR_NUM];
+    uint32_t permissionDenials;
+    /* start requests refused because a queue, quota or the flow pool was full */
+    uint32_t busyRejections;
+    uint32_t timeouts;
+    uint32_t sessionOpens;
+    uint32_t sessionOpenFailures;
+    uint32_t sessionCloses;
+    /* replies to a request of a peer that could not be built or sent */
+    uint32_t replyFailures;
+    /* starts of local callers, counted per caller uid, and of remote peers, counted per networkId */
+    DmsAdmissionStats localStarts;
+    DmsAdmissionStats remoteStarts;
+    /* appIds of local callers and signatures of local callees */
+    DmsCacheStats callerCache;
+    DmsCacheStats calleeCache;
+    DmsIngressStats ingress;
+} DmsStats;
+
+typedef enum {
+    /* from the start request being made here to the reply of the peer */
+    DMS_LATENCY_CALLER = 0,
+    /* from the request of a peer arriving here to the reply being sent back */
+    DMS_LATENCY_CALLEE,
+    DMS_LATENCY_SIDE_NUM
+} DmsLatencySide;
+
+/* latencies in milliseconds, percentiles are the upper bound of their histogram bucket */
+typedef struct {
+    uint32_t count;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;
+} DmsLatencyStats;
+
 typedef struct {
     void (*OnResultCallback)(const void *data, int32_t ret);
 } IDmsListener;
 
+typedef struct {
+    /* index is the position of the target in the batch, ret is the result of that device */
+    void (*OnDeviceResult)(uint8_t index, int32_t ret);
+    /* called once after every device of the batch has reported its result */
+    void (*OnBatchResult)(uint8_t successNum, uint8_t totalNum);
+} IDmsBatchListener;
+
 typedef struct {
     int32_t uid;
     char* bundleName;
 } CallerInfo;
 
+typedef struct {
+    const char *deviceId;
+    const Want *want;
+} DmsBatchTarget;
+
 typedef struct {
     INHERIT_IUNKNOWN;
     int32_t (*StartRemoteAbility)(const Want *want, const CallerInfo *callerInfo,
         const IDmsListener *callback);
+    /*
+     * starts abilities on up to DMS_MAX_BATCH_TARGETS devices at once, callback must outlive the batch.
+     * only one batch runs at a time, a batch started before the last one ends gets DMS_EC_OVERLOADED
+     */
+    int32_t (*StartRemoteAbilities)(const DmsBatchTarget *targets, uint8_t num,
+        const CallerInfo *callerInfo, const IDmsBatchListener *callback);
+    /*
+     * gets the online peer with the lowest reply latency for want, networkId needs at least 65 bytes.
+     * returns DMS_EC_INVALID_PARAMETER for a short buffer and DMS_EC_FAILURE when no peer is ready
+     */
+    int32_t (*GetLowestLatencyPeer)(const Want *want, char *networkId, uint16_t len);
+    /* copies a snapshot of the runtime statistics, callable from any thread */
+    int32_t (*GetStats)(DmsStats *stats);
+    /* gets the latency percentiles of one command type, commandId is a DmsCommuMsgCmdType */
+    int32_t (*GetCommandLatency)(uint16_t commandId, DmsLatencySide side, DmsLatencyStats *stats);
+    /*
+     * gets the latency percentiles of all commands exchanged with one online peer,
+     * DMS_EC_FAILURE when the peer is offline
+     */
+    int32_t (*GetPeerLatency)(const char *networkId, DmsLatencySide side, DmsLatencyStats *stats);
+    /* gets how many remote starts of one online peer the permission check refused, DMS_EC_FAILURE if offline */
+    int32_t (*GetPeerRejections)(const char *networkId, uint32_t *rejectNum);
+    /* clears the latency histograms, recording goes on */
+    void (*ResetLatency)(void);
 } DmsProxy;
 
 #ifdef __cplusplus
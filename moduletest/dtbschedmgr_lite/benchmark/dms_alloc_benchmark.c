@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays the allocations of remote starts, as the memory benchmark reports them, on every DMS_ALLOC backend:
+ * the request and the reply are each received into a message that is gone once parsed, while the frame sent
+ * for the start lives until `window` later starts are in flight.
+ * Reports the time per alloc and free pair and how much of the memory taken is wasted.
+ * usage: dms_alloc_benchmark [-n starts] [-w starts in flight]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "dmslite_pool.h"
+#ifdef WEARABLE_PRODUCT
+#include "ohos_mem_pool.h"
+#endif
+
+#define DEFAULT_START_NUM 100000
+#define DEFAULT_WINDOW 8
+#define MAX_WINDOW 64
+#define MAX_START_NUM 10000000
+#define MESSAGES_PER_START 2
+#define MESSAGE_SIZE 48
+#define FRAME_SIZE 83
+#define LARGE_FRAME_SIZE 1024
+/* one start in this many carries a payload up to the largest frame */
+#define LARGE_FRAME_PERIOD 16
+#define ALLOCS_PER_START (MESSAGES_PER_START + 1)
+#define NS_PER_SECOND 1000000000ULL
+#define PERCENT_50 50
+#define PERCENT_99 99
+#define PERCENT_BASE 100
+#define DECIMAL_BASE 10
+
+typedef struct {
+    const char *name;
+    void *(*alloc)(size_t size);
+    void (*release)(void *ptr);
+} AllocBackend;
+
+static void *SystemAlloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void SystemFree(void *ptr)
+{
+    free(ptr);
+}
+
+#ifdef WEARABLE_PRODUCT
+static void *LsramAlloc(size_t size)
+{
+    return OhosMalloc(MEM_TYPE_APPFMK_LSRAM, size);
+}
+
+static void LsramFree(void *ptr)
+{
+    (void)OhosFree(ptr);
+}
+#endif
+
+static const AllocBackend g_backends[] = {
+    { "malloc", SystemAlloc, SystemFree },
+#ifdef WEARABLE_PRODUCT
+    { "OhosMalloc", LsramAlloc, LsramFree },
+#endif
+    { "pool", DmsPoolAlloc, DmsPoolFree },
+};
+
+#define BACKEND_NUM (sizeof(g_backends) / sizeof(g_backends[0]))
+
+static uint64_t GetNowNs()
+{
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NS_PER_SECOND + (uint64_t)now.tv_nsec;
+}
+
+static void ReplayMessage(const AllocBackend *backend)
+{
+    backend->release(backend->alloc(MESSAGE_SIZE));
+}
+
+/* the frame of the start `window` starts ago is answered and released when this start sends its own */
+static void ReplayStart(const AllocBackend *backend, uint32_t start, void **frame)
+{
+    ReplayMessage(backend);
+    backend->release(*frame);
+    *frame = backend->alloc((start % LARGE_FRAME_PERIOD == 0) ? LARGE_FRAME_SIZE : FRAME_SIZE);
+    ReplayMessage(backend);
+}
+
+static int CompareSample(const void *left, const void *right)
+{
+    uint32_t l = *(const uint32_t *)left;
+    uint32_t r = *(const uint32_t *)right;
+    return (l > r) - (l < r);
+}
+
+static uint32_t GetPercentile(const uint32_t *sorted, uint32_t num, uint8_t percent)
+{
+    uint64_t rank = ((uint64_t)percent * num + PERCENT_BASE - 1) / PERCENT_BASE;
+    return sorted[(rank == 0) ? 0 : rank - 1];
+}
+
+static void PrintHeapUsage(uint32_t requestedLive)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    printf("  heap with the last frames in flight: %zu bytes held for %u requested, %zu bytes free inside it\n",
+        info.uordblks, requestedLive, info.fordblks);
+#else
+    (void)requestedLive;
+#endif
+}
+
+static void PrintPoolUsage()
+{
+    DmsPoolStats stats;
+    GetDmsPoolStats(&stats);
+    uint32_t footprint = 0;
+    for (uint8_t i = 0; i < DMS_POOL_CLASS_NUM; i++) {
+        const DmsPoolClassStats *poolClass = &stats.classes[i];
+        footprint += (uint32_t)poolClass->blockSize * poolClass->blockNum;
+        uint64_t taken = (uint64_t)poolClass->allocs * poolClass->blockSize;
+        printf("  class %u: %u of %u blocks at peak, %u allocs, %llu%% of the block bytes unused, %u to the heap\n",
+            poolClass->blockSize, poolClass->peakInUse, poolClass->blockNum, poolClass->allocs,
+            (unsigned long long)((taken == 0) ? 0 : (taken - poolClass->requestedBytes) * PERCENT_BASE / taken),
+            poolClass->exhausted);
+    }
+    printf("  arena %u bytes, %u oversized allocs\n", footprint, stats.oversized);
+}
+
+static int32_t RunBackend(const AllocBackend *backend, uint32_t startNum, uint32_t window)
+{
+    void *frames[MAX_WINDOW] = {NULL};
+    uint32_t *samples = (uint32_t *)calloc(startNum, sizeof(uint32_t));
+    if (samples == NULL) {
+        return -1;
+    }
+    uint64_t beginNs = GetNowNs();
+    for (uint32_t start = 0; start < startNum; start++) {
+        uint64_t startBeginNs = GetNowNs();
+        ReplayStart(backend, start, &frames[start % window]);
+        samples[start] = (uint32_t)((GetNowNs() - startBeginNs) / ALLOCS_PER_START);
+    }
+    uint64_t elapsedNs = GetNowNs() - beginNs;
+
+    qsort(samples, startNum, sizeof(uint32_t), CompareSample);
+    printf("%s: p50 %u ns, p99 %u ns per alloc and free, %llu starts per second\n", backend->name,
+        GetPercentile(samples, startNum, PERCENT_50), GetPercentile(samples, startNum, PERCENT_99),
+        (unsigned long long)((elapsedNs == 0) ? 0 : (uint64_t)startNum * NS_PER_SECOND / elapsedNs));
+    if (backend->alloc == SystemAlloc) {
+        uint32_t requestedLive = 0;
+        for (uint32_t start = (startNum > window) ? startNum - window : 0; start < startNum; start++) {
+            requestedLive += (start % LARGE_FRAME_PERIOD == 0) ? LARGE_FRAME_SIZE : FRAME_SIZE;
+        }
+        PrintHeapUsage(requestedLive);
+    } else if (backend->alloc == DmsPoolAlloc) {
+        PrintPoolUsage();
+    }
+    for (uint32_t i = 0; i < window; i++) {
+        backend->release(frames[i]);
+    }
+    free(samples);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t startNum = DEFAULT_START_NUM;
+    uint32_t window = DEFAULT_WINDOW;
+    int option;
+    while ((option = getopt(argc, argv, "n:w:")) != -1) {
+        unsigned long value = strtoul(optarg, NULL, DECIMAL_BASE);
+        if (option == 'n') {
+            startNum = (uint32_t)value;
+        } else if (option == 'w') {
+            window = (uint32_t)value;
+        } else {
+            startNum = 0;
+        }
+    }
+    if (startNum == 0 || startNum > MAX_START_NUM || window == 0 || window > MAX_WINDOW) {
+        printf("usage: %s [-n starts] [-w starts in flight, at most %d]\n", argv[0], MAX_WINDOW);
+        return EXIT_FAILURE;
+    }
+    for (uint8_t i = 0; i < BACKEND_NUM; i++) {
+        if (RunBackend(&g_backends[i], startNum, window) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * StartRemoteAbility -> frame over the loopback link -> callee ProcessCommuMsg and ability start -> reply,
+ * timed end to end one start after the other.
+ * Built with DMS_ALLOC_TRACKING, the warm-up and the steady starts are reported as two scenarios with their
+ * allocations per call site, and the steady one fails when it allocates more than the budget per start.
+ * The link reports the delay of the frames sent in bytes mode and in message mode apart, a start frame and
+ * its reply both go in bytes mode, the mode of their session. -B and -M add a configured cost to every frame
+ * of a mode, the loopback does not model the modes otherwise, so a difference between them is the configured one.
+ * usage: start_remote_ability_benchmark [-n starts] [-l one-way latency us] [-b bandwidth bytes per second]
+ *     [-m budget bytes per start] [-B bytes mode us per frame] [-M message mode us per frame]
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dms_loopback.h"
+#include "dmsfwk_interface.h"
+#ifdef DMS_ALLOC_TRACKING
+#include "dmslite_alloc_tracker.h"
+#endif
+#include "dmslite_inner_common.h"
+#include "dmslite_tlv_common.h"
+#include "samgr_lite.h"
+
+#define DEFAULT_START_NUM 1000
+#define DEFAULT_LATENCY_US 1000
+#define MAX_START_NUM 1000000
+#define REPLY_TIMEOUT_SECONDS 5
+#define BENCHMARK_CALLER_UID 10000
+#define US_PER_SECOND 1000000
+#define NS_PER_US 1000
+#define PERCENT_50 50
+#define PERCENT_90 90
+#define PERCENT_99 99
+#define PERCENT_BASE 100
+#define DECIMAL_BASE 10
+
+typedef struct {
+    uint32_t startNum;
+    LoopbackLinkConfig link;
+    /* bytes allocated per steady start, 0 for no check */
+    uint32_t allocBudget;
+} BenchmarkConfig;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool done;
+    int32_t result;
+} StartResult;
+
+static StartResult g_result = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void OnResult(const void *data, int32_t ret)
+{
+    (void)data;
+    pthread_mutex_lock(&g_result.lock);
+    g_result.done = true;
+    g_result.result = ret;
+    pthread_cond_signal(&g_result.cond);
+    pthread_mutex_unlock(&g_result.lock);
+}
+
+static IDmsListener g_listener = {
+    .OnResultCallback = OnResult
+};
+
+static uint64_t GetNowUs()
+{
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * US_PER_SECOND + (uint64_t)now.tv_nsec / NS_PER_US;
+}
+
+static bool ParseArgs(int argc, char *argv[], BenchmarkConfig *config)
+{
+    int option;
+    while ((option = getopt(argc, argv, "n:l:b:m:B:M:")) != -1) {
+        unsigned long value = strtoul(optarg, NULL, DECIMAL_BASE);
+        switch (option) {
+            case 'n':
+                config->startNum = (uint32_t)value;
+                break;
+            case 'l':
+                config->link.latencyUs = (uint32_t)value;
+                break;
+            case 'b':
+                config->link.bandwidth = (uint32_t)value;
+                break;
+            case 'm':
+                config->allocBudget = (uint32_t)value;
+                break;
+            case 'B':
+                config->link.bytesFrameUs = (uint32_t)value;
+                break;
+            case 'M':
+                config->link.messageFrameUs = (uint32_t)value;
+                break;
+            default:
+                return false;
+        }
+    }
+    return config->startNum > 0 && config->startNum <= MAX_START_NUM;
+}
+
+static DmsProxy *GetDmsProxy()
+{
+    IUnknown *iUnknown = SAMGR_GetInstance()->GetFeatureApi(DISTRIBUTED_SCHEDULE_SERVICE, DMSLITE_FEATURE);
+    DmsProxy *proxy = NULL;
+    if (iUnknown == NULL || iUnknown->QueryInterface(iUnknown, DEFAULT_VERSION, (void **)&proxy) != EC_SUCCESS) {
+        return NULL;
+    }
+    return proxy;
+}
+
+/* returns the result reported to the listener, or DMS_EC_FAILURE when no reply came in time */
+static int32_t StartOnce(DmsProxy *proxy, const Want *want, const CallerInfo *callerInfo)
+{
+    pthread_mutex_lock(&g_result.lock);
+    g_result.done = false;
+    pthread_mutex_unlock(&g_result.lock);
+    int32_t ret = proxy->StartRemoteAbility(want, callerInfo, &g_listener);
+    if (ret != DMS_EC_SUCCESS) {
+        return ret;
+    }
+    struct timespec deadline;
+    (void)clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += REPLY_TIMEOUT_SECONDS;
+    pthread_mutex_lock(&g_result.lock);
+    while (!g_result.done) {
+        if (pthread_cond_timedwait(&g_result.cond, &g_result.lock, &deadline) != 0) {
+            break;
+        }
+    }
+    ret = g_result.done ? g_result.result : DMS_EC_FAILURE;
+    pthread_mutex_unlock(&g_result.lock);
+    return ret;
+}
+
+static int CompareSample(const void *left, const void *right)
+{
+    uint64_t l = *(const uint64_t *)left;
+    uint64_t r = *(const uint64_t *)right;
+    return (l > r) - (l < r);
+}
+
+static uint64_t GetPercentile(const uint64_t *sorted, uint32_t num, uint8_t percent)
+{
+    uint64_t rank = ((uint64_t)percent * num + PERCENT_BASE - 1) / PERCENT_BASE;
+    return sorted[(rank == 0) ? 0 : rank - 1];
+}
+
+static void PrintDmsLatency(DmsProxy *proxy, DmsLatencySide side, const char *name)
+{
+    DmsLatencyStats stats;
+    if (proxy->GetCommandLatency(DMS_MSG_CMD_START_FA, side, &stats) == DMS_EC_SUCCESS && stats.count > 0) {
+        printf("dms %s side: %u samples, p50 %u ms, p90 %u ms, p99 %u ms, max %u ms\n", name, stats.count,
+            stats.p50, stats.p90, stats.p99, stats.max);
+    }
+}
+
+static void PrintDmsAdmission(DmsProxy *proxy)
+{
+    DmsStats stats;
+    if (proxy->GetStats(&stats) != DMS_EC_SUCCESS) {
+        return;
+    }
+    printf("dms remote starts: %u admitted, %u rejected, %u pending\n", stats.remoteStarts.admitted,
+        stats.remoteStarts.rejected, stats.remoteStarts.pending);
+}
+
+static void PrintModeDelay(const LoopbackModeStats *stats, const char *name, char option)
+{
+    if (stats->frames == 0) {
+        return;
+    }
+    printf("%s mode: %u frames, mean %llu us, max %u us from send to delivery, "
+        "%u us per frame configured with -%c, not measured\n", name, stats->frames,
+        (unsigned long long)(stats->totalUs / stats->frames), stats->maxUs, stats->frameUs, option);
+}
+
+static void PrintReport(DmsProxy *proxy, uint64_t *samples, uint32_t okNum, uint32_t failNum, uint64_t elapsedUs)
+{
+    printf("%u starts succeeded, %u failed in %llu us\n", okNum, failNum, (unsigned long long)elapsedUs);
+    if (okNum > 0) {
+        qsort(samples, okNum, sizeof(uint64_t), CompareSample);
+        printf("end to end: p50 %llu us, p90 %llu us, p99 %llu us, max %llu us, %llu starts per second\n",
+            (unsigned long long)GetPercentile(samples, okNum, PERCENT_50),
+            (unsigned long long)GetPercentile(samples, okNum, PERCENT_90),
+            (unsigned long long)GetPercentile(samples, okNum, PERCENT_99),
+            (unsigned long long)samples[okNum - 1],
+            (unsigned long long)((elapsedUs == 0) ? 0 : (uint64_t)okNum * US_PER_SECOND / elapsedUs));
+    }
+    PrintDmsLatency(proxy, DMS_LATENCY_CALLER, "caller");
+    PrintDmsLatency(proxy, DMS_LATENCY_CALLEE, "callee");
+    PrintDmsAdmission(proxy);
+    LoopbackStats stats;
+    GetLoopbackStats(&stats);
+    printf("link: %u sessions, %u frames, %u bytes, %u abilities started, %u sends refused\n", stats.sessionOpens,
+        stats.framesSent, stats.bytesSent, stats.abilityStarts, stats.refusedSends);
+    PrintModeDelay(&stats.bytesMode, "bytes", 'B');
+    PrintModeDelay(&stats.messageMode, "message", 'M');
+}
+
+#ifdef DMS_ALLOC_TRACKING
+static void PrintAllocSites()
+{
+    DmsAllocSiteStats sites[DMS_ALLOC_MAX_SITES];
+    uint16_t num = GetAllocSites(sites, DMS_ALLOC_MAX_SITES);
+    for (uint16_t i = 0; i < num; i++) {
+        const DmsAllocSiteStats *site = &sites[i];
+        if (site->allocs == 0 && site->liveBytes == 0) {
+            continue;
+        }
+        const char *file = strrchr(site->file, '/');
+        printf("  %s:%u: %u allocs (%u bytes), %u frees, %u live, peak %u, lifetime p50 %u p99 %u max %u us\n",
+            (file != NULL) ? file + 1 : site->file, site->line, site->allocs, site->bytes, site->frees,
+            site->liveBytes, site->peakLiveBytes, site->lifetimeUs.p50, site->lifetimeUs.p99, site->lifetimeUs.max);
+    }
+}
+#endif
+
+/* reports the allocations since the previous scenario and starts the next one */
+static bool ReportScenario(const char *scenario, uint32_t startNum, uint32_t allocBudget)
+{
+#ifdef DMS_ALLOC_TRACKING
+    DmsAllocTotals totals;
+    (void)GetAllocTotals(&totals);
+    uint32_t perStart = (startNum == 0) ? 0 : totals.bytes / startNum;
+    printf("%s: %u allocs (%u bytes, %u per start), %u frees, %u bytes live, peak %u bytes\n", scenario,
+        totals.allocs, totals.bytes, perStart, totals.frees, totals.liveBytes, totals.peakLiveBytes);
+    if (totals.failedAllocs != 0 || totals.untrackedAllocs != 0) {
+        printf("%s: %u failed and %u untracked allocs\n", scenario, totals.failedAllocs, totals.untrackedAllocs);
+    }
+    PrintAllocSites();
+    DumpAllocTracking(scenario);
+    ResetAllocTracking();
+    if (allocBudget != 0 && perStart > allocBudget) {
+        printf("%s: %u bytes per start is over the budget of %u\n", scenario, perStart, allocBudget);
+        return false;
+    }
+#else
+    (void)scenario;
+    (void)startNum;
+    (void)allocBudget;
+#endif
+    return true;
+}
+
+static int32_t RunBenchmark(DmsProxy *proxy, uint32_t startNum, uint32_t allocBudget)
+{
+    char deviceId[] = LOOPBACK_NETWORK_ID;
+    char bundleName[] = "com.ohos.loopback.callee";
+    char abilityName[] = "MainAbility";
+    ElementName element = {
+        .deviceId = deviceId,
+        .bundleName = bundleName,
+        .abilityName = abilityName
+    };
+    Want want = {
+        .element = &element
+    };
+    char callerBundle[] = LOOPBACK_CALLER_BUNDLE;
+    CallerInfo callerInfo = {
+        .uid = BENCHMARK_CALLER_UID,
+        .bundleName = callerBundle
+    };
+    /* the first start also negotiates the capability of the peer and fills the bundle caches */
+    int32_t ret = StartOnce(proxy, &want, &callerInfo);
+    if (ret != DMS_EC_SUCCESS) {
+        printf("warm-up start failed, errCode = %d\n", ret);
+        return ret;
+    }
+    (void)ReportScenario("warm-up", 1, 0);
+    proxy->ResetLatency();
+
+    uint64_t *samples = (uint64_t *)calloc(startNum, sizeof(uint64_t));
+    if (samples == NULL) {
+        return DMS_EC_FAILURE;
+    }
+    uint32_t okNum = 0;
+    uint32_t failNum = 0;
+    uint64_t beginUs = GetNowUs();
+    for (uint32_t i = 0; i < startNum; i++) {
+        uint64_t startUs = GetNowUs();
+        if (StartOnce(proxy, &want, &callerInfo) == DMS_EC_SUCCESS) {
+            samples[okNum++] = GetNowUs() - startUs;
+        } else {
+            failNum++;
+        }
+    }
+    uint64_t elapsedUs = GetNowUs() - beginUs;
+    bool withinBudget = ReportScenario("steady", okNum, allocBudget);
+    PrintReport(proxy, samples, okNum, failNum, elapsedUs);
+    free(samples);
+    return (failNum == 0 && withinBudget) ? DMS_EC_SUCCESS : DMS_EC_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchmarkConfig config = {
+        .startNum = DEFAULT_START_NUM,
+        .link = { .latencyUs = DEFAULT_LATENCY_US, .bandwidth = 0 },
+        .allocBudget = 0
+    };
+    if (!ParseArgs(argc, argv, &config)) {
+        printf("usage: %s [-n starts] [-l one-way latency us] [-b bandwidth bytes per second] "
+            "[-m budget bytes per start] [-B bytes mode us per frame] [-M message mode us per frame]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    /* the dms only handles frames and queries the bms when it runs as foundation or as the shell */
+    if (getuid() != SHELL_UID) {
+        printf("run the benchmark as uid %d\n", SHELL_UID);
+        return EXIT_FAILURE;
+    }
+    if (StartLoopback(&config.link) != 0) {
+        printf("loopback start failed\n");
+        return EXIT_FAILURE;
+    }
+    DmsProxy *proxy = GetDmsProxy();
+    int32_t ret = (proxy != NULL) ? RunBenchmark(proxy, config.startNum, config.allocBudget) : DMS_EC_FAILURE;
+    StopLoopback();
+    return (ret == DMS_EC_SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dms_loopback.h"
+
+#include <stddef.h>
+
+#define LOOPBACK_ERR (-1)
+
+int32_t StartLoopback(const LoopbackLinkConfig *config)
+{
+    if (config == NULL) {
+        return LOOPBACK_ERR;
+    }
+    /* the link comes first, the dms may open sessions as soon as its task runs */
+    if (StartLoopbackLink(config) != 0) {
+        return LOOPBACK_ERR;
+    }
+    if (StartLoopbackSamgr() != 0) {
+        StopLoopbackLink();
+        return LOOPBACK_ERR;
+    }
+    return 0;
+}
+
+void StopLoopback()
+{
+    StopLoopbackSamgr();
+    StopLoopbackLink();
+}
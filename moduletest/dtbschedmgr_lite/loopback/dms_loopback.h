@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OHOS_DMS_LOOPBACK_H
+#define OHOS_DMS_LOOPBACK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif
+
+/*
+ * In-process stand-ins for the softbus session and bus center api, the bms client, the ability manager and
+ * samgr request delivery, linked instead of the real libraries.
+ * The dms keeps its state in globals, so one instance plays both the caller and the callee: the session it
+ * opens to LOOPBACK_NETWORK_ID is paired with a second session that is reported to the same listener as if a
+ * peer had opened it, and every frame sent on one side is received on the other after the link delay.
+ */
+#define LOOPBACK_NETWORK_ID "loopback"
+#define LOOPBACK_DEVICE_NAME "loopback device"
+#define LOOPBACK_UDID "loopback_udid"
+/* every bundle is signed with this, so the signature of any caller matches any callee */
+#define LOOPBACK_SIGNATURE "loopback_signature"
+#define LOOPBACK_CALLER_BUNDLE "com.ohos.loopback.caller"
+
+typedef struct {
+    /* one-way delay of every frame and session event */
+    uint32_t latencyUs;
+    /* bytes per second, frames queue behind each other on the link, 0 for no limit */
+    uint32_t bandwidth;
+    /* extra time every frame of SendBytes and of SendMessage takes on the link, the two modes may differ */
+    uint32_t bytesFrameUs;
+    uint32_t messageFrameUs;
+} LoopbackLinkConfig;
+
+/* frames of one session mode, timed from the send call to their delivery to the listener */
+typedef struct {
+    uint32_t frames;
+    uint64_t totalUs;
+    uint32_t maxUs;
+    /* the configured extra time of the mode, included in every frame above but not measured */
+    uint32_t frameUs;
+} LoopbackModeStats;
+
+typedef struct {
+    uint32_t sessionOpens;
+    uint32_t framesSent;
+    uint32_t bytesSent;
+    uint32_t abilityStarts;
+    /* sends on a closed session or in the mode the session was not opened in */
+    uint32_t refusedSends;
+    LoopbackModeStats bytesMode;
+    LoopbackModeStats messageMode;
+} LoopbackStats;
+
+/**
+* @brief Initializes the registered samgr services and features, starts their tasks and the link
+* @return 0, or -1 when a task cannot be started
+*/
+int32_t StartLoopback(const LoopbackLinkConfig *config);
+
+/**
+* @brief Stops the tasks and the link, frames still in flight are dropped
+*/
+void StopLoopback();
+
+/**
+* @brief Changes the link delay for the frames sent from now on
+*/
+void SetLoopbackLink(const LoopbackLinkConfig *config);
+
+void GetLoopbackStats(LoopbackStats *stats);
+
+/* internal to the stand-ins */
+int32_t StartLoopbackLink(const LoopbackLinkConfig *config);
+void StopLoopbackLink();
+int32_t StartLoopbackSamgr();
+void StopLoopbackSamgr();
+void CountAbilityStart();
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif
+
+#endif // OHOS_DMS_LOOPBACK_H
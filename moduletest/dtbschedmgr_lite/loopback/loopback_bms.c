@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dms_loopback.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ability_manager.h"
+#include "bundle_manager.h"
+#include "ohos_errno.h"
+#include "securec.h"
+
+/* the bms reports failures as a non-zero uint8_t */
+#define BMS_ERR 1
+
+static char *CopyString(const char *source)
+{
+    size_t len = strlen(source) + 1;
+    char *copy = (char *)malloc(len);
+    if (copy != NULL && strcpy_s(copy, len, source) != EOK) {
+        free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+/*
+ * the dms sends the whole appId of the caller as its signature and compares it with the part of the callee
+ * appId after bundleName + "_", so the caller bundle has the bare signature as its appId
+ */
+static char *MakeAppId(const char *bundleName)
+{
+    if (strcmp(bundleName, LOOPBACK_CALLER_BUNDLE) == 0) {
+        return CopyString(LOOPBACK_SIGNATURE);
+    }
+    size_t len = strlen(bundleName) + sizeof("_") + strlen(LOOPBACK_SIGNATURE);
+    char *appId = (char *)malloc(len);
+    if (appId != NULL && sprintf_s(appId, len, "%s_%s", bundleName, LOOPBACK_SIGNATURE) < 0) {
+        free(appId);
+        return NULL;
+    }
+    return appId;
+}
+
+/* every bundle is installed and signed by the same developer */
+uint8_t GetBundleInfo(const char *bundleName, int32_t flags, BundleInfo *bundleInfo)
+{
+    (void)flags;
+    if (bundleName == NULL || bundleInfo == NULL) {
+        return BMS_ERR;
+    }
+    (void)memset_s(bundleInfo, sizeof(BundleInfo), 0x00, sizeof(BundleInfo));
+    bundleInfo->bundleName = CopyString(bundleName);
+    bundleInfo->appId = MakeAppId(bundleName);
+    if (bundleInfo->bundleName == NULL || bundleInfo->appId == NULL) {
+        ClearBundleInfo(bundleInfo);
+        return BMS_ERR;
+    }
+    return EC_SUCCESS;
+}
+
+uint8_t GetBundleNameForUid(int32_t uid, char **bundleName)
+{
+    (void)uid;
+    if (bundleName == NULL) {
+        return BMS_ERR;
+    }
+    *bundleName = CopyString(LOOPBACK_CALLER_BUNDLE);
+    return (*bundleName != NULL) ? EC_SUCCESS : BMS_ERR;
+}
+
+void ClearBundleInfo(BundleInfo *bundleInfo)
+{
+    if (bundleInfo == NULL) {
+        return;
+    }
+    free(bundleInfo->bundleName);
+    free(bundleInfo->appId);
+    bundleInfo->bundleName = NULL;
+    bundleInfo->appId = NULL;
+}
+
+/* bundles never change during a run */
+int32_t RegisterCallback(BundleStatusCallback *bundleStatusCallback)
+{
+    (void)bundleStatusCallback;
+    return EC_SUCCESS;
+}
+
+int32_t UnregisterCallback(void)
+{
+    return EC_SUCCESS;
+}
+
+/* the ability is started at once, only the start is counted */
+int StartAbility(const Want *want)
+{
+    if (want == NULL || want->element == NULL) {
+        return EC_INVALID;
+    }
+    CountAbilityStart();
+    return EC_SUCCESS;
+}
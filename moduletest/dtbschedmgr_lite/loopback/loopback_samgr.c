@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dms_loopback.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "samgr_lite.h"
+#include "securec.h"
+
+#define MAX_LOOPBACK_SERVICES 4
+#define MAX_LOOPBACK_FEATURES 4
+#define SERVICE_LEVEL_ID (-1)
+#define LOOPBACK_ERR (-1)
+
+typedef struct {
+    int16 featureId;
+    Request request;
+} QueuedRequest;
+
+/* every service runs its own task with a bounded queue, as a SINGLE_TASK service of samgr does */
+typedef struct {
+    Service *service;
+    const char *name;
+    Feature *features[MAX_LOOPBACK_FEATURES];
+    IUnknown *featureApis[MAX_LOOPBACK_FEATURES];
+    uint8_t featureNum;
+    QueuedRequest *queue;
+    uint16_t queueSize;
+    uint16_t head;
+    uint16_t count;
+    bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+} LoopbackService;
+
+static LoopbackService g_services[MAX_LOOPBACK_SERVICES];
+static uint8_t g_serviceNum = 0;
+
+static LoopbackService *FindService(const char *name)
+{
+    for (uint8_t i = 0; i < g_serviceNum; i++) {
+        if (name != NULL && strcmp(g_services[i].name, name) == 0) {
+            return &g_services[i];
+        }
+    }
+    return NULL;
+}
+
+static int16 FindFeature(const LoopbackService *service, const char *name)
+{
+    for (uint8_t i = 0; i < service->featureNum; i++) {
+        Feature *feature = service->features[i];
+        if (name != NULL && strcmp(feature->GetName(feature), name) == 0) {
+            return (int16)i;
+        }
+    }
+    return SERVICE_LEVEL_ID;
+}
+
+/* registration runs in the init constructors, before any task is started */
+static BOOL RegisterService(Service *service)
+{
+    if (service == NULL || g_serviceNum >= MAX_LOOPBACK_SERVICES || FindService(service->GetName(service)) != NULL) {
+        return FALSE;
+    }
+    LoopbackService *entry = &g_services[g_serviceNum++];
+    entry->service = service;
+    entry->name = service->GetName(service);
+    (void)pthread_mutex_init(&entry->lock, NULL);
+    (void)pthread_cond_init(&entry->cond, NULL);
+    return TRUE;
+}
+
+static BOOL RegisterFeature(const char *serviceName, Feature *feature)
+{
+    LoopbackService *entry = FindService(serviceName);
+    if (entry == NULL || feature == NULL || entry->featureNum >= MAX_LOOPBACK_FEATURES) {
+        return FALSE;
+    }
+    entry->features[entry->featureNum++] = feature;
+    return TRUE;
+}
+
+static BOOL RegisterFeatureApi(const char *serviceName, const char *featureName, IUnknown *publicApi)
+{
+    LoopbackService *entry = FindService(serviceName);
+    if (entry == NULL || publicApi == NULL) {
+        return FALSE;
+    }
+    int16 featureId = FindFeature(entry, featureName);
+    if (featureId == SERVICE_LEVEL_ID) {
+        return FALSE;
+    }
+    entry->featureApis[featureId] = publicApi;
+    return TRUE;
+}
+
+static IUnknown *GetFeatureApi(const char *serviceName, const char *featureName)
+{
+    LoopbackService *entry = FindService(serviceName);
+    if (entry == NULL) {
+        return NULL;
+    }
+    int16 featureId = FindFeature(entry, featureName);
+    return (featureId == SERVICE_LEVEL_ID) ? NULL : entry->featureApis[featureId];
+}
+
+static SamgrLite g_samgr = {
+    .RegisterService = RegisterService,
+    .RegisterFeature = RegisterFeature,
+    .RegisterFeatureApi = RegisterFeatureApi,
+    .GetFeatureApi = GetFeatureApi,
+};
+
+SamgrLite *SAMGR_GetInstance(void)
+{
+    return &g_samgr;
+}
+
+/* samgr releases the data of a request once it is handled, so the stand-in does the same */
+static void HandleRequest(LoopbackService *entry, QueuedRequest *queued)
+{
+    if (queued->featureId == SERVICE_LEVEL_ID) {
+        (void)entry->service->MessageHandle(entry->service, &queued->request);
+    } else {
+        Feature *feature = entry->features[queued->featureId];
+        (void)feature->OnMessage(feature, &queued->request);
+    }
+    free(queued->request.data);
+}
+
+static void *ServiceTask(void *arg)
+{
+    LoopbackService *entry = (LoopbackService *)arg;
+    pthread_mutex_lock(&entry->lock);
+    while (entry->running) {
+        if (entry->count == 0) {
+            pthread_cond_wait(&entry->cond, &entry->lock);
+            continue;
+        }
+        QueuedRequest queued = entry->queue[entry->head];
+        entry->head = (entry->head + 1) % entry->queueSize;
+        entry->count--;
+        pthread_mutex_unlock(&entry->lock);
+        HandleRequest(entry, &queued);
+        pthread_mutex_lock(&entry->lock);
+    }
+    pthread_mutex_unlock(&entry->lock);
+    return NULL;
+}
+
+int32 SAMGR_SendRequest(const Identity *identity, const Request *request, Handler handler)
+{
+    (void)handler;
+    if (identity == NULL || request == NULL || identity->serviceId < 0 || identity->serviceId >= g_serviceNum) {
+        return EC_INVALID;
+    }
+    LoopbackService *entry = &g_services[identity->serviceId];
+    pthread_mutex_lock(&entry->lock);
+    if (!entry->running) {
+        pthread_mutex_unlock(&entry->lock);
+        return EC_FAILURE;
+    }
+    if (entry->count == entry->queueSize) {
+        pthread_mutex_unlock(&entry->lock);
+        return EC_BUSBUSY;
+    }
+    QueuedRequest *queued = &entry->queue[(entry->head + entry->count) % entry->queueSize];
+    queued->featureId = identity->featureId;
+    queued->request = *request;
+    entry->count++;
+    pthread_cond_signal(&entry->cond);
+    pthread_mutex_unlock(&entry->lock);
+    return EC_SUCCESS;
+}
+
+int IUNKNOWN_AddRef(IUnknown *iUnknown)
+{
+    (void)iUnknown;
+    return EC_SUCCESS;
+}
+
+int IUNKNOWN_QueryInterface(IUnknown *iUnknown, int ver, void **target)
+{
+    (void)ver;
+    if (iUnknown == NULL || target == NULL) {
+        return EC_INVALID;
+    }
+    *target = iUnknown;
+    return EC_SUCCESS;
+}
+
+int IUNKNOWN_Release(IUnknown *iUnknown)
+{
+    (void)iUnknown;
+    return EC_SUCCESS;
+}
+
+static int32_t StartService(LoopbackService *entry, int16 serviceId)
+{
+    TaskConfig config = entry->service->GetTaskConfig(entry->service);
+    entry->queueSize = (config.queueSize == 0) ? 1 : config.queueSize;
+    entry->queue = (QueuedRequest *)calloc(entry->queueSize, sizeof(QueuedRequest));
+    if (entry->queue == NULL) {
+        return LOOPBACK_ERR;
+    }
+    Identity identity = { serviceId, SERVICE_LEVEL_ID, entry };
+    (void)entry->service->Initialize(entry->service, identity);
+    for (uint8_t i = 0; i < entry->featureNum; i++) {
+        identity.featureId = (int16)i;
+        entry->features[i]->OnInitialize(entry->features[i], entry->service, identity);
+    }
+    entry->head = 0;
+    entry->count = 0;
+    entry->running = true;
+    if (pthread_create(&entry->thread, NULL, ServiceTask, entry) != 0) {
+        entry->running = false;
+        return LOOPBACK_ERR;
+    }
+    return 0;
+}
+
+static void StopService(LoopbackService *entry, int16 serviceId)
+{
+    pthread_mutex_lock(&entry->lock);
+    if (!entry->running) {
+        pthread_mutex_unlock(&entry->lock);
+        return;
+    }
+    entry->running = false;
+    pthread_cond_signal(&entry->cond);
+    pthread_mutex_unlock(&entry->lock);
+    (void)pthread_join(entry->thread, NULL);
+    Identity identity = { serviceId, SERVICE_LEVEL_ID, entry };
+    for (uint8_t i = 0; i < entry->featureNum; i++) {
+        identity.featureId = (int16)i;
+        entry->features[i]->OnStop(entry->features[i], identity);
+    }
+    for (uint16_t i = 0; i < entry->count; i++) {
+        free(entry->queue[(entry->head + i) % entry->queueSize].request.data);
+    }
+    free(entry->queue);
+    entry->queue = NULL;
+}
+
+int32_t StartLoopbackSamgr()
+{
+    for (uint8_t i = 0; i < g_serviceNum; i++) {
+        if (StartService(&g_services[i], (int16)i) != 0) {
+            StopLoopbackSamgr();
+            return LOOPBACK_ERR;
+        }
+    }
+    return 0;
+}
+
+void StopLoopbackSamgr()
+{
+    for (uint8_t i = 0; i < g_serviceNum; i++) {
+        StopService(&g_services[i], (int16)i);
+    }
+}
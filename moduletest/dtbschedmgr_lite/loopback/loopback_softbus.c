@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dms_loopback.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "securec.h"
+#include "session.h"
+#include "softbus_bus_center.h"
+
+#define MAX_LOOPBACK_SESSIONS 64
+#define INVALID_SESSION_ID (-1)
+#define US_PER_SECOND 1000000
+#define NS_PER_US 1000
+#define LOOPBACK_ERR (-1)
+
+typedef enum {
+    LINK_SESSION_OPENED = 0,
+    LINK_SESSION_CLOSED,
+    LINK_BYTES,
+    LINK_MESSAGE,
+} LinkEventType;
+
+/* something the link hands to the listener at dueUs, kept in a list sorted by dueUs */
+typedef struct LinkEvent {
+    uint64_t sentUs;
+    uint64_t dueUs;
+    LinkEventType type;
+    int32_t sessionId;
+    uint32_t len;
+    uint8_t *data;
+    struct LinkEvent *next;
+} LinkEvent;
+
+/* the two ends of a loopback session point at each other */
+typedef struct {
+    bool used;
+    bool open;
+    int32_t peer;
+    /* both ends take sends in the mode the opener chose only, as softbus does */
+    int32_t dataType;
+} LoopbackSession;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool running;
+    LinkEvent *events;
+    /* frames are serialized on the link, the next one starts once the previous one has been sent */
+    uint64_t busyUntilUs;
+    LoopbackLinkConfig config;
+    LoopbackSession sessions[MAX_LOOPBACK_SESSIONS];
+    const ISessionListener *listener;
+    INodeStateCb *nodeStateCb;
+    LoopbackStats stats;
+} LoopbackLink;
+
+static LoopbackLink g_link = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t GetNowUs()
+{
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * US_PER_SECOND + (uint64_t)now.tv_nsec / NS_PER_US;
+}
+
+static bool IsValidSession(int32_t sessionId)
+{
+    return sessionId >= 0 && sessionId < MAX_LOOPBACK_SESSIONS && g_link.sessions[sessionId].used;
+}
+
+/* runs with the link locked, takes over data */
+static int32_t PostLinkEvent(LinkEventType type, int32_t sessionId, uint8_t *data, uint32_t len, uint64_t dueUs)
+{
+    LinkEvent *event = (LinkEvent *)calloc(1, sizeof(LinkEvent));
+    if (event == NULL) {
+        free(data);
+        return LOOPBACK_ERR;
+    }
+    event->sentUs = GetNowUs();
+    event->dueUs = dueUs;
+    event->type = type;
+    event->sessionId = sessionId;
+    event->data = data;
+    event->len = len;
+    LinkEvent **link = &g_link.events;
+    while (*link != NULL && (*link)->dueUs <= dueUs) {
+        link = &(*link)->next;
+    }
+    event->next = *link;
+    *link = event;
+    pthread_cond_signal(&g_link.cond);
+    return 0;
+}
+
+static void DeliverLinkEvent(const LinkEvent *event)
+{
+    const ISessionListener *listener = g_link.listener;
+    if (listener == NULL) {
+        return;
+    }
+    switch (event->type) {
+        case LINK_SESSION_OPENED:
+            (void)listener->OnSessionOpened(event->sessionId, 0);
+            break;
+        case LINK_SESSION_CLOSED:
+            listener->OnSessionClosed(event->sessionId);
+            break;
+        case LINK_BYTES:
+            listener->OnBytesReceived(event->sessionId, event->data, event->len);
+            break;
+        case LINK_MESSAGE:
+            listener->OnMessageReceived(event->sessionId, event->data, event->len);
+            break;
+        default:
+            break;
+    }
+}
+
+/* runs with the link locked */
+static void CountDelivery(const LinkEvent *event, uint64_t nowUs)
+{
+    LoopbackModeStats *stats;
+    if (event->type == LINK_BYTES) {
+        stats = &g_link.stats.bytesMode;
+    } else if (event->type == LINK_MESSAGE) {
+        stats = &g_link.stats.messageMode;
+    } else {
+        return;
+    }
+    uint32_t delayUs = (uint32_t)(nowUs - event->sentUs);
+    stats->frames++;
+    stats->totalUs += delayUs;
+    if (delayUs > stats->maxUs) {
+        stats->maxUs = delayUs;
+    }
+}
+
+static void ReleaseSession(int32_t sessionId)
+{
+    LoopbackSession *session = &g_link.sessions[sessionId];
+    session->open = false;
+    /* the pair is reused once both ends are closed */
+    if (session->peer == INVALID_SESSION_ID || !g_link.sessions[session->peer].open) {
+        if (session->peer != INVALID_SESSION_ID) {
+            g_link.sessions[session->peer].used = false;
+        }
+        session->used = false;
+    }
+}
+
+static void *LinkWorker(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&g_link.lock);
+    while (g_link.running) {
+        LinkEvent *event = g_link.events;
+        if (event == NULL) {
+            pthread_cond_wait(&g_link.cond, &g_link.lock);
+            continue;
+        }
+        uint64_t nowUs = GetNowUs();
+        if (event->dueUs > nowUs) {
+            struct timespec due = {
+                .tv_sec = (time_t)(event->dueUs / US_PER_SECOND),
+                .tv_nsec = (long)(event->dueUs % US_PER_SECOND) * NS_PER_US
+            };
+            (void)pthread_cond_timedwait(&g_link.cond, &g_link.lock, &due);
+            continue;
+        }
+        g_link.events = event->next;
+        bool deliverable = IsValidSession(event->sessionId) && g_link.sessions[event->sessionId].open;
+        if (deliverable && event->type == LINK_SESSION_CLOSED) {
+            ReleaseSession(event->sessionId);
+        }
+        if (deliverable) {
+            CountDelivery(event, nowUs);
+        }
+        /* the listener may send or close right away, so it runs unlocked */
+        pthread_mutex_unlock(&g_link.lock);
+        if (deliverable) {
+            DeliverLinkEvent(event);
+        }
+        free(event->data);
+        free(event);
+        pthread_mutex_lock(&g_link.lock);
+    }
+    pthread_mutex_unlock(&g_link.lock);
+    return NULL;
+}
+
+int32_t StartLoopbackLink(const LoopbackLinkConfig *config)
+{
+    pthread_condattr_t attr;
+    (void)pthread_condattr_init(&attr);
+    (void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    (void)pthread_cond_init(&g_link.cond, &attr);
+    (void)pthread_condattr_destroy(&attr);
+    SetLoopbackLink(config);
+    g_link.running = true;
+    if (pthread_create(&g_link.thread, NULL, LinkWorker, NULL) != 0) {
+        g_link.running = false;
+        return LOOPBACK_ERR;
+    }
+    return 0;
+}
+
+void StopLoopbackLink()
+{
+    pthread_mutex_lock(&g_link.lock);
+    if (!g_link.running) {
+        pthread_mutex_unlock(&g_link.lock);
+        return;
+    }
+    g_link.running = false;
+    pthread_cond_signal(&g_link.cond);
+    pthread_mutex_unlock(&g_link.lock);
+    (void)pthread_join(g_link.thread, NULL);
+    while (g_link.events != NULL) {
+        LinkEvent *event = g_link.events;
+        g_link.events = event->next;
+        free(event->data);
+        free(event);
+    }
+    (void)memset_s(g_link.sessions, sizeof(g_link.sessions), 0x00, sizeof(g_link.sessions));
+}
+
+void SetLoopbackLink(const LoopbackLinkConfig *config)
+{
+    if (config == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&g_link.lock);
+    g_link.config = *config;
+    pthread_mutex_unlock(&g_link.lock);
+}
+
+void GetLoopbackStats(LoopbackStats *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&g_link.lock);
+    *stats = g_link.stats;
+    stats->bytesMode.frameUs = g_link.config.bytesFrameUs;
+    stats->messageMode.frameUs = g_link.config.messageFrameUs;
+    pthread_mutex_unlock(&g_link.lock);
+}
+
+void CountAbilityStart()
+{
+    pthread_mutex_lock(&g_link.lock);
+    g_link.stats.abilityStarts++;
+    pthread_mutex_unlock(&g_link.lock);
+}
+
+int CreateSessionServer(const char *pkgName, const char *sessionName, const ISessionListener *listener)
+{
+    if (pkgName == NULL || sessionName == NULL || listener == NULL) {
+        return LOOPBACK_ERR;
+    }
+    pthread_mutex_lock(&g_link.lock);
+    g_link.listener = listener;
+    pthread_mutex_unlock(&g_link.lock);
+    return 0;
+}
+
+int RemoveSessionServer(const char *pkgName, const char *sessionName)
+{
+    (void)pkgName;
+    (void)sessionName;
+    pthread_mutex_lock(&g_link.lock);
+    g_link.listener = NULL;
+    pthread_mutex_unlock(&g_link.lock);
+    return 0;
+}
+
+static int32_t FindFreeSession(int32_t except)
+{
+    for (int32_t i = 0; i < MAX_LOOPBACK_SESSIONS; i++) {
+        if (!g_link.sessions[i].used && i != except) {
+            return i;
+        }
+    }
+    return INVALID_SESSION_ID;
+}
+
+int OpenSession(const char *mySessionName, const char *peerSessionName, const char *peerDeviceId,
+    const char *groupId, const SessionAttribute *attr)
+{
+    (void)mySessionName;
+    (void)peerSessionName;
+    (void)groupId;
+    if (attr == NULL || peerDeviceId == NULL || strcmp(peerDeviceId, LOOPBACK_NETWORK_ID) != 0) {
+        return LOOPBACK_ERR;
+    }
+    pthread_mutex_lock(&g_link.lock);
+    int32_t opener = FindFreeSession(INVALID_SESSION_ID);
+    int32_t accepter = FindFreeSession(opener);
+    if (!g_link.running || g_link.listener == NULL || opener == INVALID_SESSION_ID
+        || accepter == INVALID_SESSION_ID) {
+        pthread_mutex_unlock(&g_link.lock);
+        return LOOPBACK_ERR;
+    }
+    g_link.sessions[opener] = (LoopbackSession) {
+        .used = true, .open = true, .peer = accepter, .dataType = attr->dataType
+    };
+    g_link.sessions[accepter] = (LoopbackSession) {
+        .used = true, .open = true, .peer = opener, .dataType = attr->dataType
+    };
+    /* the accepting side learns of the session after one trip, the opener after the handshake returns */
+    uint64_t nowUs = GetNowUs();
+    (void)PostLinkEvent(LINK_SESSION_OPENED, accepter, NULL, 0, nowUs + g_link.config.latencyUs);
+    (void)PostLinkEvent(LINK_SESSION_OPENED, opener, NULL, 0, nowUs + 2 * (uint64_t)g_link.config.latencyUs);
+    g_link.stats.sessionOpens++;
+    pthread_mutex_unlock(&g_link.lock);
+    return opener;
+}
+
+void CloseSession(int sessionId)
+{
+    pthread_mutex_lock(&g_link.lock);
+    if (!IsValidSession(sessionId) || !g_link.sessions[sessionId].open) {
+        pthread_mutex_unlock(&g_link.lock);
+        return;
+    }
+    int32_t peer = g_link.sessions[sessionId].peer;
+    ReleaseSession(sessionId);
+    /* only the other end is told, as softbus does */
+    if (g_link.sessions[peer].open) {
+        (void)PostLinkEvent(LINK_SESSION_CLOSED, peer, NULL, 0, GetNowUs() + g_link.config.latencyUs);
+    }
+    pthread_mutex_unlock(&g_link.lock);
+}
+
+static int SendFrame(LinkEventType type, int sessionId, const void *data, unsigned int len)
+{
+    if (data == NULL || len == 0) {
+        return LOOPBACK_ERR;
+    }
+    uint8_t *copy = (uint8_t *)malloc(len);
+    if (copy == NULL || memcpy_s(copy, len, data, len) != EOK) {
+        free(copy);
+        return LOOPBACK_ERR;
+    }
+    int32_t dataType = (type == LINK_BYTES) ? TYPE_BYTES : TYPE_MESSAGE;
+    pthread_mutex_lock(&g_link.lock);
+    if (!IsValidSession(sessionId) || !g_link.sessions[sessionId].open
+        || g_link.sessions[sessionId].dataType != dataType) {
+        g_link.stats.refusedSends++;
+        pthread_mutex_unlock(&g_link.lock);
+        free(copy);
+        return LOOPBACK_ERR;
+    }
+    uint64_t nowUs = GetNowUs();
+    uint64_t startUs = (g_link.busyUntilUs > nowUs) ? g_link.busyUntilUs : nowUs;
+    uint64_t sendUs = (type == LINK_BYTES) ? g_link.config.bytesFrameUs : g_link.config.messageFrameUs;
+    if (g_link.config.bandwidth != 0) {
+        sendUs += (uint64_t)len * US_PER_SECOND / g_link.config.bandwidth;
+    }
+    g_link.busyUntilUs = startUs + sendUs;
+    int32_t ret = PostLinkEvent(type, g_link.sessions[sessionId].peer, copy, len,
+        g_link.busyUntilUs + g_link.config.latencyUs);
+    g_link.stats.framesSent++;
+    g_link.stats.bytesSent += len;
+    pthread_mutex_unlock(&g_link.lock);
+    return ret;
+}
+
+int SendBytes(int sessionId, const void *data, unsigned int len)
+{
+    return SendFrame(LINK_BYTES, sessionId, data, len);
+}
+
+int SendMessage(int sessionId, const void *data, unsigned int len)
+{
+    return SendFrame(LINK_MESSAGE, sessionId, data, len);
+}
+
+int GetPeerDeviceId(int sessionId, char *devId, unsigned int len)
+{
+    pthread_mutex_lock(&g_link.lock);
+    bool valid = IsValidSession(sessionId);
+    pthread_mutex_unlock(&g_link.lock);
+    if (!valid || devId == NULL || strcpy_s(devId, len, LOOPBACK_NETWORK_ID) != EOK) {
+        return LOOPBACK_ERR;
+    }
+    return 0;
+}
+
+int32_t RegNodeDeviceStateCb(const char *pkgName, INodeStateCb *callback)
+{
+    (void)pkgName;
+    pthread_mutex_lock(&g_link.lock);
+    g_link.nodeStateCb = callback;
+    pthread_mutex_unlock(&g_link.lock);
+    return 0;
+}
+
+int32_t UnregNodeDeviceStateCb(INodeStateCb *callback)
+{
+    (void)callback;
+    pthread_mutex_lock(&g_link.lock);
+    g_link.nodeStateCb = NULL;
+    pthread_mutex_unlock(&g_link.lock);
+    return 0;
+}
+
+/* the loopback peer is online before the dms starts, as a device already in the network */
+int32_t GetAllNodeDeviceInfo(const char *pkgName, NodeBasicInfo **info, int32_t *infoNum)
+{
+    (void)pkgName;
+    if (info == NULL || infoNum == NULL) {
+        return LOOPBACK_ERR;
+    }
+    NodeBasicInfo *node = (NodeBasicInfo *)calloc(1, sizeof(NodeBasicInfo));
+    if (node == NULL) {
+        return LOOPBACK_ERR;
+    }
+    (void)strcpy_s(node->networkId, NETWORK_ID_BUF_LEN, LOOPBACK_NETWORK_ID);
+    (void)strcpy_s(node->deviceName, DEVICE_NAME_BUF_LEN, LOOPBACK_DEVICE_NAME);
+    *info = node;
+    *infoNum = 1;
+    return 0;
+}
+
+void FreeNodeInfo(NodeBasicInfo *info)
+{
+    free(info);
+}
+
+int32_t GetNodeKeyInfo(const char *pkgName, const char *networkId, NodeDeivceInfoKey key, uint8_t *info,
+    int32_t infoLen)
+{
+    (void)pkgName;
+    if (networkId == NULL || strcmp(networkId, LOOPBACK_NETWORK_ID) != 0 || key != NODE_KEY_UDID || info == NULL
+        || infoLen <= 0 || strcpy_s((char *)info, (size_t)infoLen, LOOPBACK_UDID) != EOK) {
+        return LOOPBACK_ERR;
+    }
+    return 0;
+}
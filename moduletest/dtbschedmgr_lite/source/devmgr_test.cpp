@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "dmslite_admission.h"
+#include "dmslite_devmgr.h"
+#include "dmslite_feature.h"
+#include "dmslite_histogram.h"
+#include "dmslite_stats.h"
+#include "dmslite_tlv_common.h"
+
+#include "ohos_errno.h"
+#include "securec.h"
+
+using namespace testing::ext;
+
+namespace OHOS {
+namespace DistributedSchedule {
+namespace {
+const char *PEER_NAME = "peer";
+const char *RENAMED_PEER_NAME = "renamed peer";
+}
+
+class DevmgrTest : public testing::Test {
+protected:
+    static void SetUpTestCase() { }
+    static void TearDownTestCase() { }
+    virtual void SetUp()
+    {
+        ClearPeers();
+    }
+    virtual void TearDown()
+    {
+        ClearPeers();
+    }
+
+    static void FillNodeInfo(NodeBasicInfo *info, const std::string &networkId, const char *deviceName)
+    {
+        (void)memset_s(info, sizeof(NodeBasicInfo), 0x00, sizeof(NodeBasicInfo));
+        (void)strcpy_s(info->networkId, NETWORK_ID_BUF_LEN, networkId.c_str());
+        (void)strcpy_s(info->deviceName, DEVICE_NAME_BUF_LEN, deviceName);
+    }
+
+    static std::string PeerId(uint8_t index)
+    {
+        return "network" + std::to_string(index);
+    }
+};
+
+/**
+ * @tc.name: PeerRegistry_001
+ * @tc.desc: online peers are tracked separately and removed one by one
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(DevmgrTest, PeerRegistry_001, TestSize.Level1)
+{
+    NodeBasicInfo info;
+    for (uint8_t i = 0; i < MAX_PEER_NUM; i++) {
+        FillNodeInfo(&info, PeerId(i), PEER_NAME);
+        EXPECT_EQ(AddPeer(&info), EC_SUCCESS);
+    }
+    FillNodeInfo(&info, PeerId(MAX_PEER_NUM), PEER_NAME);
+    EXPECT_EQ(AddPeer(&info), EC_FAILURE);
+    EXPECT_EQ(GetOnlinePeerNum(), MAX_PEER_NUM);
+
+    EXPECT_EQ(RemovePeer(PeerId(1).c_str()), EC_SUCCESS);
+    EXPECT_EQ(RemovePeer(PeerId(1).c_str()), EC_FAILURE);
+    EXPECT_FALSE(IsPeerOnline(PeerId(1).c_str()));
+    EXPECT_TRUE(IsPeerOnline(PeerId(0).c_str()));
+    EXPECT_TRUE(IsPeerOnline(PeerId(2).c_str()));
+
+    uint8_t visited = 0;
+    ForEachPeer([] (const DmsPeerInfo *peerInfo, void *context) {
+        (*static_cast<uint8_t *>(context))++;
+        return true;
+    }, &visited);
+    EXPECT_EQ(visited, MAX_PEER_NUM - 1);
+}
+
+/**
+ * @tc.name: PeerRegistry_002
+ * @tc.desc: info changes, session links and refused starts update the existing entry
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(DevmgrTest, PeerRegistry_002, TestSize.Level1)
+{
+    NodeBasicInfo info;
+    FillNodeInfo(&info, PeerId(0), PEER_NAME);
+    EXPECT_EQ(AddPeer(&info), EC_SUCCESS);
+    FillNodeInfo(&info, PeerId(0), RENAMED_PEER_NAME);
+    EXPECT_EQ(UpdatePeer(TYPE_DEVICE_NAME, &info), EC_SUCCESS);
+    EXPECT_EQ(UpdatePeerLink(PeerId(0).c_str(), 1), EC_SUCCESS);
+    EXPECT_EQ(UpdatePeerLink(PeerId(1).c_str(), 1), EC_FAILURE);
+
+    DmsPeerInfo peerInfo;
+    EXPECT_EQ(GetPeerInfo(PeerId(0).c_str(), &peerInfo), EC_SUCCESS);
+    EXPECT_EQ(std::string(peerInfo.basicInfo.deviceName), RENAMED_PEER_NAME);
+    EXPECT_EQ(peerInfo.link.sessionId, 1);
+    EXPECT_EQ(GetPeerInfo(PeerId(1).c_str(), &peerInfo), EC_FAILURE);
+    EXPECT_EQ(GetOnlinePeerNum(), 1);
+
+    uint32_t rejectNum = 0;
+    const DmsProxy *proxy = &(GetDmsLiteFeature()->iUnknown);
+    EXPECT_EQ(CountPeerRejection(PeerId(0).c_str()), EC_SUCCESS);
+    EXPECT_EQ(CountPeerRejection(PeerId(1).c_str()), EC_FAILURE);
+    EXPECT_EQ(proxy->GetPeerRejections(PeerId(0).c_str(), &rejectNum), DMS_EC_SUCCESS);
+    EXPECT_EQ(rejectNum, 1U);
+    EXPECT_EQ(proxy->GetPeerRejections(PeerId(1).c_str(), &rejectNum), DMS_EC_FAILURE);
+    EXPECT_EQ(proxy->GetPeerRejections(PeerId(0).c_str(), nullptr), DMS_EC_INVALID_PARAMETER);
+    DumpDmsStats();
+}
+
+/**
+ * @tc.name: PeerRegistry_003
+ * @tc.desc: a device reported under a new networkId keeps its one entry and what is known about it
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(DevmgrTest, PeerRegistry_003, TestSize.Level1)
+{
+    const char *udid = "udid0";
+    NodeBasicInfo info;
+    FillNodeInfo(&info, PeerId(0), PEER_NAME);
+    EXPECT_EQ(AddPeerWithUdid(&info, udid), EC_SUCCESS);
+    FillNodeInfo(&info, PeerId(1), PEER_NAME);
+    EXPECT_EQ(AddPeerWithUdid(&info, ""), EC_SUCCESS);
+    EXPECT_EQ(RecordPeerRtt(PeerId(0).c_str(), 1), EC_SUCCESS);
+
+    FillNodeInfo(&info, PeerId(2), PEER_NAME);
+    EXPECT_EQ(AddPeerWithUdid(&info, udid), EC_SUCCESS);
+    EXPECT_EQ(GetOnlinePeerNum(), 2);
+    EXPECT_FALSE(IsPeerOnline(PeerId(0).c_str()));
+    EXPECT_TRUE(IsPeerOnline(PeerId(1).c_str()));
+    DmsPeerInfo peerInfo;
+    EXPECT_EQ(GetPeerInfo(PeerId(2).c_str(), &peerInfo), EC_SUCCESS);
+    EXPECT_EQ(std::string(peerInfo.udid), udid);
+    EXPECT_EQ(peerInfo.rtt.sampleNum, 1);
+
+    /* the stale networkId is neither selected nor left holding a slot */
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    EXPECT_EQ(GetLowestLatencyPeer(nullptr, networkId, NETWORK_ID_BUF_LEN), EC_SUCCESS);
+    EXPECT_EQ(std::string(networkId), PeerId(2));
+    EXPECT_EQ(RemovePeer(PeerId(0).c_str()), EC_FAILURE);
+    EXPECT_EQ(RemovePeer(PeerId(2).c_str()), EC_SUCCESS);
+    EXPECT_EQ(GetOnlinePeerNum(), 1);
+}
+
+/**
+ * @tc.name: PeerCapability_001
+ * @tc.desc: capability is requested once per online peer, again if its session ended, dropped when offline
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(DevmgrTest, PeerCapability_001, TestSize.Level1)
+{
+    NodeBasicInfo info;
+    FillNodeInfo(&info, PeerId(0), PEER_NAME);
+    EXPECT_EQ(AddPeer(&info), EC_SUCCESS);
+
+    DmsPeerCapability capability = {
+        .version = DMS_VERSION_VALUE,
+        .maxFrameSize = MAX_DMS_MSG_LENGTH,
+        .features = DMS_LOCAL_FEATURES
+    };
+    EXPECT_EQ(GetPeerCapability(PeerId(0).c_str(), &capability), EC_FAILURE);
+    const int32_t sessionId = 1;
+    EXPECT_TRUE(ClaimPeerCapabilityRequest(PeerId(0).c_str(), sessionId));
+    EXPECT_FALSE(ClaimPeerCapabilityRequest(PeerId(0).c_str(), sessionId + 1));
+    EXPECT_FALSE(ClaimPeerCapabilityRequest(PeerId(1).c_str(), sessionId));
+    ReleasePeerCapabilityRequest(sessionId + 1);
+    EXPECT_FALSE(ClaimPeerCapabilityRequest(PeerId(0).c_str(), sessionId + 1));
+    ReleasePeerCapabilityRequest(sessionId);
+    EXPECT_TRUE(ClaimPeerCapabilityRequest(PeerId(0).c_str(), sessionId + 1));
+    EXPECT_EQ(UpdatePeerCapability(PeerId(0).c_str(), &capability), EC_SUCCESS);
+
+    DmsPeerCapability cached;
+    EXPECT_EQ(GetPeerCapability(PeerId(0).c_str(), &cached), EC_SUCCESS);
+    EXPECT_EQ(cached.maxFrameSize, MAX_DMS_MSG_LENGTH);
+    EXPECT_EQ(cached.features, static_cast<uint32_t>(DMS_LOCAL_FEATURES));
+
+    EXPECT_EQ(RemovePeer(PeerId(0).c_str()), EC_SUCCESS);
+    EXPECT_EQ(AddPeer(&info), EC_SUCCESS);
+    EXPECT_EQ(GetPeerCapability(PeerId(0).c_str(), &cached), EC_FAILURE);
+}
+/**
+ * @tc.name: PeerRtt_001
+ * @tc.desc: rtt samples feed the ewma and percentiles, the fastest sampled peer is selected
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(DevmgrTest, PeerRtt_001, TestSize.Level1)
+{
+    const uint32_t slowRtt = 80;
+    const uint32_t fastRtt = 10;
+    const uint32_t spikeRtt = 200;
+    NodeBasicInfo info;
+    for (uint8_t i = 0; i < 3; i++) {
+        FillNodeInfo(&info, PeerId(i), PEER_NAME);
+        EXPECT_EQ(AddPeer(&info), EC_SUCCESS);
+    }
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    EXPECT_EQ(GetLowestLatencyPeer(nullptr, networkId, NETWORK_ID_BUF_LEN), EC_SUCCESS);
+
+    for (uint8_t i = 0; i < RTT_SAMPLE_NUM; i++) {
+        EXPECT_EQ(RecordPeerRtt(PeerId(0).c_str(), slowRtt), EC_SUCCESS);
+        EXPECT_EQ(RecordPeerRtt(PeerId(1).c_str(), fastRtt), EC_SUCCESS);
+    }
+    EXPECT_EQ(RecordPeerRtt(PeerId(1).c_str(), spikeRtt), EC_SUCCESS);
+
+    DmsRttStats stats;
+    EXPECT_EQ(GetPeerRttStats(PeerId(2).c_str(), &stats), EC_FAILURE);
+    EXPECT_EQ(GetPeerRttStats(PeerId(1).c_str(), &stats), EC_SUCCESS);
+    EXPECT_EQ(stats.sampleNum, RTT_SAMPLE_NUM);
+    EXPECT_EQ(stats.p50, fastRtt);
+    EXPECT_EQ(stats.p99, spikeRtt);
+    EXPECT_GT(stats.ewma, fastRtt);
+    EXPECT_LT(stats.ewma, slowRtt);
+
+    EXPECT_EQ(GetLowestLatencyPeer(nullptr, networkId, NETWORK_ID_BUF_LEN), EC_SUCCESS);
+    EXPECT_EQ(std::string(networkId), PeerId(1));
+    EXPECT_EQ(GetLowestLatencyPeer(nullptr, networkId, 1), EC_INVALID);
+
+    /* the proxy reports DmsLiteCommonErrorCode */
+    const DmsProxy *proxy = &(GetDmsLiteFeature()->iUnknown);
+    EXPECT_EQ(proxy->GetLowestLatencyPeer(nullptr, networkId, NETWORK_ID_BUF_LEN), DMS_EC_SUCCESS);
+    EXPECT_EQ(proxy->GetLowestLatencyPeer(nullptr, networkId, 1), DMS_EC_INVALID_PARAMETER);
+}
+
+/**
+ * @tc.name: Admission_001
+ * @tc.desc: start requests beyond the source quota are refused, an overloaded peer is skipped until its delay ends
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(DevmgrTest, Admission_001, TestSize.Level1)
+{
+    const int32_t busyUid = 1000;
+    const int32_t otherUid = 1001;
+    DmsAdmissionStats before;
+    GetAdmissionStats(ADMISSION_LOCAL, &before);
+    for (uint8_t i = 0; i < DMS_SOURCE_QUOTA; i++) {
+        EXPECT_TRUE(AcquireAdmission(ADMISSION_LOCAL, busyUid));
+    }
+    EXPECT_FALSE(AcquireAdmission(ADMISSION_LOCAL, busyUid));
+    EXPECT_TRUE(AcquireAdmission(ADMISSION_LOCAL, otherUid));
+    EXPECT_GE(GetRetryAfterMs(), static_cast<uint32_t>(DMS_RETRY_AFTER_BASE_MS * 2));
+
+    DmsAdmissionStats stats;
+    GetAdmissionStats(ADMISSION_LOCAL, &stats);
+    EXPECT_EQ(stats.pending, before.pending + DMS_SOURCE_QUOTA + 1);
+    EXPECT_EQ(stats.rejected, before.rejected + 1);
+    DmsStats dmsStats;
+    ASSERT_EQ(GetDmsStats(&dmsStats), DMS_EC_SUCCESS);
+    EXPECT_EQ(dmsStats.localStarts.pending, stats.pending);
+    EXPECT_EQ(dmsStats.localStarts.rejected, stats.rejected);
+    ReleaseAdmission(ADMISSION_LOCAL, busyUid);
+    EXPECT_TRUE(AcquireAdmission(ADMISSION_LOCAL, busyUid));
+    for (uint8_t i = 0; i < DMS_SOURCE_QUOTA; i++) {
+        ReleaseAdmission(ADMISSION_LOCAL, busyUid);
+    }
+    ReleaseAdmission(ADMISSION_LOCAL, otherUid);
+    /* a release without an acquire must not free a slot of another caller */
+    ReleaseAdmission(ADMISSION_LOCAL, otherUid);
+    GetAdmissionStats(ADMISSION_LOCAL, &stats);
+    EXPECT_EQ(stats.pending, before.pending);
+    EXPECT_EQ(GetRetryAfterMs(), static_cast<uint32_t>(DMS_RETRY_AFTER_BASE_MS));
+
+    NodeBasicInfo info;
+    for (uint8_t i = 0; i < 2; i++) {
+        FillNodeInfo(&info, PeerId(i), PEER_NAME);
+        EXPECT_EQ(AddPeer(&info), EC_SUCCESS);
+        EXPECT_EQ(RecordPeerRtt(PeerId(i).c_str(), i + 1), EC_SUCCESS);
+    }
+    EXPECT_EQ(SetPeerBackoff(PeerId(0).c_str(), DMS_RETRY_AFTER_MAX_MS), EC_SUCCESS);
+    EXPECT_EQ(SetPeerBackoff(PeerId(2).c_str(), DMS_RETRY_AFTER_MAX_MS), EC_FAILURE);
+    EXPECT_TRUE(IsPeerBackingOff(PeerId(0).c_str()));
+    EXPECT_FALSE(IsPeerBackingOff(PeerId(1).c_str()));
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    EXPECT_EQ(GetLowestLatencyPeer(nullptr, networkId, NETWORK_ID_BUF_LEN), EC_SUCCESS);
+    EXPECT_EQ(std::string(networkId), PeerId(1));
+    EXPECT_EQ(SetPeerBackoff(PeerId(0).c_str(), 0), EC_SUCCESS);
+    EXPECT_FALSE(IsPeerBackingOff(PeerId(0).c_str()));
+}
+
+/**
+ * @tc.name: LatencyHistogram_001
+ * @tc.desc: latencies land in log buckets per command and per peer, the tail shows in p99 and max until reset
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(DevmgrTest, LatencyHistogram_001, TestSize.Level1)
+{
+    const uint32_t usualMs = 10;
+    const uint32_t slowMs = 100;
+    const uint32_t slowBucketBound = 103;
+    const uint32_t stuckMs = 100000;
+    const uint8_t usualNum = 98;
+    NodeBasicInfo info;
+    FillNodeInfo(&info, PeerId(0), PEER_NAME);
+    EXPECT_EQ(AddPeer(&info), EC_SUCCESS);
+    ResetCommandLatency();
+    for (uint8_t i = 0; i < usualNum; i++) {
+        EXPECT_EQ(RecordPeerLatency(PeerId(0).c_str(), DMS_LATENCY_CALLER, usualMs), EC_SUCCESS);
+        RecordCommandLatency(DMS_MSG_CMD_START_FA, DMS_LATENCY_CALLEE, usualMs);
+    }
+    EXPECT_EQ(RecordPeerLatency(PeerId(0).c_str(), DMS_LATENCY_CALLER, slowMs), EC_SUCCESS);
+    EXPECT_EQ(RecordPeerLatency(PeerId(0).c_str(), DMS_LATENCY_CALLER, stuckMs), EC_SUCCESS);
+    EXPECT_EQ(RecordPeerLatency(PeerId(1).c_str(), DMS_LATENCY_CALLER, usualMs), EC_FAILURE);
+    RecordCommandLatency(DMS_MSG_CMD_START_FA, DMS_LATENCY_CALLEE, slowMs);
+    RecordCommandLatency(DMS_MSG_CMD_REPLY, DMS_LATENCY_CALLEE, slowMs);
+
+    DmsLatencyStats stats;
+    EXPECT_EQ(GetPeerLatency(PeerId(0).c_str(), DMS_LATENCY_CALLER, &stats), EC_SUCCESS);
+    EXPECT_EQ(stats.count, usualNum + 2U);
+    EXPECT_EQ(stats.p50, usualMs);
+    EXPECT_EQ(stats.p90, usualMs);
+    EXPECT_EQ(stats.p99, slowBucketBound);
+    EXPECT_EQ(stats.max, stuckMs);
+    EXPECT_EQ(GetPeerLatency(PeerId(0).c_str(), DMS_LATENCY_SIDE_NUM, &stats), EC_INVALID);
+    const DmsProxy *proxy = &(GetDmsLiteFeature()->iUnknown);
+    EXPECT_EQ(proxy->GetPeerLatency(PeerId(0).c_str(), DMS_LATENCY_CALLER, &stats), DMS_EC_SUCCESS);
+    EXPECT_EQ(proxy->GetPeerLatency(PeerId(0).c_str(), DMS_LATENCY_SIDE_NUM, &stats), DMS_EC_INVALID_PARAMETER);
+    EXPECT_EQ(proxy->GetPeerLatency(PeerId(1).c_str(), DMS_LATENCY_CALLER, &stats), DMS_EC_FAILURE);
+
+    EXPECT_EQ(GetCommandLatency(DMS_MSG_CMD_START_FA, DMS_LATENCY_CALLEE, &stats), DMS_EC_SUCCESS);
+    EXPECT_EQ(stats.count, usualNum + 1U);
+    EXPECT_EQ(stats.p50, usualMs);
+    EXPECT_EQ(stats.max, slowMs);
+    EXPECT_EQ(GetCommandLatency(DMS_MSG_CMD_START_FA, DMS_LATENCY_CALLER, &stats), DMS_EC_SUCCESS);
+    EXPECT_EQ(stats.count, 0U);
+    EXPECT_EQ(GetCommandLatency(DMS_MSG_CMD_REPLY, DMS_LATENCY_CALLEE, &stats), DMS_EC_INVALID_PARAMETER);
+
+    ResetCommandLatency();
+    ResetPeerLatency();
+    EXPECT_EQ(GetCommandLatency(DMS_MSG_CMD_START_FA, DMS_LATENCY_CALLEE, &stats), DMS_EC_SUCCESS);
+    EXPECT_EQ(stats.count, 0U);
+    EXPECT_EQ(GetPeerLatency(PeerId(0).c_str(), DMS_LATENCY_CALLER, &stats), EC_SUCCESS);
+    EXPECT_EQ(stats.count, 0U);
+    EXPECT_EQ(stats.max, 0U);
+}
+}
+}
@@ -68,6 +68,7 @@ protected:
         CommuMessage commuMessage;
         commuMessage.payloadLength = bufferLen;
         commuMessage.payload = buffer;
+        commuMessage.sessionId = -1;
 
         ProcessCommuMsg(&commuMessage, &dmsFeatureCallback);
     }
@@ -126,5 +127,69 @@ HWTEST_F(FamgrTest, StartRemoteAbility_002, TestSize.Level1) {
     ClearWant(&want);
     CleanBuild();
 }
+
+/**
+ * @tc.name: StartAbilityFromRemote_001
+ * @tc.desc: Scheduled start from remote reports its result with the originating session
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTD0 AR000FM5TN
+ */
+HWTEST_F(FamgrTest, StartAbilityFromRemote_001, TestSize.Level1) {
+    EXPECT_EQ(StartAbilityFromRemote(nullptr, "MainAbility", 0, nullptr), DMS_EC_INVALID_PARAMETER);
+
+    Want want;
+    if (FillWant(&want, "ohos.dms.example", "MainAbility") != 0) {
+        return;
+    }
+    static int32_t doneSessionId = -1;
+    auto onStartAbilityDone = [] (int32_t sessionId, int8_t errCode) {
+        doneSessionId = sessionId;
+    };
+    RemoteStartData startData = {
+        .want = &want,
+        .sessionId = 5,
+        .onStartAbilityDone = onStartAbilityDone
+    };
+    HandleStartAbilityFromRemote(&startData);
+    EXPECT_EQ(doneSessionId, 5);
+
+    ClearWant(&want);
+}
+
+/**
+ * @tc.name: StartRemoteAbilities_001
+ * @tc.desc: Start remote abilities with invalid batch
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTD0 AR000FM5TN
+ */
+HWTEST_F(FamgrTest, StartRemoteAbilities_001, TestSize.Level1) {
+    Want want;
+    if (FillWant(&want, "ohos.dms.example", "MainAbility") != 0) {
+        return;
+    }
+    CallerInfo callerInfo = {
+        .uid = 0
+    };
+    DmsBatchTarget targets[DMS_MAX_BATCH_TARGETS + 1];
+    for (uint8_t i = 0; i <= DMS_MAX_BATCH_TARGETS; i++) {
+        targets[i].deviceId = "";
+        targets[i].want = &want;
+    }
+    EXPECT_EQ(StartRemoteAbilitiesInner(nullptr, 1, &callerInfo, nullptr), DMS_EC_INVALID_PARAMETER);
+    EXPECT_EQ(StartRemoteAbilitiesInner(targets, 0, &callerInfo, nullptr), DMS_EC_INVALID_PARAMETER);
+    EXPECT_EQ(StartRemoteAbilitiesInner(targets, DMS_MAX_BATCH_TARGETS + 1, &callerInfo, nullptr),
+        DMS_EC_INVALID_PARAMETER);
+    EXPECT_EQ(StartRemoteAbilitiesInner(targets, 1, nullptr, nullptr), DMS_EC_INVALID_PARAMETER);
+    targets[0].deviceId = nullptr;
+    EXPECT_EQ(StartRemoteAbilitiesInner(targets, 1, &callerInfo, nullptr), DMS_EC_INVALID_PARAMETER);
+    targets[0].deviceId = "";
+    char *abilityName = want.element->abilityName;
+    want.element->abilityName = nullptr;
+    EXPECT_EQ(StartRemoteAbilitiesInner(targets, DMS_MAX_BATCH_TARGETS, &callerInfo, nullptr),
+        DMS_EC_INVALID_PARAMETER);
+    want.element->abilityName = abilityName;
+
+    ClearWant(&want);
+}
 }
 }
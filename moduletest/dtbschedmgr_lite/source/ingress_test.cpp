@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+#include "dmslite_feature.h"
+#include "dmslite_ingress.h"
+#include "dmslite_stats.h"
+
+#include "ohos_errno.h"
+
+using namespace testing::ext;
+
+namespace OHOS {
+namespace DistributedSchedule {
+namespace {
+const uint8_t PRODUCER_NUM = 4;
+const int32_t EVENTS_PER_PRODUCER = DMS_INGRESS_RING_SIZE / PRODUCER_NUM;
+int32_t g_nextSessionId = 0;
+bool g_inOrder = true;
+uint8_t g_seen[DMS_INGRESS_RING_SIZE] = { 0 };
+}
+
+class IngressTest : public testing::Test {
+protected:
+    static void SetUpTestCase() { }
+    static void TearDownTestCase() { }
+    virtual void SetUp()
+    {
+        (void)DrainIngressEvents(nullptr);
+        g_nextSessionId = 0;
+        g_inOrder = true;
+        for (int32_t i = 0; i < DMS_INGRESS_RING_SIZE; i++) {
+            g_seen[i] = 0;
+        }
+    }
+    virtual void TearDown() { }
+};
+
+/**
+ * @tc.name: IngressRing_001
+ * @tc.desc: events are drained in push order, a full ring drops and counts the event
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTD0 AR000FM5TN
+ */
+HWTEST_F(IngressTest, IngressRing_001, TestSize.Level1)
+{
+    DmsStats before = { 0 };
+    DmsStats after = { 0 };
+    EXPECT_EQ(GetDmsStats(&before), DMS_EC_SUCCESS);
+    for (int32_t i = 0; i < DMS_INGRESS_RING_SIZE; i++) {
+        EXPECT_EQ(PushIngressEvent(SESSION_OPEN, i, nullptr, 0), EC_SUCCESS);
+    }
+    EXPECT_EQ(PushIngressEvent(SESSION_CLOSE, DMS_INGRESS_RING_SIZE, nullptr, 0), EC_FAILURE);
+    EXPECT_EQ(GetDmsStats(&after), DMS_EC_SUCCESS);
+    EXPECT_EQ(after.ingress.pushed - before.ingress.pushed, static_cast<uint32_t>(DMS_INGRESS_RING_SIZE));
+    EXPECT_EQ(after.ingress.dropped - before.ingress.dropped, 1U);
+    EXPECT_EQ(after.ingress.highWater, static_cast<uint32_t>(DMS_INGRESS_RING_SIZE));
+
+    auto handler = [] (const DmsIngressEvent *event) {
+        g_inOrder = g_inOrder && (event->msgId == SESSION_OPEN) && (event->sessionId == g_nextSessionId);
+        g_nextSessionId++;
+    };
+    EXPECT_EQ(DrainIngressEvents(handler), static_cast<uint32_t>(DMS_INGRESS_RING_SIZE));
+    EXPECT_TRUE(g_inOrder);
+    EXPECT_EQ(DrainIngressEvents(handler), 0U);
+    EXPECT_EQ(PushIngressEvent(SESSION_CLOSE, 0, nullptr, 0), EC_SUCCESS);
+    EXPECT_EQ(DrainIngressEvents(nullptr), 1U);
+}
+
+/**
+ * @tc.name: IngressRing_002
+ * @tc.desc: events pushed from several threads at once are all drained exactly once
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTD0 AR000FM5TN
+ */
+HWTEST_F(IngressTest, IngressRing_002, TestSize.Level1)
+{
+    std::vector<std::thread> producers;
+    for (uint8_t p = 0; p < PRODUCER_NUM; p++) {
+        producers.emplace_back([p] () {
+            for (int32_t i = 0; i < EVENTS_PER_PRODUCER; i++) {
+                EXPECT_EQ(PushIngressEvent(BYTES_RECEIVED, p * EVENTS_PER_PRODUCER + i, nullptr, 0), EC_SUCCESS);
+            }
+        });
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    auto handler = [] (const DmsIngressEvent *event) {
+        ASSERT_GE(event->sessionId, 0);
+        ASSERT_LT(event->sessionId, DMS_INGRESS_RING_SIZE);
+        g_seen[event->sessionId]++;
+    };
+    EXPECT_EQ(DrainIngressEvents(handler), static_cast<uint32_t>(PRODUCER_NUM * EVENTS_PER_PRODUCER));
+    for (int32_t i = 0; i < DMS_INGRESS_RING_SIZE; i++) {
+        EXPECT_EQ(g_seen[i], 1);
+    }
+}
+}
+}
@@ -21,10 +21,14 @@
 #include <sstream>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "bundle_manager.h"
 #include "dmsfwk_interface.h"
+#include "dmslite_bms.h"
 #include "dmslite_permission.h"
+#include "dmslite_stats.h"
+#include "ohos_errno.h"
 
 using namespace std;
 using namespace testing::ext;
@@ -34,11 +38,16 @@ namespace DistributedSchedule {
 namespace {
 #ifndef WEARABLE_PRODUCT
 const int32_t NON_EXISTENT_UID = 12345;
+const int32_t NATIVE_SERVICE_UID = 50;
 const char NATIVE_APPID_DIR[] = "/system/native_appid/";
 const char FOUNDATION_APPID[] = "foundation_signature";
+const char FOUNDATION_NEW_APPID[] = "foundation_new_signature";
 const char PREFIX[] = "uid_";
 const char SUFFIX[] = "_appid";
 const char LAUNCHER_BUNDLE_NAME[] = "com.test.launcher";
+const char NON_EXISTENT_BUNDLE_NAME[] = "com.test.nonexistent";
+const uint32_t PREFETCH_WAIT_TRIES = 100;
+const uint32_t PREFETCH_WAIT_US = 10000;
 #endif
 }
 
@@ -48,6 +57,25 @@ protected:
     static void TearDownTestCase() { }
     virtual void SetUp() { }
     virtual void TearDown() { }
+
+#ifndef WEARABLE_PRODUCT
+    static string WriteNativeAppId(int32_t uid, const char *appId)
+    {
+        DIR *dir = opendir(NATIVE_APPID_DIR);
+        if (dir == nullptr) {
+            mode_t mode = 0700;
+            mkdir(NATIVE_APPID_DIR, mode);
+        } else {
+            closedir(dir);
+        }
+        stringstream filePath;
+        filePath << NATIVE_APPID_DIR << PREFIX << uid << SUFFIX;
+        fstream fs(filePath.str(), ios::out);
+        fs << appId;
+        fs.close();
+        return filePath.str();
+    }
+#endif
 };
 
 #ifndef WEARABLE_PRODUCT
@@ -140,6 +168,162 @@ HWTEST_F(PermissionTest, GetCallerBundleInfo_005, TestSize.Level1)
     EXPECT_EQ(GetCallerBundleInfo(&callerInfo, &callerBundleInfo), DMS_EC_FAILURE);
     ClearBundleInfo(&callerBundleInfo);
 }
+
+/**
+ * @tc.name: GetCallerBundleInfo_006
+ * @tc.desc: native appIds added or removed after the index has been loaded are picked up
+ * @tc.type: FUNC
+ * @tc.require: AR000FU5M6
+ */
+HWTEST_F(PermissionTest, GetCallerBundleInfo_006, TestSize.Level1)
+{
+    CallerInfo callerInfo = {.uid = NATIVE_SERVICE_UID};
+    BundleInfo bundleInfo = {0};
+    LoadNativeAppIdIndex();
+    EXPECT_EQ(GetCallerBundleInfo(&callerInfo, &bundleInfo), DMS_EC_FAILURE);
+
+    string filePath = WriteNativeAppId(NATIVE_SERVICE_UID, FOUNDATION_APPID);
+    EXPECT_EQ(GetCallerBundleInfo(&callerInfo, &bundleInfo), DMS_EC_SUCCESS);
+    ASSERT_NE(bundleInfo.appId, nullptr);
+    EXPECT_EQ(strcmp(bundleInfo.appId, FOUNDATION_APPID), 0);
+    ClearBundleInfo(&bundleInfo);
+
+    remove(filePath.c_str());
+    LoadNativeAppIdIndex();
+    EXPECT_EQ(GetCallerBundleInfo(&callerInfo, &bundleInfo), DMS_EC_FAILURE);
+}
+
+/**
+ * @tc.name: GetCallerAppId_001
+ * @tc.desc: GetCallerAppId serves repeated lookups from cache until the cache is invalidated
+ * @tc.type: FUNC
+ * @tc.require: AR000FU5M6
+ */
+HWTEST_F(PermissionTest, GetCallerAppId_001, TestSize.Level1)
+{
+    string filePath = WriteNativeAppId(FOUNDATION_UID, FOUNDATION_APPID);
+    CallerInfo callerInfo = {.uid = FOUNDATION_UID};
+    DmsStats before = {0};
+    DmsStats after = {0};
+    const char *appId = nullptr;
+
+    InvalidatePermissionCache();
+    EXPECT_EQ(GetDmsStats(&before), DMS_EC_SUCCESS);
+    EXPECT_EQ(GetCallerAppId(&callerInfo, &appId), DMS_EC_SUCCESS);
+    EXPECT_EQ(strcmp(appId, FOUNDATION_APPID), 0);
+    EXPECT_EQ(GetCallerAppId(&callerInfo, &appId), DMS_EC_SUCCESS);
+    EXPECT_EQ(GetDmsStats(&after), DMS_EC_SUCCESS);
+    EXPECT_EQ(after.callerCache.misses - before.callerCache.misses, 1U);
+    EXPECT_EQ(after.callerCache.hits - before.callerCache.hits, 1U);
+
+    WriteNativeAppId(FOUNDATION_UID, FOUNDATION_NEW_APPID);
+    EXPECT_EQ(GetCallerAppId(&callerInfo, &appId), DMS_EC_SUCCESS);
+    EXPECT_EQ(strcmp(appId, FOUNDATION_APPID), 0);
+    InvalidatePermissionCache();
+    EXPECT_EQ(GetCallerAppId(&callerInfo, &appId), DMS_EC_SUCCESS);
+    EXPECT_EQ(strcmp(appId, FOUNDATION_NEW_APPID), 0);
+    remove(filePath.c_str());
+    InvalidatePermissionCache();
+}
+
+/**
+ * @tc.name: GetCallerAppId_002
+ * @tc.desc: GetCallerAppId failed with null parameter or a non-existent uid
+ * @tc.type: FUNC
+ * @tc.require: AR000FU5M6
+ */
+HWTEST_F(PermissionTest, GetCallerAppId_002, TestSize.Level1)
+{
+    CallerInfo callerInfo = {.uid = NON_EXISTENT_UID};
+    const char *appId = nullptr;
+    EXPECT_EQ(GetCallerAppId(nullptr, &appId), DMS_EC_INVALID_PARAMETER);
+    EXPECT_EQ(GetCallerAppId(&callerInfo, nullptr), DMS_EC_INVALID_PARAMETER);
+    EXPECT_NE(GetCallerAppId(&callerInfo, &appId), DMS_EC_SUCCESS);
+}
+
+/**
+ * @tc.name: CheckRemotePermission_001
+ * @tc.desc: CheckRemotePermission failed with null signature or a non-existent callee, which is not cached
+ * @tc.type: FUNC
+ * @tc.require: AR000FU5M6
+ */
+HWTEST_F(PermissionTest, CheckRemotePermission_001, TestSize.Level1)
+{
+    PermissionCheckInfo checkInfo = {
+        .calleeBundleName = NON_EXISTENT_BUNDLE_NAME,
+        .calleeAbilityName = "MainAbility",
+        .callerSignature = nullptr
+    };
+    EXPECT_EQ(CheckRemotePermission(nullptr), DMS_EC_FAILURE);
+    EXPECT_EQ(CheckRemotePermission(&checkInfo), DMS_EC_FAILURE);
+
+    DmsCacheStats before = {0};
+    DmsCacheStats after = {0};
+    checkInfo.callerSignature = FOUNDATION_APPID;
+    GetCalleeCacheStats(&before);
+    EXPECT_NE(CheckRemotePermission(&checkInfo), DMS_EC_SUCCESS);
+    EXPECT_NE(CheckRemotePermission(&checkInfo), DMS_EC_SUCCESS);
+    GetCalleeCacheStats(&after);
+    EXPECT_EQ(after.misses - before.misses, 2U);
+    EXPECT_EQ(after.hits, before.hits);
+}
+
+/**
+ * @tc.name: PrefetchBundleInfo_001
+ * @tc.desc: a prefetched bundle info is taken once, with the result of the bms query
+ * @tc.type: FUNC
+ * @tc.require: AR000FU5M6
+ */
+HWTEST_F(PermissionTest, PrefetchBundleInfo_001, TestSize.Level1)
+{
+    BundleInfo bundleInfo = {0};
+    EXPECT_EQ(DmsGetBundleInfo(nullptr, 0, &bundleInfo), DMS_EC_INVALID_PARAMETER);
+    EXPECT_NE(PrefetchBundleInfo(NON_EXISTENT_BUNDLE_NAME), EC_SUCCESS);
+
+    ASSERT_EQ(StartBmsPrefetch(), EC_SUCCESS);
+    EXPECT_EQ(PrefetchBundleInfo(NON_EXISTENT_BUNDLE_NAME), EC_SUCCESS);
+    EXPECT_EQ(TakePrefetchedBundleInfo(LAUNCHER_BUNDLE_NAME, &bundleInfo), DMS_EC_FAILURE);
+    for (uint32_t i = 0; i < PREFETCH_WAIT_TRIES && !IsBundleInfoPrefetched(NON_EXISTENT_BUNDLE_NAME); i++) {
+        usleep(PREFETCH_WAIT_US);
+    }
+    ASSERT_TRUE(IsBundleInfoPrefetched(NON_EXISTENT_BUNDLE_NAME));
+    EXPECT_EQ(TakePrefetchedBundleInfo(NON_EXISTENT_BUNDLE_NAME, &bundleInfo),
+        DmsGetBundleInfo(NON_EXISTENT_BUNDLE_NAME, 0, &bundleInfo));
+    EXPECT_EQ(TakePrefetchedBundleInfo(NON_EXISTENT_BUNDLE_NAME, &bundleInfo), DMS_EC_FAILURE);
+    StopBmsPrefetch();
+    ClearBundleInfo(&bundleInfo);
+}
+
+/**
+ * @tc.name: RemoteDenial_001
+ * @tc.desc: a refused request of a peer is answered from the denial cache until a bundle changes
+ * @tc.type: FUNC
+ * @tc.require: AR000FU5M6
+ */
+HWTEST_F(PermissionTest, RemoteDenial_001, TestSize.Level1)
+{
+    const char peer[] = "denial_peer";
+    PermissionCheckInfo checkInfo = {
+        .calleeBundleName = LAUNCHER_BUNDLE_NAME,
+        .calleeAbilityName = "MainAbility",
+        .callerSignature = FOUNDATION_APPID
+    };
+    EXPECT_EQ(CheckRemoteDenial(peer, &checkInfo), DMS_EC_SUCCESS);
+    RecordRemoteDenial(peer, &checkInfo, DMS_EC_FAILURE);
+    EXPECT_EQ(CheckRemoteDenial(peer, &checkInfo), DMS_EC_SUCCESS);
+    RecordRemoteDenial(peer, &checkInfo, DMS_EC_GET_BMS_FAILURE);
+    EXPECT_EQ(CheckRemoteDenial(peer, &checkInfo), DMS_EC_SUCCESS);
+
+    RecordRemoteDenial(peer, &checkInfo, DMS_EC_CHECK_PERMISSION_FAILURE);
+    EXPECT_EQ(CheckRemoteDenial(peer, &checkInfo), DMS_EC_CHECK_PERMISSION_FAILURE);
+    EXPECT_EQ(CheckRemoteDenial("other_peer", &checkInfo), DMS_EC_SUCCESS);
+    checkInfo.callerSignature = FOUNDATION_NEW_APPID;
+    EXPECT_EQ(CheckRemoteDenial(peer, &checkInfo), DMS_EC_SUCCESS);
+
+    checkInfo.callerSignature = FOUNDATION_APPID;
+    InvalidatePermissionCache();
+    EXPECT_EQ(CheckRemoteDenial(peer, &checkInfo), DMS_EC_SUCCESS);
+}
 #endif
 }
 }
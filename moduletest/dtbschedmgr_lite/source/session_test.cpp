@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include "dmslite_feature.h"
+#include "dmslite_flow.h"
+#include "dmslite_packet.h"
+#include "dmslite_session.h"
+#include "dmslite_stats.h"
+#include "dmslite_tlv_common.h"
+#include "dmslite_utils.h"
+#include "dmslite_worker.h"
+
+#include "ohos_errno.h"
+#include "securec.h"
+#include "session.h"
+
+using namespace testing::ext;
+
+namespace OHOS {
+namespace DistributedSchedule {
+namespace {
+const int32_t REPLY_PADDING_SIZE = 200;
+const uint8_t BATCH_SIZE = 3;
+const char *INVALID_DEVICE_ID = "";
+uint8_t g_deviceResultNum = 0;
+uint8_t g_batchSuccessNum = 0;
+uint8_t g_batchTotalNum = 0;
+uint8_t g_flowDoneNum = 0;
+int32_t g_flowResult = DMS_EC_SUCCESS;
+const int32_t FLOW_SESSION_ID = 5;
+const int32_t INVALID_SESSION_ID = -1;
+char g_flowFrame[] = { 0x01, 0x02, 0x00, 0x01 };
+
+void OnTestFlowDone(const DmsFlow *flow, int32_t result)
+{
+    g_flowDoneNum++;
+    g_flowResult = result;
+}
+}
+
+class SessionTest : public testing::Test {
+protected:
+    static void SetUpTestCase() { }
+    static void TearDownTestCase() { }
+    virtual void SetUp()
+    {
+        PreprareBuild();
+    }
+    virtual void TearDown()
+    {
+        CleanBuild();
+    }
+};
+
+/**
+ * @tc.name: SelectSessionDataType_001
+ * @tc.desc: small reply frame is sent in message mode
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(SessionTest, SelectSessionDataType_001, TestSize.Level1)
+{
+    EXPECT_TRUE(MarshallUint16(DMS_MSG_CMD_REPLY, COMMAND_ID));
+    EXPECT_TRUE(MarshallInt32(DMS_EC_SUCCESS, REPLY_ERR_CODE));
+    EXPECT_EQ(PeekCommandId((const uint8_t *)GetPacketBufPtr(), GetPacketSize()), DMS_MSG_CMD_REPLY);
+    EXPECT_EQ(SelectSessionDataType(GetPacketBufPtr(), GetPacketSize()), TYPE_MESSAGE);
+}
+
+/**
+ * @tc.name: SelectSessionDataType_002
+ * @tc.desc: start-ability frame is always sent in bytes mode
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(SessionTest, SelectSessionDataType_002, TestSize.Level1)
+{
+    EXPECT_TRUE(MarshallUint16(DMS_MSG_CMD_START_FA, COMMAND_ID));
+    EXPECT_TRUE(MarshallString("ohos.dms.example", CALLEE_BUNDLE_NAME));
+    EXPECT_EQ(SelectSessionDataType(GetPacketBufPtr(), GetPacketSize()), TYPE_BYTES);
+}
+
+/**
+ * @tc.name: SelectSessionDataType_003
+ * @tc.desc: oversize control frame and malformed frame fall back to bytes mode
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(SessionTest, SelectSessionDataType_003, TestSize.Level1)
+{
+    char padding[REPLY_PADDING_SIZE] = {0};
+    EXPECT_TRUE(MarshallUint16(DMS_MSG_CMD_REPLY, COMMAND_ID));
+    EXPECT_TRUE(MarshallRawData(padding, CALLER_PAYLOAD, sizeof(padding)));
+    EXPECT_EQ(SelectSessionDataType(GetPacketBufPtr(), GetPacketSize()), TYPE_BYTES);
+
+    const char malformed[] = { 0x02, 0x02, 0x00, 0x01 };
+    EXPECT_EQ(PeekCommandId((const uint8_t *)malformed, sizeof(malformed)), 0);
+    EXPECT_EQ(SelectSessionDataType(malformed, sizeof(malformed)), TYPE_BYTES);
+    EXPECT_EQ(SelectSessionDataType(nullptr, 0), TYPE_BYTES);
+}
+
+/**
+ * @tc.name: SendDmsBatchMessage_001
+ * @tc.desc: every target of a batch reports its own result before the aggregate result
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(SessionTest, SendDmsBatchMessage_001, TestSize.Level1)
+{
+    EXPECT_TRUE(MarshallUint16(DMS_MSG_CMD_START_FA, COMMAND_ID));
+    uint16_t frameLen = GetPacketSize();
+    char *frame = (char *)DMS_ALLOC(frameLen);
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(memcpy_s(frame, frameLen, GetPacketBufPtr(), frameLen), EOK);
+
+    DmsBatchEntry entries[BATCH_SIZE];
+    for (uint8_t i = 0; i < BATCH_SIZE; i++) {
+        entries[i].deviceId = INVALID_DEVICE_ID;
+        entries[i].frame = frame;
+        entries[i].frameLen = frameLen;
+        entries[i].ownsFrame = (i == 0);
+    }
+    IDmsBatchListener listener = {
+        .OnDeviceResult = [] (uint8_t index, int32_t ret) {
+            EXPECT_EQ(index, g_deviceResultNum);
+            EXPECT_EQ(ret, DMS_REC_OPEN_SESSION_FAIL);
+            g_deviceResultNum++;
+        },
+        .OnBatchResult = [] (uint8_t successNum, uint8_t totalNum) {
+            g_batchSuccessNum = successNum;
+            g_batchTotalNum = totalNum;
+        }
+    };
+    EXPECT_EQ(SendDmsBatchMessage(entries, BATCH_SIZE, &listener), EC_SUCCESS);
+    EXPECT_EQ(g_deviceResultNum, BATCH_SIZE);
+    EXPECT_EQ(g_batchSuccessNum, 0);
+    EXPECT_EQ(g_batchTotalNum, BATCH_SIZE);
+    EXPECT_FALSE(IsDmsBatchBusy());
+    EXPECT_FALSE(HandleFlowReply(0, DMS_EC_SUCCESS));
+}
+
+/**
+ * @tc.name: StartLane_001
+ * @tc.desc: start requests from remote go to the worker task once it is up, to the dms task otherwise
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTD0 AR000FM5TN
+ */
+HWTEST_F(SessionTest, StartLane_001, TestSize.Level1)
+{
+    const Identity *dmsIdentity = &(GetDmsLiteFeature()->identity);
+#ifdef DMS_MULTI_WORKER
+    if (IsWorkerLaneEnabled()) {
+        EXPECT_NE(GetStartLaneIdentity(), dmsIdentity);
+        return;
+    }
+#else
+    EXPECT_FALSE(IsWorkerLaneEnabled());
+#endif
+    EXPECT_EQ(GetStartLaneIdentity(), dmsIdentity);
+}
+
+/**
+ * @tc.name: FlowStateMachine_001
+ * @tc.desc: a flow follows its events to Done, reports once and ignores events its state does not accept
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(SessionTest, FlowStateMachine_001, TestSize.Level1)
+{
+    g_flowDoneNum = 0;
+    uint8_t activeNum = GetActiveFlowNum();
+    DmsFlow *flow = CreateFlow(g_flowFrame, sizeof(g_flowFrame), false, OnTestFlowDone);
+    ASSERT_NE(flow, nullptr);
+    EXPECT_EQ(flow->state, FLOW_MARSHALLED);
+    EXPECT_EQ(GetActiveFlowNum(), activeNum + 1);
+
+    flow->sessionId = FLOW_SESSION_ID;
+    EXPECT_TRUE(AdvanceFlow(flow, FLOW_EVENT_OPEN, DMS_EC_SUCCESS));
+    EXPECT_EQ(FindFlowBySession(FLOW_SESSION_ID), flow);
+    EXPECT_FALSE(AdvanceFlow(flow, FLOW_EVENT_REPLY, DMS_EC_SUCCESS));
+    EXPECT_EQ(flow->state, FLOW_OPENING);
+    EXPECT_TRUE(AdvanceFlow(flow, FLOW_EVENT_OPENED, DMS_EC_SUCCESS));
+    EXPECT_TRUE(AdvanceFlow(flow, FLOW_EVENT_SEND_DONE, DMS_EC_SUCCESS));
+    EXPECT_EQ(flow->state, FLOW_AWAITING_REPLY);
+    EXPECT_TRUE(HandleFlowReply(FLOW_SESSION_ID, DMS_EC_CHECK_PERMISSION_FAILURE));
+
+    EXPECT_EQ(g_flowDoneNum, 1);
+    EXPECT_EQ(g_flowResult, DMS_EC_CHECK_PERMISSION_FAILURE);
+    EXPECT_EQ(GetActiveFlowNum(), activeNum);
+    EXPECT_EQ(FindFlowBySession(FLOW_SESSION_ID), nullptr);
+    EXPECT_FALSE(HandleFlowReply(FLOW_SESSION_ID, DMS_EC_SUCCESS));
+    EXPECT_FALSE(AdvanceFlow(flow, FLOW_EVENT_FAIL, DMS_EC_FAILURE));
+    EXPECT_EQ(g_flowDoneNum, 1);
+    EXPECT_STREQ(GetFlowStateName(FLOW_TIMED_OUT), "TimedOut");
+}
+
+/**
+ * @tc.name: FlowStateMachine_002
+ * @tc.desc: flows run side by side up to the pool size, the oldest one sets the deadline and all time out together
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(SessionTest, FlowStateMachine_002, TestSize.Level1)
+{
+    g_flowDoneNum = 0;
+    uint8_t freeNum = DMS_MAX_FLOWS - GetActiveFlowNum();
+    uint64_t deadlineMs = 0;
+    uint64_t firstBeginMs = 0;
+    for (uint8_t i = 0; i < freeNum; i++) {
+        DmsFlow *flow = CreateFlow(g_flowFrame, sizeof(g_flowFrame), false, OnTestFlowDone);
+        ASSERT_NE(flow, nullptr);
+        flow->sessionId = FLOW_SESSION_ID + i;
+        EXPECT_TRUE(AdvanceFlow(flow, FLOW_EVENT_OPEN, DMS_EC_SUCCESS));
+        firstBeginMs = (i == 0) ? flow->beginMs : firstBeginMs;
+    }
+    ASSERT_TRUE(GetNextFlowDeadline(&deadlineMs));
+    EXPECT_EQ(deadlineMs, firstBeginMs + DMS_FLOW_TIMEOUT_MS);
+    EXPECT_EQ(CreateFlow(g_flowFrame, sizeof(g_flowFrame), false, OnTestFlowDone), nullptr);
+    EXPECT_TRUE(IsDmsBusy());
+    EXPECT_EQ(ExpireFlows(GetMonotonicMs()), 0);
+
+    EXPECT_EQ(ExpireFlows(GetMonotonicMs() + DMS_FLOW_TIMEOUT_MS), freeNum);
+    EXPECT_EQ(g_flowDoneNum, freeNum);
+    EXPECT_EQ(g_flowResult, DMS_EC_FAILURE);
+    EXPECT_EQ(GetActiveFlowNum(), 0);
+    EXPECT_FALSE(IsDmsBusy());
+    EXPECT_FALSE(GetNextFlowDeadline(&deadlineMs));
+}
+
+/**
+ * @tc.name: Stats_001
+ * @tc.desc: timeouts, session events, failed replies and parse errors move their counters
+ * @tc.type: FUNC
+ * @tc.require: SR000FKTLR
+ */
+HWTEST_F(SessionTest, Stats_001, TestSize.Level1)
+{
+    EXPECT_EQ(GetDmsStats(nullptr), DMS_EC_INVALID_PARAMETER);
+    DmsStats before;
+    ASSERT_EQ(GetDmsStats(&before), DMS_EC_SUCCESS);
+
+    DmsFlow *flow = CreateFlow(g_flowFrame, sizeof(g_flowFrame), false, OnTestFlowDone);
+    ASSERT_NE(flow, nullptr);
+    flow->sessionId = FLOW_SESSION_ID;
+    EXPECT_TRUE(AdvanceFlow(flow, FLOW_EVENT_OPEN, DMS_EC_SUCCESS));
+    EXPECT_EQ(ExpireFlows(GetMonotonicMs() + DMS_FLOW_TIMEOUT_MS), 1);
+    HandleSessionOpenFailed(FLOW_SESSION_ID);
+    HandleSessionClosed(FLOW_SESSION_ID);
+    HandleRemoteStartDone(INVALID_SESSION_ID, DMS_EC_SUCCESS);
+    CountParseError(DMS_TLV_ERR_OUT_OF_ORDER);
+    CountParseError(DMS_TLV_SUCCESS);
+    CountParseError(DMS_PARSE_ERROR_NUM);
+    AddDmsStat(DMS_STAT_BYTES_OUT, sizeof(g_flowFrame));
+
+    DmsStats after;
+    ASSERT_EQ(GetDmsStats(&after), DMS_EC_SUCCESS);
+    EXPECT_EQ(after.timeouts, before.timeouts + 1);
+    EXPECT_EQ(after.sessionOpenFailures, before.sessionOpenFailures + 1);
+    EXPECT_EQ(after.sessionCloses, before.sessionCloses + 2);
+    EXPECT_EQ(after.replyFailures, before.replyFailures + 1);
+    EXPECT_EQ(after.parseErrors[DMS_TLV_ERR_OUT_OF_ORDER], before.parseErrors[DMS_TLV_ERR_OUT_OF_ORDER] + 1);
+    EXPECT_EQ(after.parseErrors[DMS_TLV_SUCCESS], before.parseErrors[DMS_TLV_SUCCESS]);
+    EXPECT_EQ(after.bytesOut, before.bytesOut + sizeof(g_flowFrame));
+    DumpDmsStats();
+}
+}
+}
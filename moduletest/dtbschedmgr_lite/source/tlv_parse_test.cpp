@@ -15,8 +15,16 @@
 
 #include "gtest/gtest.h"
 
+#include <vector>
+
+#include "dmslite_alloc_tracker.h"
+#include "dmslite_event.h"
+#include "dmslite_packet.h"
 #include "dmslite_parser.h"
+#include "dmslite_pool.h"
+#include "dmslite_stats.h"
 #include "dmslite_tlv_common.h"
+#include "securec.h"
 
 using namespace testing::ext;
 
@@ -40,6 +48,7 @@ protected:
         CommuMessage commuMessage;
         commuMessage.payloadLength = bufferLen;
         commuMessage.payload = buffer;
+        commuMessage.sessionId = -1;
 
         ProcessCommuMsg(&commuMessage, &dmsFeatureCallback);
     }
@@ -178,6 +187,43 @@ HWTEST_F(TlvParseTest, AbnormalPackageBadNodeNum_002, TestSize.Level1) {
     RunTest(buffer, sizeof(buffer), onTlvParseDone, nullptr);
 }
 
+/**
+ * @tc.name: AbnormalPackageBadNodeNum_003
+ * @tc.desc: abnormal package with more nodes than a frame may carry, the nodes of a frame point into it
+ * @tc.type: FUNC
+ * @tc.require: AR000E0DE5
+ */
+HWTEST_F(TlvParseTest, AbnormalPackageBadNodeNum_003, TestSize.Level1) {
+    static const uint8_t nodeSize = 3;
+    static uint8_t buffer[(MAX_TLV_NODE_NUM + 1) * nodeSize];
+    for (uint8_t i = 0; i <= MAX_TLV_NODE_NUM; i++) {
+        buffer[i * nodeSize] = i + 1;
+        buffer[i * nodeSize + 1] = 1;
+        buffer[i * nodeSize + 2] = i;
+    }
+
+    auto onTooManyNodes = [] (int8_t errCode, const void *dmsMsg) {
+        EXPECT_EQ(errCode, DMS_TLV_ERR_BAD_NODE_NUM);
+        EXPECT_EQ(dmsMsg, nullptr);
+    };
+    RunTest(buffer, sizeof(buffer), onTooManyNodes, nullptr);
+
+    auto onMostNodes = [] (int8_t errCode, const void *dmsMsg) {
+        const TlvNode *tlvHead = reinterpret_cast<const TlvNode *>(dmsMsg);
+        ASSERT_EQ(errCode, DMS_TLV_SUCCESS);
+        ASSERT_EQ(tlvHead->num, MAX_TLV_NODE_NUM);
+        EXPECT_EQ(tlvHead->buffer, buffer);
+        EXPECT_EQ(tlvHead->types[MAX_TLV_NODE_NUM - 1], MAX_TLV_NODE_NUM);
+        EXPECT_EQ(tlvHead->offsets[MAX_TLV_NODE_NUM - 1], MAX_TLV_NODE_NUM * nodeSize - 1);
+        EXPECT_EQ(tlvHead->lengths[MAX_TLV_NODE_NUM - 1], 1);
+        uint16_t length = 0;
+        const uint8_t *value = UnMarshallRawData(tlvHead, MAX_TLV_NODE_NUM, &length);
+        ASSERT_NE(value, nullptr);
+        EXPECT_EQ(*value, MAX_TLV_NODE_NUM - 1);
+    };
+    RunTest(buffer, sizeof(buffer) - nodeSize, onMostNodes, nullptr);
+}
+
 /**
  * @tc.name: AbnormalPackageBadLength_001
  * @tc.desc: abnormal package tlv node without value
@@ -311,5 +357,300 @@ HWTEST_F(TlvParseTest, AbnormalPackageBadSource_001, TestSize.Level1) {
 
     RunTest(buffer, sizeof(buffer), onTlvParseDone, nullptr);
 }
+
+/**
+ * @tc.name: SignatureDigestPackage_001
+ * @tc.desc: a start frame of the digest version carries the caller signature as raw bytes
+ * @tc.type: FUNC
+ * @tc.require: AR000E0DE0
+ */
+HWTEST_F(TlvParseTest, SignatureDigestPackage_001, TestSize.Level1) {
+    uint8_t digest[SIGNATURE_DIGEST_LEN];
+    for (uint8_t i = 0; i < SIGNATURE_DIGEST_LEN; i++) {
+        digest[i] = i;
+    }
+    ASSERT_TRUE(PreprareBuild());
+    ASSERT_TRUE(MarshallUint16(DMS_MSG_CMD_START_FA, COMMAND_ID)
+        && MarshallUint16(DMS_VERSION_SIGNATURE_DIGEST, DMS_VERSION)
+        && MarshallString("com.huawei.launcher", CALLEE_BUNDLE_NAME)
+        && MarshallString("MainActivity", CALLEE_ABILITY_NAME)
+        && MarshallRawData(digest, CALLER_SIGNATURE, SIGNATURE_DIGEST_LEN));
+
+    auto onTlvParseDone = [] (int8_t errCode, const void *dmsMsg) {
+        const TlvNode *tlvHead = reinterpret_cast<const TlvNode *>(dmsMsg);
+        EXPECT_EQ(errCode, DMS_TLV_SUCCESS);
+        EXPECT_EQ(UnMarshallUint16(tlvHead, DMS_VERSION), DMS_VERSION_SIGNATURE_DIGEST);
+        uint16_t length = 0;
+        const uint8_t *value = UnMarshallRawData(tlvHead, CALLER_SIGNATURE, &length);
+        ASSERT_NE(value, nullptr);
+        ASSERT_EQ(length, SIGNATURE_DIGEST_LEN);
+        for (uint8_t i = 0; i < SIGNATURE_DIGEST_LEN; i++) {
+            EXPECT_EQ(value[i], i);
+        }
+        EXPECT_EQ(UnMarshallRawData(tlvHead, CALLER_PAYLOAD, &length), nullptr);
+    };
+
+    RunTest(reinterpret_cast<const uint8_t *>(GetPacketBufPtr()), GetPacketSize(), onTlvParseDone, nullptr);
+    CleanBuild();
+}
+
+/**
+ * @tc.name: FramedPackage_001
+ * @tc.desc: a frame behind the fixed header is dispatched on the header and parsed like the frame alone
+ * @tc.type: FUNC
+ * @tc.require: AR000E0DE0
+ */
+HWTEST_F(TlvParseTest, FramedPackage_001, TestSize.Level1) {
+    const uint32_t requestId = 0x01020304;
+    ASSERT_TRUE(PreprareBuild());
+    ASSERT_TRUE(MarshallUint16(DMS_MSG_CMD_START_FA, COMMAND_ID)
+        && MarshallUint16(DMS_VERSION_SIGNATURE_DIGEST, DMS_VERSION)
+        && MarshallString("com.huawei.launcher", CALLEE_BUNDLE_NAME)
+        && MarshallString("MainActivity", CALLEE_ABILITY_NAME));
+    const uint16_t bodyLength = GetPacketSize();
+    ASSERT_TRUE(PrependFrameHeader(DMS_MSG_CMD_START_FA, requestId));
+    const uint8_t *frame = reinterpret_cast<const uint8_t *>(GetPacketBufPtr());
+    ASSERT_EQ(GetPacketSize(), bodyLength + DMS_FRAME_HEADER_LEN);
+
+    DmsFrameHeader header;
+    ASSERT_TRUE(HasFrameHeader(frame, GetPacketSize()));
+    ASSERT_EQ(ReadFrameHeader(frame, GetPacketSize(), &header), DMS_TLV_SUCCESS);
+    EXPECT_EQ(header.version, DMS_FRAME_HEADER_VERSION);
+    EXPECT_EQ(header.commandId, DMS_MSG_CMD_START_FA);
+    EXPECT_EQ(header.bodyLength, bodyLength);
+    EXPECT_EQ(header.requestId, requestId);
+    EXPECT_EQ(PeekCommandId(frame, GetPacketSize()), DMS_MSG_CMD_START_FA);
+    EXPECT_FALSE(HasFrameHeader(frame + DMS_FRAME_HEADER_LEN, bodyLength));
+
+    auto onTlvParseDone = [] (int8_t errCode, const void *dmsMsg) {
+        const TlvNode *tlvHead = reinterpret_cast<const TlvNode *>(dmsMsg);
+        EXPECT_EQ(errCode, DMS_TLV_SUCCESS);
+        EXPECT_EQ(UnMarshallUint16(tlvHead, COMMAND_ID), DMS_MSG_CMD_START_FA);
+        EXPECT_EQ(std::string(UnMarshallString(tlvHead, CALLEE_ABILITY_NAME)), "MainActivity");
+    };
+    RunTest(frame, GetPacketSize(), onTlvParseDone, nullptr);
+    CleanBuild();
+}
+
+/**
+ * @tc.name: FramedPackage_002
+ * @tc.desc: frames with a bad header or an unknown command are refused without parsing their body
+ * @tc.type: FUNC
+ * @tc.require: AR000E0DE0
+ */
+HWTEST_F(TlvParseTest, FramedPackage_002, TestSize.Level1) {
+    const uint16_t unknownCommand = 0x77;
+    uint8_t frame[MAX_DMS_MSG_LENGTH];
+    ASSERT_TRUE(PreprareBuild());
+    ASSERT_TRUE(MarshallUint16(DMS_MSG_CMD_REPLY, COMMAND_ID)
+        && MarshallUint16(DMS_VERSION_VALUE, DMS_VERSION)
+        && MarshallInt32(DMS_EC_SUCCESS, REPLY_ERR_CODE));
+    const uint16_t bodyLength = GetPacketSize();
+    const uint16_t frameLength = bodyLength + DMS_FRAME_HEADER_LEN;
+    ASSERT_EQ(memcpy_s(frame + DMS_FRAME_HEADER_LEN, sizeof(frame) - DMS_FRAME_HEADER_LEN,
+        GetPacketBufPtr(), bodyLength), EOK);
+    CleanBuild();
+
+    DmsStats before;
+    ASSERT_EQ(GetDmsStats(&before), DMS_EC_SUCCESS);
+    IDmsFeatureCallback dmsFeatureCallback = {
+        .onTlvParseDone = [] (int8_t errCode, const void *dmsMsg) {
+            EXPECT_NE(errCode, DMS_TLV_SUCCESS);
+            EXPECT_EQ(dmsMsg, nullptr);
+        }
+    };
+    CommuMessage commuMessage = {
+        .payloadLength = frameLength,
+        .payload = frame,
+        .sessionId = -1
+    };
+    DmsFrameHeader header = {
+        .commandId = unknownCommand,
+        .bodyLength = bodyLength
+    };
+    ASSERT_TRUE(WriteFrameHeader(&header, frame, sizeof(frame)));
+    EXPECT_FALSE(IsKnownCommand(unknownCommand));
+    EXPECT_EQ(PeekCommandId(frame, frameLength), unknownCommand);
+    EXPECT_EQ(ProcessCommuMsg(&commuMessage, &dmsFeatureCallback), DMS_EC_UNKNOWN_COMMAND_ID);
+
+    /* the body says it is a reply */
+    header.commandId = DMS_MSG_CMD_START_FA;
+    ASSERT_TRUE(WriteFrameHeader(&header, frame, sizeof(frame)));
+    EXPECT_EQ(ProcessCommuMsg(&commuMessage, &dmsFeatureCallback), DMS_EC_PARSE_TLV_FAILURE);
+
+    header.commandId = DMS_MSG_CMD_REPLY;
+    ASSERT_TRUE(WriteFrameHeader(&header, frame, sizeof(frame)));
+    commuMessage.payloadLength = frameLength - 1;
+    EXPECT_EQ(PeekCommandId(frame, frameLength - 1), 0);
+    EXPECT_EQ(ProcessCommuMsg(&commuMessage, &dmsFeatureCallback), DMS_EC_PARSE_TLV_FAILURE);
+
+    commuMessage.payloadLength = frameLength;
+    frame[2] = DMS_FRAME_HEADER_VERSION + 1;
+    EXPECT_EQ(ProcessCommuMsg(&commuMessage, &dmsFeatureCallback), DMS_EC_PARSE_TLV_FAILURE);
+
+    DmsStats after;
+    ASSERT_EQ(GetDmsStats(&after), DMS_EC_SUCCESS);
+    EXPECT_EQ(after.parseErrors[DMS_TLV_ERR_UNKNOWN_TYPE], before.parseErrors[DMS_TLV_ERR_UNKNOWN_TYPE] + 1);
+    EXPECT_EQ(after.parseErrors[DMS_TLV_ERR_BAD_HEADER], before.parseErrors[DMS_TLV_ERR_BAD_HEADER] + 2);
+    EXPECT_EQ(after.parseErrors[DMS_TLV_ERR_LEN], before.parseErrors[DMS_TLV_ERR_LEN] + 1);
+}
+
+/**
+ * @tc.name: EventRing_001
+ * @tc.desc: parsing records binary events which are only turned into text when dumped
+ * @tc.type: FUNC
+ * @tc.require: AR000E0DE0
+ */
+HWTEST_F(TlvParseTest, EventRing_001, TestSize.Level1) {
+    const uint8_t abilityName[] = "MainAbility";
+    TlvNode tlvHead = {
+        .buffer = abilityName,
+        .num = 1,
+        .types = {CALLEE_ABILITY_NAME},
+        .offsets = {0},
+        .lengths = {sizeof(abilityName)}
+    };
+    ClearDmsEvents();
+    RecordDmsEvent(DMS_EVENT_TLV_NODE, CALLEE_ABILITY_NAME, sizeof(abilityName));
+    EXPECT_EQ(std::string(UnMarshallString(&tlvHead, CALLEE_ABILITY_NAME)), "MainAbility");
+    RecordDmsEvent(DMS_EVENT_PARSE_DONE, DMS_TLV_SUCCESS, sizeof(abilityName));
+
+    DmsEvent events[DMS_EVENT_RING_SIZE];
+    ASSERT_EQ(CopyDmsEvents(events, DMS_EVENT_RING_SIZE), 3U);
+    EXPECT_EQ(events[0].id, DMS_EVENT_TLV_NODE);
+    EXPECT_EQ(events[1].id, DMS_EVENT_STRING_FIELD);
+    EXPECT_EQ(events[1].arg0, CALLEE_ABILITY_NAME);
+    EXPECT_EQ(events[1].arg1, static_cast<int32_t>(sizeof(abilityName)));
+    EXPECT_EQ(events[2].id, DMS_EVENT_PARSE_DONE);
+    EXPECT_LE(events[0].timeUs, events[2].timeUs);
+
+    static std::string dumped;
+    dumped.clear();
+    auto sink = [] (const char *line, void *context) {
+        (*static_cast<uint32_t *>(context))++;
+        dumped = line;
+    };
+    uint32_t lineNum = 0;
+    EXPECT_EQ(DumpDmsEvents(sink, &lineNum), 3U);
+    EXPECT_EQ(lineNum, 3U);
+    EXPECT_NE(dumped.find("parse done errCode 0, length 12"), std::string::npos);
+
+    for (uint32_t i = 0; i < DMS_EVENT_RING_SIZE + 1; i++) {
+        RecordDmsEvent(DMS_EVENT_REPLY, i, 0);
+    }
+    ASSERT_EQ(CopyDmsEvents(events, DMS_EVENT_RING_SIZE), static_cast<uint32_t>(DMS_EVENT_RING_SIZE));
+    EXPECT_EQ(events[0].arg0, 1);
+    EXPECT_EQ(events[DMS_EVENT_RING_SIZE - 1].arg0, DMS_EVENT_RING_SIZE);
+}
+
+/**
+ * @tc.name: AllocTracking_001
+ * @tc.desc: tracked blocks are counted per call site until freed or handed off, a reset keeps the live bytes
+ * @tc.type: FUNC
+ * @tc.require: AR000E0DE0
+ */
+HWTEST_F(TlvParseTest, AllocTracking_001, TestSize.Level1) {
+    const char *nodeSite = "tlv_alloc_node.c";
+    const char *frameSite = "tlv_alloc_frame.c";
+    const size_t nodeSize = 24;
+    DmsAllocTotals totals;
+    ResetAllocTracking();
+    /* blocks other tests left live are not part of the counts */
+    EXPECT_EQ(GetAllocTotals(&totals), DMS_EC_SUCCESS);
+    const uint32_t liveBefore = totals.liveBytes;
+    void *first = DmsTrackedAlloc(nodeSize, nodeSite, 1);
+    void *second = DmsTrackedAlloc(nodeSize, nodeSite, 1);
+    void *frame = DmsTrackedSharedAlloc(64, frameSite, 2);
+    void *foreign = malloc(8);
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    ASSERT_NE(frame, nullptr);
+    DmsTrackedFree(first);
+    DmsTrackHandoff(frame);
+    free(frame);
+    DmsTrackedFree(foreign);
+
+    EXPECT_EQ(GetAllocTotals(&totals), DMS_EC_SUCCESS);
+    EXPECT_EQ(totals.allocs, 3U);
+    EXPECT_EQ(totals.frees, 2U);
+    EXPECT_EQ(totals.bytes, 2 * nodeSize + 64);
+    EXPECT_EQ(totals.liveBytes, liveBefore + nodeSize);
+    EXPECT_EQ(totals.peakLiveBytes, liveBefore + 2 * nodeSize + 64);
+    EXPECT_EQ(totals.untrackedFrees, 1U);
+    EXPECT_EQ(GetAllocTotals(nullptr), DMS_EC_INVALID_PARAMETER);
+
+    DmsAllocSiteStats sites[DMS_ALLOC_MAX_SITES];
+    uint16_t num = GetAllocSites(sites, DMS_ALLOC_MAX_SITES);
+    const DmsAllocSiteStats *node = nullptr;
+    for (uint16_t i = 0; i < num; i++) {
+        if (std::string(sites[i].file) == nodeSite) {
+            node = &sites[i];
+        }
+    }
+    ASSERT_NE(node, nullptr);
+    EXPECT_EQ(node->allocs, 2U);
+    EXPECT_EQ(node->frees, 1U);
+    EXPECT_EQ(node->liveBytes, nodeSize);
+    EXPECT_EQ(node->lifetimeUs.count, 1U);
+
+    ResetAllocTracking();
+    EXPECT_EQ(GetAllocTotals(&totals), DMS_EC_SUCCESS);
+    EXPECT_EQ(totals.allocs, 0U);
+    EXPECT_EQ(totals.peakLiveBytes, liveBefore + nodeSize);
+    DmsTrackedFree(second);
+    EXPECT_EQ(GetAllocTotals(&totals), DMS_EC_SUCCESS);
+    EXPECT_EQ(totals.frees, 1U);
+    EXPECT_EQ(totals.liveBytes, liveBefore);
+}
+
+/**
+ * @tc.name: AllocPool_001
+ * @tc.desc: blocks come from the smallest class that fits, oversized and exhausted requests go to the heap
+ * @tc.type: FUNC
+ * @tc.require: AR000E0DE0
+ */
+HWTEST_F(TlvParseTest, AllocPool_001, TestSize.Level1) {
+    const size_t nodeSize = 24;
+    const size_t frameSize = 1024;
+    const size_t alignment = 16;
+    DmsPoolStats before;
+    DmsPoolStats after;
+    GetDmsPoolStats(&before);
+    void *node = DmsPoolAlloc(nodeSize);
+    ASSERT_NE(node, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(node) % alignment, 0U);
+    GetDmsPoolStats(&after);
+    EXPECT_EQ(after.classes[0].allocs, before.classes[0].allocs + 1);
+    EXPECT_EQ(after.classes[0].inUse, before.classes[0].inUse + 1);
+    EXPECT_EQ(after.classes[0].requestedBytes, before.classes[0].requestedBytes + nodeSize);
+    DmsPoolFree(node);
+    GetDmsPoolStats(&after);
+    EXPECT_EQ(after.classes[0].inUse, before.classes[0].inUse);
+
+    void *oversized = DmsPoolAlloc(frameSize + 1);
+    ASSERT_NE(oversized, nullptr);
+    DmsPoolFree(oversized);
+    GetDmsPoolStats(&after);
+    EXPECT_EQ(after.oversized, before.oversized + 1);
+    EXPECT_EQ(after.heapFrees, before.heapFrees + 1);
+
+    /* take every free frame block, the next frame falls back to the heap */
+    const uint8_t frameClass = DMS_POOL_CLASS_NUM - 1;
+    ASSERT_EQ(after.classes[frameClass].blockSize, frameSize);
+    std::vector<void *> frames;
+    for (uint16_t i = after.classes[frameClass].inUse; i <= after.classes[frameClass].blockNum; i++) {
+        frames.push_back(DmsPoolAlloc(frameSize));
+        ASSERT_NE(frames.back(), nullptr);
+    }
+    GetDmsPoolStats(&after);
+    EXPECT_EQ(after.classes[frameClass].exhausted, before.classes[frameClass].exhausted + 1);
+    EXPECT_EQ(after.classes[frameClass].inUse, after.classes[frameClass].blockNum);
+    for (void *frame : frames) {
+        DmsPoolFree(frame);
+    }
+    GetDmsPoolStats(&after);
+    EXPECT_EQ(after.classes[frameClass].inUse, before.classes[frameClass].inUse);
+    EXPECT_EQ(after.heapFrees, before.heapFrees + 2);
+}
 }
 }
@@ -16,7 +16,9 @@
 #include "dmslite.h"
 
 #include "dmsfwk_interface.h"
+#include "dmslite_event.h"
 #include "dmslite_log.h"
+#include "dmslite_stats.h"
 
 #include "ohos_init.h"
 #include "samgr_lite.h"
@@ -63,6 +65,15 @@ static BOOL MessageHandle(Service *service, Request *request)
 
     /* process for a specific service-level msgId can be added below */
     switch (request->msgId) {
+        case DMS_SERVICE_DUMP_STATS: {
+            DumpDmsStats();
+            (void)DumpDmsEvents(NULL, NULL);
+            break;
+        }
+        case DMS_SERVICE_RESET_LATENCY: {
+            ResetDmsLatency();
+            break;
+        }
         default: {
             HILOGW("[Unkonwn msgId = %d]", request->msgId);
             break;
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_admission.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "dmslite_log.h"
+#include "dmslite_stats.h"
+
+#define ADMISSION_BUCKET_BITS 5
+#define ADMISSION_BUCKET_NUM (1 << ADMISSION_BUCKET_BITS)
+#define GOLDEN_RATIO_32 2654435769U
+#define UINT32_BITS 32
+
+/*
+ * sources are counted per hash bucket rather than per key, so the table stays fixed in size.
+ * keys sharing a bucket share its quota, which can only refuse early and never admits more than the limit
+ */
+typedef struct {
+    atomic_uint buckets[ADMISSION_BUCKET_NUM];
+    atomic_uint pending;
+    atomic_uint admitted;
+    atomic_uint rejected;
+} AdmissionTable;
+
+static AdmissionTable g_tables[ADMISSION_SOURCE_NUM];
+static const uint32_t g_sourceLimits[ADMISSION_SOURCE_NUM] = { DMS_LOCAL_START_LIMIT, DMS_REMOTE_START_LIMIT };
+
+static uint32_t GetBucketIndex(int32_t key)
+{
+    return ((uint32_t)key * GOLDEN_RATIO_32) >> (UINT32_BITS - ADMISSION_BUCKET_BITS);
+}
+
+static bool TryIncrease(atomic_uint *counter, uint32_t limit)
+{
+    uint32_t value = atomic_load_explicit(counter, memory_order_relaxed);
+    do {
+        if (value >= limit) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(counter, &value, value + 1,
+        memory_order_acq_rel, memory_order_relaxed));
+    return true;
+}
+
+static bool TryDecrease(atomic_uint *counter)
+{
+    uint32_t value = atomic_load_explicit(counter, memory_order_relaxed);
+    do {
+        if (value == 0) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(counter, &value, value - 1,
+        memory_order_acq_rel, memory_order_relaxed));
+    return true;
+}
+
+bool AcquireAdmission(DmsAdmissionSource source, int32_t key)
+{
+    if (source >= ADMISSION_SOURCE_NUM) {
+        return false;
+    }
+    AdmissionTable *table = &g_tables[source];
+    atomic_uint *bucket = &table->buckets[GetBucketIndex(key)];
+    if (!TryIncrease(bucket, DMS_SOURCE_QUOTA)) {
+        atomic_fetch_add_explicit(&table->rejected, 1, memory_order_relaxed);
+        AddDmsStat(DMS_STAT_BUSY_REJECTIONS, 1);
+        HILOGW("[AcquireAdmission source %d over quota]", source);
+        return false;
+    }
+    if (!TryIncrease(&table->pending, g_sourceLimits[source])) {
+        (void)TryDecrease(bucket);
+        atomic_fetch_add_explicit(&table->rejected, 1, memory_order_relaxed);
+        AddDmsStat(DMS_STAT_BUSY_REJECTIONS, 1);
+        HILOGW("[AcquireAdmission source %d over limit]", source);
+        return false;
+    }
+    atomic_fetch_add_explicit(&table->admitted, 1, memory_order_relaxed);
+    return true;
+}
+
+void ReleaseAdmission(DmsAdmissionSource source, int32_t key)
+{
+    if (source >= ADMISSION_SOURCE_NUM) {
+        return;
+    }
+    AdmissionTable *table = &g_tables[source];
+    atomic_uint *bucket = &table->buckets[GetBucketIndex(key)];
+    if (TryDecrease(bucket)) {
+        (void)TryDecrease(&table->pending);
+    }
+}
+
+uint32_t GetRetryAfterMs()
+{
+    uint32_t pending = 0;
+    for (uint8_t i = 0; i < ADMISSION_SOURCE_NUM; i++) {
+        pending += atomic_load_explicit(&g_tables[i].pending, memory_order_relaxed);
+    }
+    /* one base delay for every source quota worth of queued starts, so busier queues push callers further */
+    uint32_t retryAfter = DMS_RETRY_AFTER_BASE_MS * (1 + pending / DMS_SOURCE_QUOTA);
+    return (retryAfter > DMS_RETRY_AFTER_MAX_MS) ? DMS_RETRY_AFTER_MAX_MS : retryAfter;
+}
+
+void GetAdmissionStats(DmsAdmissionSource source, DmsAdmissionStats *stats)
+{
+    if (source >= ADMISSION_SOURCE_NUM || stats == NULL) {
+        return;
+    }
+    const AdmissionTable *table = &g_tables[source];
+    stats->admitted = atomic_load_explicit(&table->admitted, memory_order_relaxed);
+    stats->rejected = atomic_load_explicit(&table->rejected, memory_order_relaxed);
+    stats->pending = atomic_load_explicit(&table->pending, memory_order_relaxed);
+}
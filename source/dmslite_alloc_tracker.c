@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_alloc_tracker.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dmslite_histogram.h"
+#include "dmslite_log.h"
+#include "securec.h"
+#if defined(DMS_ALLOC_POOL)
+#include "dmslite_pool.h"
+#elif defined(WEARABLE_PRODUCT)
+#include "ohos_mem_pool.h"
+#endif
+
+/* a power of 2, several times the blocks the dms holds at once, one slot always stays empty */
+#define BLOCK_TABLE_SIZE 1024
+#define BLOCK_TABLE_MASK (BLOCK_TABLE_SIZE - 1)
+/* blocks are at least 16 bytes aligned, the low bits carry no information */
+#define BLOCK_HASH_SHIFT 4
+#define BLOCK_HASH_MULTIPLIER 2654435761U
+#define INVALID_BLOCK_INDEX (-1)
+#define US_PER_SECOND 1000000
+#define NS_PER_US 1000
+
+typedef struct {
+    const void *ptr;
+    uint32_t size;
+    uint16_t site;
+    uint64_t allocUs;
+} TrackedBlock;
+
+typedef struct {
+    const char *file;
+    uint32_t line;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t bytes;
+    uint32_t liveBytes;
+    uint32_t peakLiveBytes;
+    DmsHistogram lifetimeUs;
+} AllocSite;
+
+/* every table below is guarded by g_trackerLock */
+static pthread_mutex_t g_trackerLock = PTHREAD_MUTEX_INITIALIZER;
+static TrackedBlock g_blocks[BLOCK_TABLE_SIZE];
+static uint16_t g_blockNum = 0;
+static AllocSite g_sites[DMS_ALLOC_MAX_SITES];
+static uint16_t g_siteNum = 0;
+static DmsAllocTotals g_totals;
+
+/* the tracker sits on top of whichever backend DMS_ALLOC would use */
+static void *RawAlloc(size_t size)
+{
+#if defined(DMS_ALLOC_POOL)
+    return DmsPoolAlloc(size);
+#elif defined(WEARABLE_PRODUCT)
+    return OhosMalloc(MEM_TYPE_APPFMK_LSRAM, size);
+#else
+    return malloc(size);
+#endif
+}
+
+static void *RawSharedAlloc(size_t size)
+{
+#if defined(DMS_ALLOC_POOL)
+    return DmsHeapAlloc(size);
+#else
+    return RawAlloc(size);
+#endif
+}
+
+static void RawFree(void *ptr)
+{
+#if defined(DMS_ALLOC_POOL)
+    DmsPoolFree(ptr);
+#elif defined(WEARABLE_PRODUCT)
+    (void)OhosFree(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static uint64_t GetNowUs()
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        return 0;
+    }
+    return (uint64_t)now.tv_sec * US_PER_SECOND + (uint64_t)now.tv_nsec / NS_PER_US;
+}
+
+static uint32_t HashOf(const void *ptr)
+{
+    return (uint32_t)(((uintptr_t)ptr >> BLOCK_HASH_SHIFT) * BLOCK_HASH_MULTIPLIER) & BLOCK_TABLE_MASK;
+}
+
+static int32_t FindBlock(const void *ptr)
+{
+    for (uint32_t index = HashOf(ptr); g_blocks[index].ptr != NULL; index = (index + 1) & BLOCK_TABLE_MASK) {
+        if (g_blocks[index].ptr == ptr) {
+            return (int32_t)index;
+        }
+    }
+    return INVALID_BLOCK_INDEX;
+}
+
+static bool InsertBlock(const void *ptr, uint32_t size, uint16_t site)
+{
+    if (g_blockNum >= BLOCK_TABLE_MASK) {
+        return false;
+    }
+    uint32_t index = HashOf(ptr);
+    while (g_blocks[index].ptr != NULL) {
+        index = (index + 1) & BLOCK_TABLE_MASK;
+    }
+    g_blocks[index].ptr = ptr;
+    g_blocks[index].size = size;
+    g_blocks[index].site = site;
+    g_blocks[index].allocUs = GetNowUs();
+    g_blockNum++;
+    return true;
+}
+
+/* linear probing without tombstones: later blocks of the same run move back into the hole */
+static void RemoveBlock(uint32_t index)
+{
+    uint32_t hole = index;
+    for (uint32_t next = (hole + 1) & BLOCK_TABLE_MASK; g_blocks[next].ptr != NULL;
+        next = (next + 1) & BLOCK_TABLE_MASK) {
+        uint32_t home = HashOf(g_blocks[next].ptr);
+        if (((next - home) & BLOCK_TABLE_MASK) >= ((next - hole) & BLOCK_TABLE_MASK)) {
+            g_blocks[hole] = g_blocks[next];
+            hole = next;
+        }
+    }
+    g_blocks[hole].ptr = NULL;
+    g_blockNum--;
+}
+
+static uint16_t FindOrAddSite(const char *file, uint32_t line)
+{
+    for (uint16_t i = 0; i < g_siteNum; i++) {
+        if (g_sites[i].line == line && (g_sites[i].file == file || strcmp(g_sites[i].file, file) == 0)) {
+            return i;
+        }
+    }
+    if (g_siteNum == DMS_ALLOC_MAX_SITES) {
+        return DMS_ALLOC_MAX_SITES;
+    }
+    g_sites[g_siteNum].file = file;
+    g_sites[g_siteNum].line = line;
+    return g_siteNum++;
+}
+
+static void *TrackAlloc(void *ptr, size_t size, const char *file, uint32_t line)
+{
+    pthread_mutex_lock(&g_trackerLock);
+    if (ptr == NULL) {
+        g_totals.failedAllocs++;
+        pthread_mutex_unlock(&g_trackerLock);
+        return NULL;
+    }
+    uint16_t siteIndex = FindOrAddSite((file != NULL) ? file : "", line);
+    if (siteIndex == DMS_ALLOC_MAX_SITES || !InsertBlock(ptr, (uint32_t)size, siteIndex)) {
+        g_totals.untrackedAllocs++;
+        pthread_mutex_unlock(&g_trackerLock);
+        return ptr;
+    }
+    AllocSite *site = &g_sites[siteIndex];
+    site->allocs++;
+    site->bytes += (uint32_t)size;
+    site->liveBytes += (uint32_t)size;
+    if (site->liveBytes > site->peakLiveBytes) {
+        site->peakLiveBytes = site->liveBytes;
+    }
+    g_totals.allocs++;
+    g_totals.bytes += (uint32_t)size;
+    g_totals.liveBytes += (uint32_t)size;
+    if (g_totals.liveBytes > g_totals.peakLiveBytes) {
+        g_totals.peakLiveBytes = g_totals.liveBytes;
+    }
+    pthread_mutex_unlock(&g_trackerLock);
+    return ptr;
+}
+
+void *DmsTrackedAlloc(size_t size, const char *file, uint32_t line)
+{
+    return TrackAlloc(RawAlloc(size), size, file, line);
+}
+
+void *DmsTrackedSharedAlloc(size_t size, const char *file, uint32_t line)
+{
+    return TrackAlloc(RawSharedAlloc(size), size, file, line);
+}
+
+static bool EndBlock(const void *ptr)
+{
+    int32_t index = FindBlock(ptr);
+    if (index == INVALID_BLOCK_INDEX) {
+        return false;
+    }
+    const TrackedBlock *block = &g_blocks[index];
+    AllocSite *site = &g_sites[block->site];
+    uint64_t lifetimeUs = GetNowUs() - block->allocUs;
+    RecordHistogram(&site->lifetimeUs, (lifetimeUs > UINT32_MAX) ? UINT32_MAX : (uint32_t)lifetimeUs);
+    site->frees++;
+    site->liveBytes -= block->size;
+    g_totals.frees++;
+    g_totals.liveBytes -= block->size;
+    RemoveBlock((uint32_t)index);
+    return true;
+}
+
+void DmsTrackedFree(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    /* the record goes before the block, so the address cannot be handed out again while it is still listed */
+    pthread_mutex_lock(&g_trackerLock);
+    if (!EndBlock(ptr)) {
+        g_totals.untrackedFrees++;
+    }
+    pthread_mutex_unlock(&g_trackerLock);
+    RawFree(ptr);
+}
+
+void DmsTrackHandoff(const void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&g_trackerLock);
+    (void)EndBlock(ptr);
+    pthread_mutex_unlock(&g_trackerLock);
+}
+
+void ResetAllocTracking()
+{
+    pthread_mutex_lock(&g_trackerLock);
+    for (uint16_t i = 0; i < g_siteNum; i++) {
+        AllocSite *site = &g_sites[i];
+        site->allocs = 0;
+        site->frees = 0;
+        site->bytes = 0;
+        site->peakLiveBytes = site->liveBytes;
+        (void)memset_s(&site->lifetimeUs, sizeof(DmsHistogram), 0x00, sizeof(DmsHistogram));
+    }
+    uint32_t liveBytes = g_totals.liveBytes;
+    (void)memset_s(&g_totals, sizeof(DmsAllocTotals), 0x00, sizeof(DmsAllocTotals));
+    g_totals.liveBytes = liveBytes;
+    g_totals.peakLiveBytes = liveBytes;
+    pthread_mutex_unlock(&g_trackerLock);
+}
+
+int32_t GetAllocTotals(DmsAllocTotals *totals)
+{
+    if (totals == NULL) {
+        return DMS_EC_INVALID_PARAMETER;
+    }
+    pthread_mutex_lock(&g_trackerLock);
+    *totals = g_totals;
+    pthread_mutex_unlock(&g_trackerLock);
+    return DMS_EC_SUCCESS;
+}
+
+static void CopySite(const AllocSite *site, DmsAllocSiteStats *stats)
+{
+    stats->file = site->file;
+    stats->line = site->line;
+    stats->allocs = site->allocs;
+    stats->frees = site->frees;
+    stats->bytes = site->bytes;
+    stats->liveBytes = site->liveBytes;
+    stats->peakLiveBytes = site->peakLiveBytes;
+    GetHistogramStats(&site->lifetimeUs, &stats->lifetimeUs);
+}
+
+uint16_t GetAllocSites(DmsAllocSiteStats *sites, uint16_t maxNum)
+{
+    if (sites == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&g_trackerLock);
+    uint16_t num = (g_siteNum < maxNum) ? g_siteNum : maxNum;
+    for (uint16_t i = 0; i < num; i++) {
+        CopySite(&g_sites[i], &sites[i]);
+    }
+    pthread_mutex_unlock(&g_trackerLock);
+    return num;
+}
+
+void DumpAllocTracking(const char *scenario)
+{
+    const char *name = (scenario != NULL) ? scenario : "";
+    pthread_mutex_lock(&g_trackerLock);
+    HILOGI("[%{public}s: %u allocs (%u bytes), %u frees, %u bytes live, peak %u bytes]", name,
+        g_totals.allocs, g_totals.bytes, g_totals.frees, g_totals.liveBytes, g_totals.peakLiveBytes);
+    HILOGI("[%{public}s: %u failed, %u untracked allocs, %u untracked frees]", name, g_totals.failedAllocs,
+        g_totals.untrackedAllocs, g_totals.untrackedFrees);
+    for (uint16_t i = 0; i < g_siteNum; i++) {
+        const AllocSite *site = &g_sites[i];
+        if (site->allocs == 0 && site->liveBytes == 0) {
+            continue;
+        }
+        DmsLatencyStats lifetime;
+        GetHistogramStats(&site->lifetimeUs, &lifetime);
+        HILOGI("[%{public}s:%u %u allocs (%u bytes), %u frees, %u live, peak %u, lifetime p50 %u p99 %u max %u us]",
+            site->file, site->line, site->allocs, site->bytes, site->frees, site->liveBytes,
+            site->peakLiveBytes, lifetime.p50, lifetime.p99, lifetime.max);
+    }
+    pthread_mutex_unlock(&g_trackerLock);
+}
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_bms.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#ifdef WEARABLE_PRODUCT
+#include "bundle_manager.h"
+#else
+#include "bundle_inner_interface.h"
+#include "bundle_manager.h"
+#endif
+#include "appexecfwk_errors.h"
+#include "dmsfwk_interface.h"
+#include "dmslite_inner_common.h"
+#include "dmslite_log.h"
+#include "dmslite_utils.h"
+#include "ohos_errno.h"
+#include "samgr_lite.h"
+#include "securec.h"
+
+#define MAX_BUNDLE_NAME_LEN 128
+#define PREFETCH_STACK_SIZE 0x4000
+
+typedef enum {
+    PREFETCH_IDLE = 0,
+    PREFETCH_PENDING,
+    PREFETCH_RUNNING,
+    PREFETCH_DONE,
+} PrefetchState;
+
+/* a single prefetch slot, an incoming session asks for one callee bundle at a time */
+typedef struct {
+    char bundleName[MAX_BUNDLE_NAME_LEN];
+    BundleInfo bundleInfo;
+    int32_t errCode;
+    PrefetchState state;
+    bool running;
+    pthread_t worker;
+} BmsPrefetch;
+
+static BmsPrefetch g_prefetch = { 0 };
+static pthread_mutex_t g_prefetchLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_prefetchCond = PTHREAD_COND_INITIALIZER;
+
+/* only a missing bundle is a final answer, any other bms failure may pass on the next query */
+static int32_t ToBundleInfoResult(uint8_t result)
+{
+    if (result == EC_SUCCESS) {
+        return DMS_EC_SUCCESS;
+    }
+    return (result == ERR_APPEXECFWK_QUERY_NO_INFOS) ? DMS_EC_GET_BUNDLEINFO_FAILURE : DMS_EC_GET_BMS_FAILURE;
+}
+
+#ifndef WEARABLE_PRODUCT
+/* the bms feature lives in the same process as dms in inner-process mode, so its proxy can be kept */
+static IUnknown *g_bmsUnknown = NULL;
+static struct BmsServerProxy *g_bmsProxy = NULL;
+static pthread_mutex_t g_proxyLock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct BmsServerProxy *ResolveBmsProxy(bool force)
+{
+    pthread_mutex_lock(&g_proxyLock);
+    if (g_bmsProxy != NULL && !force) {
+        struct BmsServerProxy *proxy = g_bmsProxy;
+        pthread_mutex_unlock(&g_proxyLock);
+        return proxy;
+    }
+    IUnknown *iUnknown = SAMGR_GetInstance()->GetFeatureApi(BMS_SERVICE, BMS_FEATURE);
+    if (iUnknown == NULL) {
+        HILOGE("[GetFeatureApi failed]");
+        g_bmsProxy = NULL;
+        g_bmsUnknown = NULL;
+        pthread_mutex_unlock(&g_proxyLock);
+        return NULL;
+    }
+    /* after a failed call the proxy is queried again only if bms registered a new api */
+    if (iUnknown != g_bmsUnknown || g_bmsProxy == NULL) {
+        struct BmsServerProxy *proxy = NULL;
+        if (iUnknown->QueryInterface(iUnknown, DEFAULT_VERSION, (void **)&proxy) != EC_SUCCESS) {
+            HILOGE("[QueryInterface failed]");
+            proxy = NULL;
+        }
+        g_bmsUnknown = (proxy != NULL) ? iUnknown : NULL;
+        g_bmsProxy = proxy;
+    }
+    struct BmsServerProxy *proxy = g_bmsProxy;
+    pthread_mutex_unlock(&g_proxyLock);
+    return proxy;
+}
+
+static int32_t GetBundleInfoFromProxy(const char *bundleName, int32_t flags, BundleInfo *bundleInfo)
+{
+    struct BmsServerProxy *proxy = ResolveBmsProxy(false);
+    if (proxy == NULL) {
+        return DMS_EC_GET_BMS_FAILURE;
+    }
+    uint8_t result = proxy->GetBundleInfo(bundleName, flags, bundleInfo);
+    if (result == EC_SUCCESS || result == ERR_APPEXECFWK_QUERY_NO_INFOS) {
+        return ToBundleInfoResult(result);
+    }
+    struct BmsServerProxy *newProxy = ResolveBmsProxy(true);
+    if (newProxy == NULL) {
+        return DMS_EC_GET_BMS_FAILURE;
+    }
+    if (newProxy == proxy) {
+        return ToBundleInfoResult(result);
+    }
+    return ToBundleInfoResult(newProxy->GetBundleInfo(bundleName, flags, bundleInfo));
+}
+
+static int32_t GetBundleNameFromProxy(int32_t uid, char **bundleName)
+{
+    struct BmsServerProxy *proxy = ResolveBmsProxy(false);
+    if (proxy == NULL) {
+        return DMS_EC_GET_BMS_FAILURE;
+    }
+    if (proxy->GetBundleNameForUid(uid, bundleName) == EC_SUCCESS) {
+        return DMS_EC_SUCCESS;
+    }
+    struct BmsServerProxy *newProxy = ResolveBmsProxy(true);
+    if (newProxy == NULL) {
+        return DMS_EC_GET_BMS_FAILURE;
+    }
+    if (newProxy == proxy || newProxy->GetBundleNameForUid(uid, bundleName) != EC_SUCCESS) {
+        return DMS_EC_FAILURE;
+    }
+    return DMS_EC_SUCCESS;
+}
+#endif
+
+int32_t DmsGetBundleInfo(const char *bundleName, int32_t flags, BundleInfo *bundleInfo)
+{
+    if (bundleName == NULL || bundleInfo == NULL) {
+        return DMS_EC_INVALID_PARAMETER;
+    }
+#ifndef WEARABLE_PRODUCT
+    uid_t callerUid = getuid();
+    if (callerUid == FOUNDATION_UID) {
+        /* inner-process mode */
+        return GetBundleInfoFromProxy(bundleName, flags, bundleInfo);
+    }
+    if (callerUid != SHELL_UID) {
+        return DMS_EC_GET_BUNDLEINFO_FAILURE;
+    }
+#endif
+    /* inter-process mode (mainly called in xts testsuit process started by shell) */
+    return ToBundleInfoResult(GetBundleInfo(bundleName, flags, bundleInfo));
+}
+
+int32_t DmsGetBundleNameForUid(int32_t uid, char **bundleName)
+{
+    if (bundleName == NULL) {
+        return DMS_EC_INVALID_PARAMETER;
+    }
+#ifndef WEARABLE_PRODUCT
+    uid_t callerUid = getuid();
+    if (callerUid == FOUNDATION_UID) {
+        return GetBundleNameFromProxy(uid, bundleName);
+    }
+    if (callerUid != SHELL_UID) {
+        return DMS_EC_FAILURE;
+    }
+    return (GetBundleNameForUid(uid, bundleName) == EC_SUCCESS) ? DMS_EC_SUCCESS : DMS_EC_FAILURE;
+#else
+    return DMS_EC_FAILURE;
+#endif
+}
+
+static void *PrefetchWorker(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&g_prefetchLock);
+    while (g_prefetch.running) {
+        if (g_prefetch.state != PREFETCH_PENDING) {
+            pthread_cond_wait(&g_prefetchCond, &g_prefetchLock);
+            continue;
+        }
+        g_prefetch.state = PREFETCH_RUNNING;
+        char bundleName[MAX_BUNDLE_NAME_LEN];
+        (void)strcpy_s(bundleName, MAX_BUNDLE_NAME_LEN, g_prefetch.bundleName);
+        pthread_mutex_unlock(&g_prefetchLock);
+
+        /* the ipc runs unlocked, the dms task never waits for it */
+        BundleInfo bundleInfo = { 0 };
+        int32_t errCode = DmsGetBundleInfo(bundleName, GET_BUNDLE_WITHOUT_ABILITIES, &bundleInfo);
+
+        pthread_mutex_lock(&g_prefetchLock);
+        g_prefetch.bundleInfo = bundleInfo;
+        g_prefetch.errCode = errCode;
+        g_prefetch.state = PREFETCH_DONE;
+        pthread_cond_broadcast(&g_prefetchCond);
+    }
+    pthread_mutex_unlock(&g_prefetchLock);
+    return NULL;
+}
+
+int32_t StartBmsPrefetch()
+{
+    pthread_mutex_lock(&g_prefetchLock);
+    if (g_prefetch.running) {
+        pthread_mutex_unlock(&g_prefetchLock);
+        return EC_SUCCESS;
+    }
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PREFETCH_STACK_SIZE);
+    g_prefetch.running = true;
+    if (pthread_create(&g_prefetch.worker, &attr, PrefetchWorker, NULL) != 0) {
+        HILOGE("[create prefetch worker failed]");
+        g_prefetch.running = false;
+    }
+    pthread_attr_destroy(&attr);
+    int32_t ret = g_prefetch.running ? EC_SUCCESS : EC_FAILURE;
+    pthread_mutex_unlock(&g_prefetchLock);
+    return ret;
+}
+
+void StopBmsPrefetch()
+{
+    pthread_mutex_lock(&g_prefetchLock);
+    if (!g_prefetch.running) {
+        pthread_mutex_unlock(&g_prefetchLock);
+        return;
+    }
+    g_prefetch.running = false;
+    pthread_cond_broadcast(&g_prefetchCond);
+    pthread_t worker = g_prefetch.worker;
+    pthread_mutex_unlock(&g_prefetchLock);
+    pthread_join(worker, NULL);
+
+    pthread_mutex_lock(&g_prefetchLock);
+    if (g_prefetch.state == PREFETCH_DONE) {
+        ClearBundleInfo(&g_prefetch.bundleInfo);
+    }
+    g_prefetch.state = PREFETCH_IDLE;
+    pthread_mutex_unlock(&g_prefetchLock);
+}
+
+int32_t PrefetchBundleInfo(const char *bundleName)
+{
+    if (bundleName == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_prefetchLock);
+    if (!g_prefetch.running || g_prefetch.state == PREFETCH_RUNNING) {
+        pthread_mutex_unlock(&g_prefetchLock);
+        return EC_FAILURE;
+    }
+    if (g_prefetch.state == PREFETCH_DONE) {
+        ClearBundleInfo(&g_prefetch.bundleInfo);
+    }
+    if (strcpy_s(g_prefetch.bundleName, MAX_BUNDLE_NAME_LEN, bundleName) != EOK) {
+        g_prefetch.state = PREFETCH_IDLE;
+        pthread_mutex_unlock(&g_prefetchLock);
+        return EC_FAILURE;
+    }
+    g_prefetch.state = PREFETCH_PENDING;
+    pthread_cond_broadcast(&g_prefetchCond);
+    pthread_mutex_unlock(&g_prefetchLock);
+    return EC_SUCCESS;
+}
+
+int32_t TakePrefetchedBundleInfo(const char *bundleName, BundleInfo *bundleInfo)
+{
+    if (bundleName == NULL || bundleInfo == NULL) {
+        return DMS_EC_INVALID_PARAMETER;
+    }
+    pthread_mutex_lock(&g_prefetchLock);
+    if (g_prefetch.state == PREFETCH_IDLE || strcmp(g_prefetch.bundleName, bundleName) != 0) {
+        pthread_mutex_unlock(&g_prefetchLock);
+        return DMS_EC_FAILURE;
+    }
+    if (g_prefetch.state != PREFETCH_DONE) {
+        /* the caller queries the bms itself, a fetch not started yet is dropped and a running one left to finish */
+        if (g_prefetch.state == PREFETCH_PENDING) {
+            g_prefetch.state = PREFETCH_IDLE;
+        }
+        pthread_mutex_unlock(&g_prefetchLock);
+        return DMS_EC_FAILURE;
+    }
+    /* hand over the bundle info, the caller releases it */
+    *bundleInfo = g_prefetch.bundleInfo;
+    int32_t errCode = g_prefetch.errCode;
+    (void)memset_s(&g_prefetch.bundleInfo, sizeof(BundleInfo), 0x00, sizeof(BundleInfo));
+    g_prefetch.state = PREFETCH_IDLE;
+    pthread_mutex_unlock(&g_prefetchLock);
+    return errCode;
+}
+
+bool IsBundleInfoPrefetched(const char *bundleName)
+{
+    if (bundleName == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&g_prefetchLock);
+    bool prefetched = (g_prefetch.state == PREFETCH_DONE && strcmp(g_prefetch.bundleName, bundleName) == 0);
+    pthread_mutex_unlock(&g_prefetchLock);
+    return prefetched;
+}
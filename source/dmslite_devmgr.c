@@ -15,20 +15,51 @@
 
 #include "dmslite_devmgr.h"
 
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "dmslite_log.h"
 #include "dmslite_session.h"
+#include "dmslite_utils.h"
+#include "ohos_errno.h"
 #include "securec.h"
 #include "softbus_bus_center.h"
 
 #define DMSLITE_BUNDLE_NAME "dmslite"
+#define PEER_BUCKET_NUM 32
+#define PEER_BUCKET_MASK (PEER_BUCKET_NUM - 1)
+#define INVALID_PEER_INDEX (-1)
+#define INVALID_SESSION_ID (-1)
+#define RTT_EWMA_SHIFT 3
+#define PERCENT_50 50
+#define PERCENT_90 90
+#define PERCENT_99 99
+#define PERCENT_BASE 100
+
+typedef struct {
+    DmsPeerInfo info;
+    int8_t next;
+    bool used;
+} PeerEntry;
 
-static char g_peerDevId[NETWORK_ID_BUF_LEN] = {0};
+/* online peers chained per bucket by their networkId hash, entries come from a fixed pool */
+typedef struct {
+    PeerEntry entries[MAX_PEER_NUM];
+    int8_t buckets[PEER_BUCKET_NUM];
+    uint8_t peerNum;
+} PeerRegistry;
+
+/* bus center callbacks arrive on the softbus thread, queries come from the dms task */
+static pthread_mutex_t g_registryLock = PTHREAD_MUTEX_INITIALIZER;
+static PeerRegistry g_registry;
+static bool g_registryInited = false;
 
 static void onNodeOnline(NodeBasicInfo *info);
 static void onNodeOffline(NodeBasicInfo *info);
 static void onNodeBasicInfoChanged(NodeBasicInfoType type, NodeBasicInfo *info);
 
 static INodeStateCb g_networkListener = {
-    .events = EVENT_NODE_STATE_ONLINE | EVENT_NODE_STATE_OFFLINE,
+    .events = EVENT_NODE_STATE_ONLINE | EVENT_NODE_STATE_OFFLINE | EVENT_NODE_STATE_INFO_CHANGED,
     .onNodeOnline = onNodeOnline,
     .onNodeOffline = onNodeOffline,
     .onNodeBasicInfoChanged = onNodeBasicInfoChanged
@@ -39,7 +70,9 @@ void onNodeOnline(NodeBasicInfo *info)
     if (info == NULL) {
         return;
     }
-    (void)strncpy_s(g_peerDevId, NETWORK_ID_BUF_LEN, info->networkId, sizeof(info->networkId));
+    if (AddPeer(info) != EC_SUCCESS) {
+        HILOGW("[onNodeOnline peer registry full]");
+    }
     CreateDMSSessionServer();
 }
 
@@ -48,26 +81,615 @@ void onNodeOffline(NodeBasicInfo *info)
     if (info == NULL) {
         return;
     }
-    (void)memset_s(g_peerDevId, NETWORK_ID_BUF_LEN, 0x00, NETWORK_ID_BUF_LEN);
-    CloseDMSSessionServer();
+    (void)RemovePeer(info->networkId);
+    /* the session server is still needed while any other peer stays online */
+    if (GetOnlinePeerNum() == 0) {
+        CloseDMSSessionServer();
+    }
 }
 
 void onNodeBasicInfoChanged(NodeBasicInfoType type, NodeBasicInfo *info)
 {
-    return;
+    if (info == NULL) {
+        return;
+    }
+    (void)UpdatePeer(type, info);
 }
 
-int32_t AddDevMgrListener()
+static void InitRegistry()
 {
-    return RegNodeDeviceStateCb(DMSLITE_BUNDLE_NAME, &g_networkListener);
+    (void)memset_s(&g_registry, sizeof(PeerRegistry), 0x00, sizeof(PeerRegistry));
+    for (uint8_t i = 0; i < PEER_BUCKET_NUM; i++) {
+        g_registry.buckets[i] = INVALID_PEER_INDEX;
+    }
+    g_registryInited = true;
 }
 
-int32_t UnRegisterDevMgrListener()
+static uint32_t HashNetworkId(const char *networkId)
 {
-    return UnregNodeDeviceStateCb(&g_networkListener);
+    return HashString(networkId, NETWORK_ID_BUF_LEN) & PEER_BUCKET_MASK;
+}
+
+/* callers hold g_registryLock */
+static PeerEntry *FindPeer(const char *networkId)
+{
+    if (!g_registryInited) {
+        return NULL;
+    }
+    int8_t index = g_registry.buckets[HashNetworkId(networkId)];
+    while (index != INVALID_PEER_INDEX) {
+        PeerEntry *entry = &g_registry.entries[index];
+        if (strncmp(entry->info.basicInfo.networkId, networkId, NETWORK_ID_BUF_LEN) == 0) {
+            return entry;
+        }
+        index = entry->next;
+    }
+    return NULL;
+}
+
+/* callers hold g_registryLock */
+static PeerEntry *FindPeerByUdid(const char *udid)
+{
+    if (!g_registryInited || udid[0] == '\0') {
+        return NULL;
+    }
+    for (uint8_t i = 0; i < MAX_PEER_NUM; i++) {
+        PeerEntry *entry = &g_registry.entries[i];
+        if (entry->used && strncmp(entry->info.udid, udid, UDID_BUF_LEN) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void LinkPeer(PeerEntry *entry, const char *networkId)
+{
+    uint32_t bucket = HashNetworkId(networkId);
+    entry->next = g_registry.buckets[bucket];
+    g_registry.buckets[bucket] = (int8_t)(entry - g_registry.entries);
+}
+
+/* the entry must still carry the networkId it was linked with */
+static void UnlinkPeer(const PeerEntry *entry)
+{
+    int8_t *link = &g_registry.buckets[HashNetworkId(entry->info.basicInfo.networkId)];
+    while (*link != INVALID_PEER_INDEX) {
+        if (&g_registry.entries[*link] == entry) {
+            *link = entry->next;
+            return;
+        }
+        link = &g_registry.entries[*link].next;
+    }
+}
+
+static PeerEntry *InsertPeer(const char *networkId)
+{
+    if (!g_registryInited) {
+        InitRegistry();
+    }
+    for (int8_t i = 0; i < MAX_PEER_NUM; i++) {
+        PeerEntry *entry = &g_registry.entries[i];
+        if (entry->used) {
+            continue;
+        }
+        (void)memset_s(entry, sizeof(PeerEntry), 0x00, sizeof(PeerEntry));
+        entry->used = true;
+        entry->info.onlineTime = time(NULL);
+        entry->info.link.sessionId = INVALID_SESSION_ID;
+        LinkPeer(entry, networkId);
+        g_registry.peerNum++;
+        return entry;
+    }
+    return NULL;
+}
+
+int32_t AddPeer(const NodeBasicInfo *info)
+{
+    if (info == NULL) {
+        return EC_INVALID;
+    }
+    char udid[UDID_BUF_LEN] = { 0 };
+    if (GetNodeKeyInfo(DMSLITE_BUNDLE_NAME, info->networkId, NODE_KEY_UDID, (uint8_t *)udid, UDID_BUF_LEN) != 0) {
+        /* the peer is then only known by its networkId */
+        udid[0] = '\0';
+    }
+    udid[UDID_BUF_LEN - 1] = '\0';
+    return AddPeerWithUdid(info, udid);
+}
+
+int32_t AddPeerWithUdid(const NodeBasicInfo *info, const char *udid)
+{
+    if (info == NULL || udid == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(info->networkId);
+    if (entry == NULL) {
+        entry = FindPeerByUdid(udid);
+        if (entry != NULL) {
+            /* the device is back under a new networkId, the entry is moved rather than left behind */
+            UnlinkPeer(entry);
+            LinkPeer(entry, info->networkId);
+        }
+    }
+    if (entry == NULL) {
+        entry = InsertPeer(info->networkId);
+    }
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    if (udid[0] != '\0') {
+        (void)strncpy_s(entry->info.udid, UDID_BUF_LEN, udid, UDID_BUF_LEN - 1);
+    }
+    entry->info.basicInfo = *info;
+    entry->info.basicInfo.networkId[NETWORK_ID_BUF_LEN - 1] = '\0';
+    entry->info.updateTime = time(NULL);
+    pthread_mutex_unlock(&g_registryLock);
+    return EC_SUCCESS;
+}
+
+int32_t RemovePeer(const char *networkId)
+{
+    if (networkId == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    UnlinkPeer(entry);
+    entry->used = false;
+    g_registry.peerNum--;
+    pthread_mutex_unlock(&g_registryLock);
+    return EC_SUCCESS;
+}
+
+int32_t UpdatePeer(NodeBasicInfoType type, const NodeBasicInfo *info)
+{
+    if (info == NULL) {
+        return EC_INVALID;
+    }
+    if (type != TYPE_DEVICE_NAME) {
+        /* the old networkId is not reported, the entry of the device is found again by its udid */
+        return AddPeer(info);
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(info->networkId);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    (void)strncpy_s(entry->info.basicInfo.deviceName, DEVICE_NAME_BUF_LEN,
+        info->deviceName, DEVICE_NAME_BUF_LEN - 1);
+    entry->info.updateTime = time(NULL);
+    pthread_mutex_unlock(&g_registryLock);
+    return EC_SUCCESS;
+}
+
+int32_t UpdatePeerLink(const char *networkId, int32_t sessionId)
+{
+    if (networkId == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    entry->info.link.sessionId = sessionId;
+    entry->info.link.linkTime = time(NULL);
+    pthread_mutex_unlock(&g_registryLock);
+    return EC_SUCCESS;
+}
+
+int32_t SetPeerLastBundle(const char *networkId, const char *bundleName)
+{
+    if (networkId == NULL || bundleName == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    int32_t ret = EC_SUCCESS;
+    if (strcpy_s(entry->info.link.lastBundle, MAX_PEER_BUNDLE_LEN, bundleName) != EOK) {
+        entry->info.link.lastBundle[0] = '\0';
+        ret = EC_FAILURE;
+    }
+    pthread_mutex_unlock(&g_registryLock);
+    return ret;
+}
+
+int32_t GetPeerLastBundle(const char *networkId, char *bundleName, uint16_t len)
+{
+    if (networkId == NULL || bundleName == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    int32_t ret = EC_FAILURE;
+    if (entry != NULL && entry->info.link.lastBundle[0] != '\0'
+        && strcpy_s(bundleName, len, entry->info.link.lastBundle) == EOK) {
+        ret = EC_SUCCESS;
+    }
+    pthread_mutex_unlock(&g_registryLock);
+    return ret;
+}
+
+int32_t CountPeerRejection(const char *networkId)
+{
+    if (networkId == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    entry->info.rejectNum++;
+    pthread_mutex_unlock(&g_registryLock);
+    return EC_SUCCESS;
+}
+
+int32_t GetPeerRejections(const char *networkId, uint32_t *rejectNum)
+{
+    if (networkId == NULL || rejectNum == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry != NULL) {
+        *rejectNum = entry->info.rejectNum;
+    }
+    pthread_mutex_unlock(&g_registryLock);
+    return (entry != NULL) ? EC_SUCCESS : EC_FAILURE;
+}
+
+static bool DumpPeerRejection(const DmsPeerInfo *peerInfo, void *context)
+{
+    if (peerInfo->rejectNum != 0) {
+        HILOGI("[peer %s: %u remote starts refused]", peerInfo->basicInfo.networkId, peerInfo->rejectNum);
+    }
+    return true;
+}
+
+void DumpPeerRejections()
+{
+    ForEachPeer(DumpPeerRejection, NULL);
+}
+
+int32_t SetPeerBackoff(const char *networkId, uint32_t retryAfterMs)
+{
+    if (networkId == NULL) {
+        return EC_INVALID;
+    }
+    uint64_t backoffUntil = GetMonotonicMs() + retryAfterMs;
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    entry->info.backoffUntil = backoffUntil;
+    pthread_mutex_unlock(&g_registryLock);
+    return EC_SUCCESS;
+}
+
+bool IsPeerBackingOff(const char *networkId)
+{
+    if (networkId == NULL) {
+        return false;
+    }
+    uint64_t now = GetMonotonicMs();
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    bool backingOff = (entry != NULL && entry->info.backoffUntil > now);
+    pthread_mutex_unlock(&g_registryLock);
+    return backingOff;
+}
+
+bool ClaimPeerCapabilityRequest(const char *networkId, int32_t sessionId)
+{
+    if (networkId == NULL) {
+        return false;
+    }
+    uint64_t now = GetMonotonicMs();
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    DmsPeerCapability *capability = (entry != NULL) ? &entry->info.capability : NULL;
+    bool claimed = (capability != NULL) && (capability->state == CAPABILITY_UNKNOWN
+        || (capability->state == CAPABILITY_REQUESTED && capability->requestDeadline <= now));
+    if (claimed) {
+        capability->state = CAPABILITY_REQUESTED;
+        capability->requestSessionId = sessionId;
+        capability->requestDeadline = now + DMS_CAPABILITY_TIMEOUT_MS;
+    }
+    pthread_mutex_unlock(&g_registryLock);
+    return claimed;
+}
+
+void ReleasePeerCapabilityRequest(int32_t sessionId)
+{
+    pthread_mutex_lock(&g_registryLock);
+    for (uint8_t i = 0; i < MAX_PEER_NUM; i++) {
+        DmsPeerCapability *capability = &g_registry.entries[i].info.capability;
+        if (g_registry.entries[i].used && capability->state == CAPABILITY_REQUESTED
+            && capability->requestSessionId == sessionId) {
+            capability->state = CAPABILITY_UNKNOWN;
+        }
+    }
+    pthread_mutex_unlock(&g_registryLock);
+}
+
+int32_t UpdatePeerCapability(const char *networkId, const DmsPeerCapability *capability)
+{
+    if (networkId == NULL || capability == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    entry->info.capability = *capability;
+    entry->info.capability.state = CAPABILITY_KNOWN;
+    pthread_mutex_unlock(&g_registryLock);
+    return EC_SUCCESS;
+}
+
+int32_t GetPeerCapability(const char *networkId, DmsPeerCapability *capability)
+{
+    if (networkId == NULL || capability == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    bool known = (entry != NULL && entry->info.capability.state == CAPABILITY_KNOWN);
+    if (known) {
+        *capability = entry->info.capability;
+    }
+    pthread_mutex_unlock(&g_registryLock);
+    return known ? EC_SUCCESS : EC_FAILURE;
+}
+
+int32_t RecordPeerRtt(const char *networkId, uint32_t rttMs)
+{
+    if (networkId == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    DmsPeerRtt *rtt = &entry->info.rtt;
+    if (rtt->sampleNum == 0) {
+        rtt->scaledEwma = rttMs << RTT_EWMA_SHIFT;
+    } else {
+        /* ewma = 7/8 * ewma + 1/8 * sample */
+        rtt->scaledEwma = rtt->scaledEwma - (rtt->scaledEwma >> RTT_EWMA_SHIFT) + rttMs;
+    }
+    rtt->samples[rtt->next] = rttMs;
+    rtt->next = (rtt->next + 1) % RTT_SAMPLE_NUM;
+    if (rtt->sampleNum < RTT_SAMPLE_NUM) {
+        rtt->sampleNum++;
+    }
+    pthread_mutex_unlock(&g_registryLock);
+    return EC_SUCCESS;
+}
+
+static int CompareRtt(const void *left, const void *right)
+{
+    uint32_t l = *(const uint32_t *)left;
+    uint32_t r = *(const uint32_t *)right;
+    return (l > r) - (l < r);
 }
 
-char* GetPeerId()
+static uint32_t GetPercentile(const uint32_t *sorted, uint8_t num, uint8_t percent)
 {
-    return g_peerDevId;
+    /* nearest rank */
+    uint32_t rank = (percent * num + PERCENT_BASE - 1) / PERCENT_BASE;
+    return sorted[(rank == 0) ? 0 : rank - 1];
+}
+
+int32_t GetPeerRttStats(const char *networkId, DmsRttStats *stats)
+{
+    if (networkId == NULL || stats == NULL) {
+        return EC_INVALID;
+    }
+    uint32_t sorted[RTT_SAMPLE_NUM];
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry == NULL || entry->info.rtt.sampleNum == 0) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    uint8_t sampleNum = entry->info.rtt.sampleNum;
+    stats->ewma = entry->info.rtt.scaledEwma >> RTT_EWMA_SHIFT;
+    (void)memcpy_s(sorted, sizeof(sorted), entry->info.rtt.samples, sizeof(uint32_t) * sampleNum);
+    pthread_mutex_unlock(&g_registryLock);
+
+    qsort(sorted, sampleNum, sizeof(uint32_t), CompareRtt);
+    stats->p50 = GetPercentile(sorted, sampleNum, PERCENT_50);
+    stats->p90 = GetPercentile(sorted, sampleNum, PERCENT_90);
+    stats->p99 = GetPercentile(sorted, sampleNum, PERCENT_99);
+    stats->sampleNum = sampleNum;
+    return EC_SUCCESS;
+}
+
+int32_t RecordPeerLatency(const char *networkId, DmsLatencySide side, uint32_t latencyMs)
+{
+    if (networkId == NULL || side >= DMS_LATENCY_SIDE_NUM) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&g_registryLock);
+        return EC_FAILURE;
+    }
+    RecordHistogram(&entry->info.latency[side], latencyMs);
+    pthread_mutex_unlock(&g_registryLock);
+    return EC_SUCCESS;
+}
+
+int32_t GetPeerLatency(const char *networkId, DmsLatencySide side, DmsLatencyStats *stats)
+{
+    if (networkId == NULL || side >= DMS_LATENCY_SIDE_NUM || stats == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry != NULL) {
+        GetHistogramStats(&entry->info.latency[side], stats);
+    }
+    pthread_mutex_unlock(&g_registryLock);
+    return (entry != NULL) ? EC_SUCCESS : EC_FAILURE;
+}
+
+void ResetPeerLatency()
+{
+    pthread_mutex_lock(&g_registryLock);
+    for (uint8_t i = 0; i < MAX_PEER_NUM; i++) {
+        (void)memset_s(g_registry.entries[i].info.latency, sizeof(g_registry.entries[i].info.latency), 0x00,
+            sizeof(g_registry.entries[i].info.latency));
+    }
+    pthread_mutex_unlock(&g_registryLock);
+}
+
+static bool CanRunAbility(const DmsPeerInfo *peerInfo, const Want *want)
+{
+    /* remote bundles are not visible here, only peers unable to take the start frame are ruled out */
+    if (want == NULL || want->element == NULL || peerInfo->capability.state != CAPABILITY_KNOWN) {
+        return true;
+    }
+    const ElementName *element = want->element;
+    uint32_t frameSize = want->dataLength;
+    frameSize += (element->bundleName != NULL) ? strlen(element->bundleName) : 0;
+    frameSize += (element->abilityName != NULL) ? strlen(element->abilityName) : 0;
+    return frameSize < peerInfo->capability.maxFrameSize;
+}
+
+int32_t GetLowestLatencyPeer(const Want *want, char *networkId, uint16_t len)
+{
+    if (networkId == NULL || len < NETWORK_ID_BUF_LEN) {
+        return EC_INVALID;
+    }
+    const DmsPeerInfo *selected = NULL;
+    uint64_t now = GetMonotonicMs();
+    pthread_mutex_lock(&g_registryLock);
+    for (uint8_t i = 0; i < MAX_PEER_NUM; i++) {
+        const DmsPeerInfo *peerInfo = &g_registry.entries[i].info;
+        if (!g_registry.entries[i].used || !CanRunAbility(peerInfo, want) || peerInfo->backoffUntil > now) {
+            continue;
+        }
+        if (selected == NULL) {
+            selected = peerInfo;
+            continue;
+        }
+        bool sampled = (peerInfo->rtt.sampleNum != 0);
+        bool selectedSampled = (selected->rtt.sampleNum != 0);
+        if ((sampled && !selectedSampled)
+            || (sampled && peerInfo->rtt.scaledEwma < selected->rtt.scaledEwma)) {
+            selected = peerInfo;
+        }
+    }
+    int32_t ret = EC_FAILURE;
+    if (selected != NULL && strcpy_s(networkId, len, selected->basicInfo.networkId) == EOK) {
+        ret = EC_SUCCESS;
+    }
+    pthread_mutex_unlock(&g_registryLock);
+    return ret;
+}
+
+bool IsPeerOnline(const char *networkId)
+{
+    if (networkId == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    bool online = (FindPeer(networkId) != NULL);
+    pthread_mutex_unlock(&g_registryLock);
+    return online;
+}
+
+int32_t GetPeerInfo(const char *networkId, DmsPeerInfo *peerInfo)
+{
+    if (networkId == NULL || peerInfo == NULL) {
+        return EC_INVALID;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    PeerEntry *entry = FindPeer(networkId);
+    if (entry != NULL) {
+        *peerInfo = entry->info;
+    }
+    pthread_mutex_unlock(&g_registryLock);
+    return (entry != NULL) ? EC_SUCCESS : EC_FAILURE;
+}
+
+uint8_t GetOnlinePeerNum()
+{
+    pthread_mutex_lock(&g_registryLock);
+    uint8_t peerNum = g_registry.peerNum;
+    pthread_mutex_unlock(&g_registryLock);
+    return peerNum;
+}
+
+void ForEachPeer(PeerVisitor visitor, void *context)
+{
+    if (visitor == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&g_registryLock);
+    for (uint8_t i = 0; i < MAX_PEER_NUM; i++) {
+        if (g_registry.entries[i].used && !visitor(&g_registry.entries[i].info, context)) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_registryLock);
+}
+
+void ClearPeers()
+{
+    pthread_mutex_lock(&g_registryLock);
+    InitRegistry();
+    pthread_mutex_unlock(&g_registryLock);
+}
+
+static void LoadOnlinePeers()
+{
+    NodeBasicInfo *infos = NULL;
+    int32_t infoNum = 0;
+    if (GetAllNodeDeviceInfo(DMSLITE_BUNDLE_NAME, &infos, &infoNum) != 0 || infos == NULL) {
+        return;
+    }
+    /* peers that came online before the listener was registered */
+    for (int32_t i = 0; i < infoNum; i++) {
+        (void)AddPeer(&infos[i]);
+    }
+    FreeNodeInfo(infos);
+}
+
+int32_t AddDevMgrListener()
+{
+    int32_t ret = RegNodeDeviceStateCb(DMSLITE_BUNDLE_NAME, &g_networkListener);
+    if (ret == EC_SUCCESS) {
+        LoadOnlinePeers();
+    }
+    return ret;
+}
+
+int32_t UnRegisterDevMgrListener()
+{
+    ClearPeers();
+    return UnregNodeDeviceStateCb(&g_networkListener);
 }
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_event.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "dmslite_log.h"
+#include "securec.h"
+
+#define EVENT_RING_MASK (DMS_EVENT_RING_SIZE - 1)
+#define US_PER_SECOND 1000000
+#define NS_PER_US 1000
+
+_Static_assert((DMS_EVENT_RING_SIZE & EVENT_RING_MASK) == 0, "event ring size must be a power of 2");
+
+/*
+ * every slot is a small seqlock: sequence is 0 while a writer fills the slot and position + 1 once it is
+ * complete, so a dump skips slots that are being overwritten instead of showing mixed fields
+ */
+typedef struct {
+    atomic_uint sequence;
+    atomic_uint timeUs;
+    atomic_uint id;
+    atomic_int arg0;
+    atomic_int arg1;
+} EventSlot;
+
+typedef struct {
+    EventSlot slots[DMS_EVENT_RING_SIZE];
+    atomic_uint next;
+} EventRing;
+
+static EventRing g_events;
+
+static const char *g_eventFormats[DMS_EVENT_ID_NUM] = {
+    [DMS_EVENT_NONE] = "none %d %d",
+    [DMS_EVENT_BYTES_RECEIVED] = "bytes received session %d, length %d",
+    [DMS_EVENT_PARSE_DONE] = "parse done errCode %d, length %d",
+    [DMS_EVENT_TLV_NODE] = "tlv node type %d, length %d",
+    [DMS_EVENT_STRING_FIELD] = "string field type %d, length %d",
+    [DMS_EVENT_COMMAND] = "command %d on session %d",
+    [DMS_EVENT_COMMAND_DONE] = "command done session %d, errCode %d",
+    [DMS_EVENT_REPLY] = "reply session %d, errCode %d",
+    [DMS_EVENT_FLOW_STATE] = "flow state 0x%06x after %d ms",
+};
+
+static uint32_t GetTimeUs()
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)now.tv_sec * US_PER_SECOND + (uint64_t)now.tv_nsec / NS_PER_US);
+}
+
+void RecordDmsEvent(DmsEventId id, int32_t arg0, int32_t arg1)
+{
+    uint32_t pos = atomic_fetch_add_explicit(&g_events.next, 1, memory_order_relaxed);
+    EventSlot *slot = &g_events.slots[pos & EVENT_RING_MASK];
+    atomic_store_explicit(&slot->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slot->timeUs, GetTimeUs(), memory_order_relaxed);
+    atomic_store_explicit(&slot->id, (uint32_t)id, memory_order_relaxed);
+    atomic_store_explicit(&slot->arg0, arg0, memory_order_relaxed);
+    atomic_store_explicit(&slot->arg1, arg1, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+}
+
+static bool ReadEvent(uint32_t pos, DmsEvent *event)
+{
+    EventSlot *slot = &g_events.slots[pos & EVENT_RING_MASK];
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    event->timeUs = atomic_load_explicit(&slot->timeUs, memory_order_relaxed);
+    event->id = (uint16_t)atomic_load_explicit(&slot->id, memory_order_relaxed);
+    event->arg0 = atomic_load_explicit(&slot->arg0, memory_order_relaxed);
+    event->arg1 = atomic_load_explicit(&slot->arg1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&slot->sequence, memory_order_relaxed) == pos + 1 && event->id < DMS_EVENT_ID_NUM;
+}
+
+uint32_t CopyDmsEvents(DmsEvent *events, uint32_t num)
+{
+    if (events == NULL) {
+        return 0;
+    }
+    uint32_t end = atomic_load_explicit(&g_events.next, memory_order_acquire);
+    uint32_t begin = (end > DMS_EVENT_RING_SIZE) ? end - DMS_EVENT_RING_SIZE : 0;
+    uint32_t copied = 0;
+    for (uint32_t pos = begin; pos != end && copied < num; pos++) {
+        if (ReadEvent(pos, &events[copied])) {
+            copied++;
+        }
+    }
+    return copied;
+}
+
+static void LogEventLine(const char *line, void *context)
+{
+    (void)context;
+    HILOGI("[%{public}s]", line);
+}
+
+uint32_t DumpDmsEvents(DmsEventSink sink, void *context)
+{
+    /* too big for the stack of the dms task, dumps are rare and never run concurrently */
+    static DmsEvent events[DMS_EVENT_RING_SIZE];
+    if (sink == NULL) {
+        sink = LogEventLine;
+    }
+    uint32_t num = CopyDmsEvents(events, DMS_EVENT_RING_SIZE);
+    char line[DMS_EVENT_LINE_LEN];
+    char detail[DMS_EVENT_LINE_LEN];
+    for (uint32_t i = 0; i < num; i++) {
+        const DmsEvent *event = &events[i];
+        if (sprintf_s(detail, sizeof(detail), g_eventFormats[event->id], event->arg0, event->arg1) < 0
+            || sprintf_s(line, sizeof(line), "%u us %s", event->timeUs, detail) < 0) {
+            continue;
+        }
+        sink(line, context);
+    }
+    return num;
+}
+
+void ClearDmsEvents()
+{
+    for (uint32_t i = 0; i < DMS_EVENT_RING_SIZE; i++) {
+        atomic_store_explicit(&g_events.slots[i].sequence, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&g_events.next, 0, memory_order_release);
+}
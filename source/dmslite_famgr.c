@@ -17,29 +17,97 @@
 
 #include <malloc.h>
 
+#include "ability_manager.h"
+#include "dmslite_admission.h"
+#include "dmslite_devmgr.h"
 #include "dmslite_feature.h"
 #include "dmslite_log.h"
 #include "dmslite_packet.h"
 #include "dmslite_permission.h"
 #include "dmslite_session.h"
+#include "dmslite_stats.h"
 #include "dmslite_tlv_common.h"
 #include "dmslite_utils.h"
+#include "dmslite_worker.h"
 
 #include "message.h"
 #include "ohos_errno.h"
 #include "securec.h"
 
-#define DMS_VERSION_VALUE 200
 #define ENDING_SYMBOL_LEN 1
+#define ALIGN_SIZE sizeof(void *)
+#define ALIGN_UP(size) (((size) + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1))
 
-static int32_t FillRequestData(RequestData *reqdata, const Want *want,
-    const CallerInfo *callerInfo, const IDmsListener *callback);
-static int32_t MarshallDmsMessage(const Want *want, const CallerInfo *callerInfo);
+typedef struct {
+    uint8_t *pos;
+    uint32_t remaining;
+} PackCursor;
+
+static RequestData *PackRequestData(const Want *want, const CallerInfo *callerInfo,
+    const IDmsListener *callback);
+static RemoteStartData *PackRemoteStartData(const char *bundleName, const char *abilityName,
+    int32_t sessionId, StartAbilityCallback onStartAbilityDone);
+static BatchRequestData *PackBatchRequestData(const DmsBatchTarget *targets, uint8_t num,
+    const CallerInfo *callerInfo, const IDmsBatchListener *callback);
+/* signature of the local caller, peers that support it get the digest instead of the appId */
+typedef struct {
+    const char *appId;
+    const uint8_t *digest;
+} CallerSignature;
+
+static int32_t MarshallDmsMessage(const Want *want, uint16_t version, const CallerInfo *callerInfo,
+    const CallerSignature *signature);
+static uint16_t GetStartFrameVersion(const char *deviceId);
 
 int32_t StartAbilityFromRemote(const char *bundleName, const char *abilityName,
-    StartAbilityCallback onStartAbilityDone)
+    int32_t sessionId, StartAbilityCallback onStartAbilityDone)
 {
-    return EC_SUCCESS;
+    if (bundleName == NULL || abilityName == NULL) {
+        return DMS_EC_INVALID_PARAMETER;
+    }
+    RemoteStartData *startData = PackRemoteStartData(bundleName, abilityName, sessionId, onStartAbilityDone);
+    if (startData == NULL) {
+        HILOGE("[PackRemoteStartData failed]");
+        return DMS_EC_START_ABILITY_ASYNC_FAILURE;
+    }
+
+    /* leave the parse path right away, the ability is started from the queue of the start lane */
+    Request request = {
+        .msgId = START_ABILITY_FROM_REMOTE,
+        .data = (void *)startData,
+        .len = sizeof(RemoteStartData),
+        .msgValue = sessionId
+    };
+    int32_t result = SAMGR_SendRequest(GetStartLaneIdentity(), &request, NULL);
+    if (result != EC_SUCCESS) {
+        DMS_FREE(startData);
+        HILOGE("[StartAbilityFromRemote SendRequest errCode = %d]", result);
+        return DMS_EC_START_ABILITY_ASYNC_FAILURE;
+    }
+    return DMS_EC_START_ABILITY_ASYNC_SUCCESS;
+}
+
+void HandleStartAbilityFromRemote(const RemoteStartData *data)
+{
+    if (data == NULL || data->want == NULL) {
+        return;
+    }
+    int32_t ret = StartAbility(data->want);
+    HILOGI("[StartAbility ret = %d]", ret);
+    int8_t errCode = (ret == EC_SUCCESS) ? DMS_EC_SUCCESS : DMS_EC_START_ABILITY_ASYNC_FAILURE;
+    if (data->onStartAbilityDone != NULL) {
+        data->onStartAbilityDone(data->sessionId, errCode);
+    }
+}
+
+/* a full dms queue is reported as overload, so the caller knows a retry may succeed */
+static int32_t ToStartResult(int32_t sendResult)
+{
+    if (sendResult != EC_BUSBUSY) {
+        return sendResult;
+    }
+    AddDmsStat(DMS_STAT_BUSY_REJECTIONS, 1);
+    return DMS_EC_OVERLOADED;
 }
 
 int32_t StartRemoteAbilityInner(const Want *want, const CallerInfo *callerInfo,
@@ -49,37 +117,81 @@ int32_t StartRemoteAbilityInner(const Want *want, const CallerInfo *callerInfo,
         HILOGE("[param error!]");
         return DMS_EC_FAILURE;
     }
-    RequestData *reqdata = (RequestData *)DMS_ALLOC(sizeof(RequestData));
+    if (!AcquireAdmission(ADMISSION_LOCAL, callerInfo->uid)) {
+        return DMS_EC_OVERLOADED;
+    }
+    RequestData *reqdata = PackRequestData(want, callerInfo, callback);
     if (reqdata == NULL) {
-        HILOGE("[mem alloc error!]");
+        ReleaseAdmission(ADMISSION_LOCAL, callerInfo->uid);
+        HILOGE("[PackRequestData failed]");
         return DMS_EC_FAILURE;
     }
-    if (memset_s(reqdata, sizeof(RequestData), 0x00, sizeof(RequestData)) != EOK) {
-        DMS_FREE(reqdata);
-        HILOGE("[RequestData memset failed]");
-        return DMS_EC_FAILURE;
+
+    /* the whole packed block is released by samgr once the request has been handled */
+    Request request = {
+        .msgId = START_REMOTE_ABILITY,
+        .data = (void *)reqdata,
+        .len = sizeof(RequestData),
+        .msgValue = 0
+    };
+    int32_t result = SAMGR_SendRequest((const Identity*)&(GetDmsLiteFeature()->identity), &request, NULL);
+    if (result != EC_SUCCESS) {
+        ReleaseAdmission(ADMISSION_LOCAL, callerInfo->uid);
+        FreeRequestData(reqdata);
+        HILOGD("[StartRemoteAbilityInner SendRequest errCode = %d]", result);
     }
+    return ToStartResult(result);
+}
 
-    if (FillRequestData(reqdata, want, callerInfo, callback) != DMS_EC_SUCCESS) {
-        FreeRequestData(reqdata->want, reqdata->callerInfo);
-        DMS_FREE(reqdata);
-        HILOGE("[FillRequestData failed]");
+static bool IsValidBatch(const DmsBatchTarget *targets, uint8_t num, const CallerInfo *callerInfo)
+{
+    if (targets == NULL || num == 0 || num > DMS_MAX_BATCH_TARGETS || callerInfo == NULL) {
+        return false;
+    }
+    for (uint8_t i = 0; i < num; i++) {
+        if (targets[i].deviceId == NULL || targets[i].want == NULL || targets[i].want->element == NULL) {
+            return false;
+        }
+        /* identical wants are found by their names, see IsSameWant */
+        const ElementName *element = targets[i].want->element;
+        if (element->bundleName == NULL || element->abilityName == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int32_t StartRemoteAbilitiesInner(const DmsBatchTarget *targets, uint8_t num,
+    const CallerInfo *callerInfo, const IDmsBatchListener *callback)
+{
+    if (!IsValidBatch(targets, num, callerInfo)) {
+        HILOGE("[param error!]");
+        return DMS_EC_INVALID_PARAMETER;
+    }
+    if (!AcquireAdmission(ADMISSION_LOCAL, callerInfo->uid)) {
+        return DMS_EC_OVERLOADED;
+    }
+    BatchRequestData *reqdata = PackBatchRequestData(targets, num, callerInfo, callback);
+    if (reqdata == NULL) {
+        ReleaseAdmission(ADMISSION_LOCAL, callerInfo->uid);
+        HILOGE("[PackBatchRequestData failed]");
         return DMS_EC_FAILURE;
     }
 
+    /* the whole packed block is released by samgr once the request has been handled */
     Request request = {
-        .msgId = START_REMOTE_ABILITY,
+        .msgId = START_REMOTE_ABILITIES,
         .data = (void *)reqdata,
-        .len = sizeof(RequestData),
-        .msgValue = 0
+        .len = sizeof(BatchRequestData),
+        .msgValue = num
     };
     int32_t result = SAMGR_SendRequest((const Identity*)&(GetDmsLiteFeature()->identity), &request, NULL);
     if (result != EC_SUCCESS) {
-        FreeRequestData(reqdata->want, reqdata->callerInfo);
+        ReleaseAdmission(ADMISSION_LOCAL, callerInfo->uid);
         DMS_FREE(reqdata);
-        HILOGD("[StartRemoteAbilityInner SendRequest errCode = %d]", result);
+        HILOGD("[StartRemoteAbilitiesInner SendRequest errCode = %d]", result);
     }
-    return result;
+    return ToStartResult(result);
 }
 
 int32_t StartRemoteAbility(const Want *want, CallerInfo *callerInfo, IDmsListener *callback)
@@ -90,142 +202,365 @@ int32_t StartRemoteAbility(const Want *want, CallerInfo *callerInfo, IDmsListene
     }
     if (IsDmsBusy()) {
         HILOGI("[StartRemoteAbility dms busy]");
-        return DMS_EC_FAILURE;
+        AddDmsStat(DMS_STAT_BUSY_REJECTIONS, 1);
+        return DMS_EC_OVERLOADED;
+    }
+    if (IsPeerBackingOff(want->element->deviceId)) {
+        HILOGI("[StartRemoteAbility peer overloaded]");
+        return DMS_EC_OVERLOADED;
     }
 #ifndef XTS_SUITE_TEST
     if (!PreprareBuild()) {
         return DMS_EC_FAILURE;
     }
 #endif
-    if (MarshallDmsMessage(want, callerInfo) != DMS_EC_SUCCESS) {
+    uint16_t version = GetStartFrameVersion(want->element->deviceId);
+    if (MarshallDmsMessage(want, version, callerInfo, NULL) != DMS_EC_SUCCESS) {
         return DMS_EC_FAILURE;
     }
 #ifndef XTS_SUITE_TEST
     int32_t ret = SendDmsMessage(GetPacketBufPtr(), GetPacketSize(),
         want->element->deviceId, callback);
+    CleanBuild();
     return ret;
 #else
     return DMS_EC_SUCCESS;
 #endif
 }
 
-static int32_t MarshallDmsMessage(const Want *want, const CallerInfo *callerInfo)
+static bool IsSameWant(const Want *want, const Want *other)
 {
-    PACKET_MARSHALL_HELPER(Uint16, COMMAND_ID, DMS_MSG_CMD_START_FA);
-    PACKET_MARSHALL_HELPER(Uint16, DMS_VERSION, DMS_VERSION_VALUE);
-    PACKET_MARSHALL_HELPER(String, CALLEE_BUNDLE_NAME, want->element->bundleName);
-    PACKET_MARSHALL_HELPER(String, CALLEE_ABILITY_NAME, want->element->abilityName);
+    if (strcmp(want->element->bundleName, other->element->bundleName) != 0
+        || strcmp(want->element->abilityName, other->element->abilityName) != 0) {
+        return false;
+    }
+    if (want->dataLength != other->dataLength) {
+        return false;
+    }
+    return (want->dataLength == 0) || (memcmp(want->data, other->data, want->dataLength) == 0);
+}
 
-    BundleInfo bundleInfo = {0};
-    int32_t ret = GetCallerBundleInfo(callerInfo, &bundleInfo);
-    if (ret != DMS_EC_SUCCESS) {
-        HILOGE("[StartRemoteAbility GetCallerBundleInfo error = %d]", ret);
-        return DMS_EC_FAILURE;
+static uint16_t GetStartFrameVersion(const char *deviceId)
+{
+    DmsPeerCapability capability;
+    if (GetPeerCapability(deviceId, &capability) == EC_SUCCESS
+        && capability.version >= DMS_VERSION_SIGNATURE_DIGEST) {
+        return DMS_VERSION_SIGNATURE_DIGEST;
     }
-    if (!MarshallString(bundleInfo.appId, CALLER_SIGNATURE)) {
-        HILOGE("[StartRemoteAbility Marshall appId failed]");
-        ClearBundleInfo(&bundleInfo);
-        return DMS_EC_FAILURE;
+    /* peers whose capability is not known yet get the frame every version can parse */
+    return DMS_VERSION_LEGACY;
+}
+
+static char *BuildStartFrame(const Want *want, uint16_t version, const CallerSignature *signature,
+    uint16_t *frameLen)
+{
+    if (!PreprareBuild()) {
+        return NULL;
+    }
+    if (MarshallDmsMessage(want, version, NULL, signature) != DMS_EC_SUCCESS) {
+        CleanBuild();
+        return NULL;
     }
-    ClearBundleInfo(&bundleInfo);
+    uint16_t len = GetPacketSize();
+    char *frame = (char *)DMS_ALLOC(len);
+    if (frame != NULL && memcpy_s(frame, len, GetPacketBufPtr(), len) != EOK) {
+        DMS_FREE(frame);
+    }
+    CleanBuild();
+    *frameLen = len;
+    return frame;
+}
 
-    if (want->data != NULL && want->dataLength > 0) {
-        RAWDATA_MARSHALL_HELPER(RawData, CALLER_PAYLOAD, want->data, want->dataLength);
+static void FreeBatchFrames(DmsBatchEntry *entries, uint8_t num)
+{
+    for (uint8_t i = 0; i < num; i++) {
+        if (entries[i].ownsFrame) {
+            DMS_FREE(entries[i].frame);
+        }
     }
-    return DMS_EC_SUCCESS;
 }
 
-static int32_t FillCallerInfo(RequestData *reqdata, const CallerInfo *callerInfo)
+int32_t StartRemoteAbilities(const BatchRequestData *data)
 {
-    if (callerInfo == NULL || reqdata == NULL) {
-        return DMS_EC_FAILURE;
+    if (data == NULL || !IsValidBatch(data->targets, data->num, data->callerInfo)) {
+        return DMS_EC_INVALID_PARAMETER;
     }
-    CallerInfo *callerData = (CallerInfo *)DMS_ALLOC(sizeof(CallerInfo));
-    if (callerData == NULL) {
-        return DMS_EC_FAILURE;
+    HILOGI("[StartRemoteAbilities num = %u]", data->num);
+    if (IsDmsBatchBusy()) {
+        HILOGI("[StartRemoteAbilities dms busy]");
+        AddDmsStat(DMS_STAT_BUSY_REJECTIONS, 1);
+        return DMS_EC_OVERLOADED;
     }
-    if (memset_s(callerData, sizeof(CallerInfo), 0x00, sizeof(CallerInfo)) != EOK) {
-        DMS_FREE(callerData);
-        HILOGE("[CallerInfo memset error]");
+
+    /* the caller signature is looked up once for the whole batch */
+    CallerSignature signature = { 0 };
+    int32_t ret = GetCallerAppIdDigest(data->callerInfo, &signature.appId, &signature.digest);
+    if (ret != DMS_EC_SUCCESS) {
+        HILOGE("[StartRemoteAbilities GetCallerAppIdDigest error = %d]", ret);
         return DMS_EC_FAILURE;
     }
-    reqdata->callerInfo = callerData;
 
-    callerData->uid = callerInfo->uid;
-    if (callerInfo->bundleName != NULL) {
-        int32_t size = strlen(callerInfo->bundleName) + ENDING_SYMBOL_LEN;
-        char *data = (char *)DMS_ALLOC(size);
-        if (data == NULL) {
-            return DMS_EC_FAILURE;
+    /* the packed wants carry no deviceId, the version comes from the target itself */
+    uint16_t versions[DMS_MAX_BATCH_TARGETS];
+    DmsBatchEntry entries[DMS_MAX_BATCH_TARGETS];
+    for (uint8_t i = 0; i < data->num; i++) {
+        const DmsBatchTarget *target = &data->targets[i];
+        entries[i].deviceId = target->deviceId;
+        entries[i].ownsFrame = false;
+        /* targets asking for the same ability with the same frame version share one marshalled frame */
+        versions[i] = GetStartFrameVersion(target->deviceId);
+        uint8_t same = 0;
+        while (same < i && (!IsSameWant(target->want, data->targets[same].want) || versions[i] != versions[same])) {
+            same++;
         }
-        if (memcpy_s(data, size, callerInfo->bundleName, size) != EOK) {
-            DMS_FREE(data);
+        if (same < i) {
+            entries[i].frame = entries[same].frame;
+            entries[i].frameLen = entries[same].frameLen;
+            continue;
+        }
+        entries[i].frame = BuildStartFrame(target->want, versions[i], &signature, &entries[i].frameLen);
+        if (entries[i].frame == NULL) {
+            HILOGE("[StartRemoteAbilities marshall failed, index = %u]", i);
+            FreeBatchFrames(entries, i);
             return DMS_EC_FAILURE;
         }
-        data[size - ENDING_SYMBOL_LEN] = '\0';
-        callerData->bundleName = data;
+        entries[i].ownsFrame = true;
     }
-    return DMS_EC_SUCCESS;
+    return SendDmsBatchMessage(entries, data->num, data->callback);
 }
 
-static int32_t FillRequestData(RequestData *reqdata, const Want *want,
-    const CallerInfo *callerInfo, const IDmsListener *callback)
+void ReportBatchFailure(const BatchRequestData *data, int32_t result)
 {
-    Want *wantData = (Want *)DMS_ALLOC(sizeof(Want));
-    if (wantData == NULL) {
-        return DMS_EC_FAILURE;
+    if (data == NULL || data->callback == NULL) {
+        return;
     }
-    if (memset_s(wantData, sizeof(Want), 0x00, sizeof(Want)) != EOK) {
-        DMS_FREE(wantData);
-        return DMS_EC_FAILURE;
+    for (uint8_t i = 0; i < data->num; i++) {
+        if (data->callback->OnDeviceResult != NULL) {
+            data->callback->OnDeviceResult(i, result);
+        }
     }
-    reqdata->want = wantData;
+    if (data->callback->OnBatchResult != NULL) {
+        data->callback->OnBatchResult(0, data->num);
+    }
+}
 
-    ElementName elementData;
-    if (memset_s(&elementData, sizeof(ElementName), 0x00, sizeof(ElementName)) != EOK) {
-        return DMS_EC_FAILURE;
+/*
+ * version is the one negotiated with the target device, signature may be passed in when it has already
+ * been looked up, otherwise it is taken from callerInfo
+ */
+static int32_t MarshallDmsMessage(const Want *want, uint16_t version, const CallerInfo *callerInfo,
+    const CallerSignature *signature)
+{
+    PACKET_MARSHALL_HELPER(Uint16, COMMAND_ID, DMS_MSG_CMD_START_FA);
+    PACKET_MARSHALL_HELPER(Uint16, DMS_VERSION, version);
+    PACKET_MARSHALL_HELPER(String, CALLEE_BUNDLE_NAME, want->element->bundleName);
+    PACKET_MARSHALL_HELPER(String, CALLEE_ABILITY_NAME, want->element->abilityName);
+
+    CallerSignature lookedUp = { 0 };
+    if (signature == NULL) {
+        int32_t ret = GetCallerAppIdDigest(callerInfo, &lookedUp.appId, &lookedUp.digest);
+        if (ret != DMS_EC_SUCCESS) {
+            HILOGE("[StartRemoteAbility GetCallerAppIdDigest error = %d]", ret);
+            return DMS_EC_FAILURE;
+        }
+        signature = &lookedUp;
     }
-    if (!(SetElementBundleName(&elementData, want->element->bundleName)
-        && SetElementAbilityName(&elementData, want->element->abilityName)
-        && SetElementDeviceID(&elementData, want->element->deviceId)
-        && SetWantElement(wantData, elementData))) {
-        HILOGE("[FillRequestData error]");
-        ClearElement(&elementData);
-        ClearWant(wantData);
+    bool marshalled = (version >= DMS_VERSION_SIGNATURE_DIGEST)
+        ? MarshallRawData(signature->digest, CALLER_SIGNATURE, SIGNATURE_DIGEST_LEN)
+        : MarshallString(signature->appId, CALLER_SIGNATURE);
+    if (!marshalled) {
+        HILOGE("[StartRemoteAbility Marshall signature failed]");
         return DMS_EC_FAILURE;
     }
-    ClearElement(&elementData);
 
     if (want->data != NULL && want->dataLength > 0) {
-        void *data = DMS_ALLOC(want->dataLength);
-        if (data == NULL) {
-            return DMS_EC_FAILURE;
-        }
-        if (memcpy_s(data, want->dataLength, want->data, want->dataLength) != EOK) {
-            DMS_FREE(data);
-            return DMS_EC_FAILURE;
-        }
-        wantData->data = data;
-        wantData->dataLength = want->dataLength;
+        RAWDATA_MARSHALL_HELPER(RawData, CALLER_PAYLOAD, want->data, want->dataLength);
     }
+    return DMS_EC_SUCCESS;
+}
 
-    if (FillCallerInfo(reqdata, callerInfo) != DMS_EC_SUCCESS) {
-        return DMS_EC_FAILURE;
+static uint32_t GetStringSize(const char *str)
+{
+    return (str == NULL) ? 0 : (strlen(str) + ENDING_SYMBOL_LEN);
+}
+
+static void *TakeBlock(PackCursor *cursor, uint32_t size)
+{
+    if (size == 0 || size > cursor->remaining) {
+        return NULL;
+    }
+    void *block = cursor->pos;
+    cursor->pos += size;
+    cursor->remaining -= size;
+    return block;
+}
+
+static bool PackData(PackCursor *cursor, const void *data, uint32_t size, void **packed)
+{
+    *packed = NULL;
+    if (data == NULL || size == 0) {
+        return true;
+    }
+    void *block = TakeBlock(cursor, size);
+    if (block == NULL || memcpy_s(block, size, data, size) != EOK) {
+        return false;
+    }
+    *packed = block;
+    return true;
+}
+
+static bool PackString(PackCursor *cursor, const char *str, char **packed)
+{
+    return PackData(cursor, str, GetStringSize(str), (void **)packed);
+}
+
+static RequestData *PackRequestData(const Want *want, const CallerInfo *callerInfo,
+    const IDmsListener *callback)
+{
+    const ElementName *element = want->element;
+    uint32_t payloadSize = (want->data != NULL) ? want->dataLength : 0;
+    uint32_t headSize = ALIGN_UP(sizeof(RequestData)) + ALIGN_UP(sizeof(Want))
+        + ALIGN_UP(sizeof(ElementName)) + ALIGN_UP(sizeof(CallerInfo));
+    uint32_t totalSize = headSize + GetStringSize(element->deviceId) + GetStringSize(element->bundleName)
+        + GetStringSize(element->abilityName) + GetStringSize(callerInfo->bundleName) + payloadSize;
+
+    uint8_t *block = (uint8_t *)DMS_ALLOC_SHARED(totalSize);
+    if (block == NULL) {
+        HILOGE("[mem alloc error!]");
+        return NULL;
+    }
+    if (memset_s(block, totalSize, 0x00, headSize) != EOK) {
+        DMS_FREE(block);
+        return NULL;
+    }
+
+    /* layout: RequestData | Want | ElementName | CallerInfo | strings | payload */
+    PackCursor cursor = {
+        .pos = block,
+        .remaining = totalSize
+    };
+    RequestData *reqdata = (RequestData *)TakeBlock(&cursor, ALIGN_UP(sizeof(RequestData)));
+    Want *wantData = (Want *)TakeBlock(&cursor, ALIGN_UP(sizeof(Want)));
+    ElementName *elementData = (ElementName *)TakeBlock(&cursor, ALIGN_UP(sizeof(ElementName)));
+    CallerInfo *callerData = (CallerInfo *)TakeBlock(&cursor, ALIGN_UP(sizeof(CallerInfo)));
+    if (!(PackString(&cursor, element->deviceId, &elementData->deviceId)
+        && PackString(&cursor, element->bundleName, &elementData->bundleName)
+        && PackString(&cursor, element->abilityName, &elementData->abilityName)
+        && PackString(&cursor, callerInfo->bundleName, &callerData->bundleName)
+        && PackData(&cursor, want->data, payloadSize, &wantData->data))) {
+        HILOGE("[PackRequestData error]");
+        DMS_FREE(block);
+        return NULL;
     }
+    wantData->element = elementData;
+    wantData->dataLength = payloadSize;
+    callerData->uid = callerInfo->uid;
 
+    reqdata->want = wantData;
+    reqdata->callerInfo = callerData;
     reqdata->callback = (IDmsListener *)callback;
-    return DMS_EC_SUCCESS;
+    return reqdata;
+}
+
+static RemoteStartData *PackRemoteStartData(const char *bundleName, const char *abilityName,
+    int32_t sessionId, StartAbilityCallback onStartAbilityDone)
+{
+    uint32_t headSize = ALIGN_UP(sizeof(RemoteStartData)) + ALIGN_UP(sizeof(Want)) + ALIGN_UP(sizeof(ElementName));
+    uint32_t totalSize = headSize + GetStringSize(bundleName) + GetStringSize(abilityName);
+
+    uint8_t *block = (uint8_t *)DMS_ALLOC_SHARED(totalSize);
+    if (block == NULL) {
+        HILOGE("[mem alloc error!]");
+        return NULL;
+    }
+    if (memset_s(block, totalSize, 0x00, headSize) != EOK) {
+        DMS_FREE(block);
+        return NULL;
+    }
+
+    /* layout: RemoteStartData | Want | ElementName | strings */
+    PackCursor cursor = {
+        .pos = block,
+        .remaining = totalSize
+    };
+    RemoteStartData *startData = (RemoteStartData *)TakeBlock(&cursor, ALIGN_UP(sizeof(RemoteStartData)));
+    Want *wantData = (Want *)TakeBlock(&cursor, ALIGN_UP(sizeof(Want)));
+    ElementName *elementData = (ElementName *)TakeBlock(&cursor, ALIGN_UP(sizeof(ElementName)));
+    if (!(PackString(&cursor, bundleName, &elementData->bundleName)
+        && PackString(&cursor, abilityName, &elementData->abilityName))) {
+        HILOGE("[PackRemoteStartData error]");
+        DMS_FREE(block);
+        return NULL;
+    }
+    wantData->element = elementData;
+
+    startData->want = wantData;
+    startData->sessionId = sessionId;
+    startData->onStartAbilityDone = onStartAbilityDone;
+    return startData;
 }
 
-void FreeRequestData(const Want *want, CallerInfo *callerInfo)
+static BatchRequestData *PackBatchRequestData(const DmsBatchTarget *targets, uint8_t num,
+    const CallerInfo *callerInfo, const IDmsBatchListener *callback)
 {
-    if (want != NULL) {
-        ClearWant((Want *)want);
-        DMS_FREE(want);
+    uint32_t headSize = ALIGN_UP(sizeof(BatchRequestData)) + ALIGN_UP(sizeof(DmsBatchTarget) * num)
+        + ALIGN_UP(sizeof(Want) * num) + ALIGN_UP(sizeof(ElementName) * num) + ALIGN_UP(sizeof(CallerInfo));
+    uint32_t totalSize = headSize + GetStringSize(callerInfo->bundleName);
+    for (uint8_t i = 0; i < num; i++) {
+        const Want *want = targets[i].want;
+        totalSize += GetStringSize(targets[i].deviceId) + GetStringSize(want->element->bundleName)
+            + GetStringSize(want->element->abilityName) + ((want->data != NULL) ? want->dataLength : 0);
+    }
+
+    uint8_t *block = (uint8_t *)DMS_ALLOC_SHARED(totalSize);
+    if (block == NULL) {
+        HILOGE("[mem alloc error!]");
+        return NULL;
+    }
+    if (memset_s(block, totalSize, 0x00, headSize) != EOK) {
+        DMS_FREE(block);
+        return NULL;
     }
 
-    if (callerInfo != NULL) {
-        DMS_FREE(callerInfo->bundleName);
-        DMS_FREE(callerInfo);
+    /* layout: BatchRequestData | DmsBatchTarget[num] | Want[num] | ElementName[num] | CallerInfo | data */
+    PackCursor cursor = {
+        .pos = block,
+        .remaining = totalSize
+    };
+    BatchRequestData *reqdata = (BatchRequestData *)TakeBlock(&cursor, ALIGN_UP(sizeof(BatchRequestData)));
+    DmsBatchTarget *targetData = (DmsBatchTarget *)TakeBlock(&cursor, ALIGN_UP(sizeof(DmsBatchTarget) * num));
+    Want *wantData = (Want *)TakeBlock(&cursor, ALIGN_UP(sizeof(Want) * num));
+    ElementName *elementData = (ElementName *)TakeBlock(&cursor, ALIGN_UP(sizeof(ElementName) * num));
+    CallerInfo *callerData = (CallerInfo *)TakeBlock(&cursor, ALIGN_UP(sizeof(CallerInfo)));
+    bool packed = PackString(&cursor, callerInfo->bundleName, &callerData->bundleName);
+    for (uint8_t i = 0; packed && i < num; i++) {
+        const Want *want = targets[i].want;
+        uint32_t payloadSize = (want->data != NULL) ? want->dataLength : 0;
+        char *deviceId = NULL;
+        packed = PackString(&cursor, targets[i].deviceId, &deviceId)
+            && PackString(&cursor, want->element->bundleName, &elementData[i].bundleName)
+            && PackString(&cursor, want->element->abilityName, &elementData[i].abilityName)
+            && PackData(&cursor, want->data, payloadSize, &wantData[i].data);
+        wantData[i].element = &elementData[i];
+        wantData[i].dataLength = payloadSize;
+        targetData[i].deviceId = deviceId;
+        targetData[i].want = &wantData[i];
+    }
+    if (!packed) {
+        HILOGE("[PackBatchRequestData error]");
+        DMS_FREE(block);
+        return NULL;
     }
-}
\ No newline at end of file
+    callerData->uid = callerInfo->uid;
+
+    reqdata->num = num;
+    reqdata->targets = targetData;
+    reqdata->callerInfo = callerData;
+    reqdata->callback = (IDmsBatchListener *)callback;
+    return reqdata;
+}
+
+void FreeRequestData(RequestData *reqdata)
+{
+    DMS_FREE(reqdata);
+}
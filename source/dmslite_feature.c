@@ -15,10 +15,19 @@
 
 #include "dmslite_feature.h"
 
+#include "dmslite_admission.h"
+#include "dmslite_bms.h"
+#include "dmslite_devmgr.h"
 #include "dmslite_famgr.h"
+#include "dmslite_histogram.h"
+#include "dmslite_ingress.h"
 #include "dmslite_log.h"
+#include "dmslite_permission.h"
 #include "dmslite_session.h"
+#include "dmslite_stats.h"
+#include "dmslite_utils.h"
 
+#include "ohos_errno.h"
 #include "ohos_init.h"
 #include "samgr_lite.h"
 #include "securec.h" 
@@ -29,6 +38,9 @@ static const char *GetName(Feature *feature);
 static void OnInitialize(Feature *feature, Service *parent, Identity identity);
 static void OnStop(Feature *feature, Identity identity);
 static BOOL OnMessage(Feature *feature, Request *request);
+static int32_t GetLowestLatencyPeerInner(const Want *want, char *networkId, uint16_t len);
+static int32_t GetPeerLatencyInner(const char *networkId, DmsLatencySide side, DmsLatencyStats *stats);
+static int32_t GetPeerRejectionsInner(const char *networkId, uint32_t *rejectNum);
 
 DmsLite g_dmslite = {
     /* feature functions */
@@ -40,6 +52,13 @@ DmsLite g_dmslite = {
     /* dms interface for other subsystems */
     DEFAULT_IUNKNOWN_ENTRY_BEGIN,
     .StartRemoteAbility = StartRemoteAbilityInner,
+    .StartRemoteAbilities = StartRemoteAbilitiesInner,
+    .GetLowestLatencyPeer = GetLowestLatencyPeerInner,
+    .GetStats = GetDmsStats,
+    .GetCommandLatency = GetCommandLatency,
+    .GetPeerLatency = GetPeerLatencyInner,
+    .GetPeerRejections = GetPeerRejectionsInner,
+    .ResetLatency = ResetDmsLatency,
     DEFAULT_IUNKNOWN_ENTRY_END
 };
 
@@ -48,6 +67,34 @@ DmsLite *GetDmsLiteFeature()
     return &g_dmslite;
 }
 
+/* the peer registry reports ohos_errno codes, callers of DmsProxy get DmsLiteCommonErrorCode */
+static int32_t ToDmsErrorCode(int32_t errCode)
+{
+    switch (errCode) {
+        case EC_SUCCESS:
+            return DMS_EC_SUCCESS;
+        case EC_INVALID:
+            return DMS_EC_INVALID_PARAMETER;
+        default:
+            return DMS_EC_FAILURE;
+    }
+}
+
+static int32_t GetLowestLatencyPeerInner(const Want *want, char *networkId, uint16_t len)
+{
+    return ToDmsErrorCode(GetLowestLatencyPeer(want, networkId, len));
+}
+
+static int32_t GetPeerLatencyInner(const char *networkId, DmsLatencySide side, DmsLatencyStats *stats)
+{
+    return ToDmsErrorCode(GetPeerLatency(networkId, side, stats));
+}
+
+static int32_t GetPeerRejectionsInner(const char *networkId, uint32_t *rejectNum)
+{
+    return ToDmsErrorCode(GetPeerRejections(networkId, rejectNum));
+}
+
 static const char *GetName(Feature *feature)
 {
     if (feature == NULL) {
@@ -63,11 +110,32 @@ static void OnInitialize(Feature *feature, Service *parent, Identity identity)
     }
 
     ((DmsLite*) feature)->identity = identity;
+    LoadNativeAppIdIndex();
+    if (AddBundleStatusListener() != EC_SUCCESS) {
+        HILOGW("[AddBundleStatusListener failed, cached bundle data expires by ttl only]");
+    }
+    if (AddDevMgrListener() != EC_SUCCESS) {
+        HILOGW("[AddDevMgrListener failed]");
+    }
+    if (StartBmsPrefetch() != EC_SUCCESS) {
+        HILOGW("[StartBmsPrefetch failed, bundle info is fetched on demand]");
+    }
 }
 
 static void OnStop(Feature *feature, Identity identity)
 {
     HILOGD("[Feature stop]");
+    (void)RemoveBundleStatusListener();
+    (void)UnRegisterDevMgrListener();
+    StopBmsPrefetch();
+}
+
+/* a start that failed before its flow began is reported to its own listener */
+static void ReportStartFailure(const IDmsListener *listener, int32_t result)
+{
+    if (listener != NULL && listener->OnResultCallback != NULL) {
+        listener->OnResultCallback(NULL, result);
+    }
 }
 
 static BOOL OnMessage(Feature *feature, Request *request)
@@ -80,32 +148,51 @@ static BOOL OnMessage(Feature *feature, Request *request)
     switch (request->msgId) {
         case START_REMOTE_ABILITY: {
             if (request->data == NULL) {
-                InvokeCallback(NULL, DMS_EC_FAILURE);
                 HILOGE("[START_REMOTE_ABILITY request is NULL]");
                 return FALSE;
             }
             const RequestData *data = (const RequestData *)request->data;
+            /* the packed request block is released by samgr after this message is handled */
             int32_t result = StartRemoteAbility(data->want, data->callerInfo, data->callback);
-            FreeRequestData(data->want, data->callerInfo);
+            ReleaseAdmission(ADMISSION_LOCAL, data->callerInfo->uid);
+            if (result != DMS_EC_SUCCESS) {
+                ReportStartFailure(data->callback, result);
+            }
+            break;
+        }
+        case START_REMOTE_ABILITIES: {
+            if (request->data == NULL) {
+                HILOGE("[START_REMOTE_ABILITIES request is NULL]");
+                return FALSE;
+            }
+            const BatchRequestData *data = (const BatchRequestData *)request->data;
+            int32_t result = StartRemoteAbilities(data);
+            ReleaseAdmission(ADMISSION_LOCAL, data->callerInfo->uid);
             if (result != DMS_EC_SUCCESS) {
-                InvokeCallback(NULL, result);
+                ReportBatchFailure(data, result);
             }
             break;
         }
-        case SESSION_OPEN:
-            HandleSessionOpened(request->msgValue);
+        case START_ABILITY_FROM_REMOTE:
+            /* the packed start block is released by samgr after this message is handled */
+            HandleStartAbilityFromRemote((const RemoteStartData *)request->data);
             break;
-        case SESSION_CLOSE:
-            HandleSessionClosed(request->msgValue);
+        case INGRESS_READY:
+            /* session events and received frames are buffered in the ingress ring */
+            (void)DrainIngressEvents(HandleIngressEvent);
+            ExpireDmsFlows();
             break;
-        case BYTES_RECEIVED:
-            HandleBytesReceived(request->msgValue, request->data, request->len);
+        case REMOTE_START_DONE:
+            if (request->data != NULL) {
+                HandleRemoteStartDone(request->msgValue, *(const int32_t *)request->data);
+            }
             break;
         default: {
             HILOGW("[Unkonwn msgId = %d]", request->msgId);
             break;
         }
     }
+    DMS_HANDOFF(request->data);
     return TRUE;
 }
 
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_flow.h"
+
+#include <stdlib.h>
+
+#include "dmslite_devmgr.h"
+#include "dmslite_event.h"
+#include "dmslite_log.h"
+#include "dmslite_session.h"
+#include "dmslite_stats.h"
+#include "dmslite_utils.h"
+
+#include "securec.h"
+#include "session.h"
+
+#define INVALID_SESSION_ID (-1)
+#define FLOW_ID_SHIFT 16
+#define FLOW_STATE_SHIFT 8
+
+/* flows are created, advanced and released on the dms task only, so the pool needs no lock */
+static DmsFlow g_flows[DMS_MAX_FLOWS];
+static uint8_t g_activeFlowNum = 0;
+
+/* next state per state and event, FLOW_IDLE marks an event the state does not accept */
+static const DmsFlowState g_transitions[FLOW_STATE_NUM][FLOW_EVENT_NUM] = {
+    [FLOW_MARSHALLED] = {
+        [FLOW_EVENT_OPEN] = FLOW_OPENING,
+        [FLOW_EVENT_FAIL] = FLOW_FAILED,
+        [FLOW_EVENT_TIMEOUT] = FLOW_TIMED_OUT,
+    },
+    [FLOW_OPENING] = {
+        [FLOW_EVENT_OPENED] = FLOW_SENT,
+        [FLOW_EVENT_FAIL] = FLOW_FAILED,
+        [FLOW_EVENT_TIMEOUT] = FLOW_TIMED_OUT,
+    },
+    [FLOW_SENT] = {
+        [FLOW_EVENT_SEND_DONE] = FLOW_AWAITING_REPLY,
+        [FLOW_EVENT_FAIL] = FLOW_FAILED,
+        [FLOW_EVENT_TIMEOUT] = FLOW_TIMED_OUT,
+    },
+    [FLOW_AWAITING_REPLY] = {
+        [FLOW_EVENT_REPLY] = FLOW_DONE,
+        [FLOW_EVENT_FAIL] = FLOW_FAILED,
+        [FLOW_EVENT_TIMEOUT] = FLOW_TIMED_OUT,
+    },
+};
+
+static const char *g_stateNames[FLOW_STATE_NUM] = {
+    [FLOW_IDLE] = "Idle",
+    [FLOW_MARSHALLED] = "Marshalled",
+    [FLOW_OPENING] = "Opening",
+    [FLOW_SENT] = "Sent",
+    [FLOW_AWAITING_REPLY] = "AwaitingReply",
+    [FLOW_DONE] = "Done",
+    [FLOW_FAILED] = "Failed",
+    [FLOW_TIMED_OUT] = "TimedOut",
+};
+
+const char *GetFlowStateName(DmsFlowState state)
+{
+    return (state < FLOW_STATE_NUM) ? g_stateNames[state] : "Unknown";
+}
+
+static void RecordFlowState(const DmsFlow *flow, DmsFlowState from, DmsFlowState to)
+{
+    int32_t transition = (int32_t)(((uint32_t)flow->id << FLOW_ID_SHIFT) | ((uint32_t)from << FLOW_STATE_SHIFT) | to);
+    RecordDmsEvent(DMS_EVENT_FLOW_STATE, transition, (int32_t)(GetMonotonicMs() - flow->beginMs));
+}
+
+static bool IsFinalState(DmsFlowState state)
+{
+    return state == FLOW_DONE || state == FLOW_FAILED || state == FLOW_TIMED_OUT;
+}
+
+DmsFlow *CreateFlow(char *frame, uint16_t frameLen, bool ownsFrame, FlowDoneCallback onDone)
+{
+    if (frame == NULL || frameLen == 0) {
+        return NULL;
+    }
+    for (uint8_t i = 0; i < DMS_MAX_FLOWS; i++) {
+        DmsFlow *flow = &g_flows[i];
+        if (flow->state != FLOW_IDLE) {
+            continue;
+        }
+        (void)memset_s(flow, sizeof(DmsFlow), 0x00, sizeof(DmsFlow));
+        flow->id = i;
+        flow->state = FLOW_MARSHALLED;
+        flow->sessionId = INVALID_SESSION_ID;
+        flow->frame = frame;
+        flow->frameLen = frameLen;
+        flow->ownsFrame = ownsFrame;
+        flow->beginMs = GetMonotonicMs();
+        flow->batchIndex = INVALID_BATCH_INDEX;
+        flow->onDone = onDone;
+        g_activeFlowNum++;
+        RecordFlowState(flow, FLOW_IDLE, FLOW_MARSHALLED);
+        return flow;
+    }
+    HILOGW("[CreateFlow no free flow]");
+    return NULL;
+}
+
+/* the slot is free again before onDone runs, so onDone may start a new flow right away */
+static void FinishFlow(DmsFlow *flow, int32_t result)
+{
+    DmsFlow finished = *flow;
+    if (finished.sessionId >= 0) {
+        /* a capability response can no longer arrive on the session, a later one asks again */
+        ReleasePeerCapabilityRequest(finished.sessionId);
+        CloseSession(finished.sessionId);
+        AddDmsStat(DMS_STAT_SESSION_CLOSES, 1);
+    }
+    if (finished.ownsFrame) {
+        DMS_FREE(finished.frame);
+    }
+    finished.frame = NULL;
+    flow->state = FLOW_IDLE;
+    flow->frame = NULL;
+    g_activeFlowNum--;
+    if (finished.onDone != NULL) {
+        finished.onDone(&finished, result);
+    }
+}
+
+bool AdvanceFlow(DmsFlow *flow, DmsFlowEvent event, int32_t result)
+{
+    if (flow == NULL || flow->state >= FLOW_STATE_NUM || event >= FLOW_EVENT_NUM) {
+        return false;
+    }
+    DmsFlowState next = g_transitions[flow->state][event];
+    if (next == FLOW_IDLE) {
+        HILOGW("[flow %hhu ignores event %d in %s]", flow->id, event, GetFlowStateName(flow->state));
+        return false;
+    }
+    RecordFlowState(flow, flow->state, next);
+    flow->state = next;
+    if (next == FLOW_TIMED_OUT) {
+        AddDmsStat(DMS_STAT_TIMEOUTS, 1);
+    }
+    if (IsFinalState(next)) {
+        FinishFlow(flow, (next == FLOW_TIMED_OUT) ? DMS_EC_FAILURE : result);
+    }
+    return true;
+}
+
+DmsFlow *FindFlowBySession(int32_t sessionId)
+{
+    if (sessionId < 0) {
+        return NULL;
+    }
+    for (uint8_t i = 0; i < DMS_MAX_FLOWS; i++) {
+        if (g_flows[i].state != FLOW_IDLE && g_flows[i].sessionId == sessionId) {
+            return &g_flows[i];
+        }
+    }
+    return NULL;
+}
+
+uint8_t ExpireFlows(uint64_t nowMs)
+{
+    uint8_t expired = 0;
+    for (uint8_t i = 0; i < DMS_MAX_FLOWS; i++) {
+        DmsFlow *flow = &g_flows[i];
+        if (flow->state == FLOW_IDLE || nowMs < flow->beginMs + DMS_FLOW_TIMEOUT_MS) {
+            continue;
+        }
+        if (AdvanceFlow(flow, FLOW_EVENT_TIMEOUT, DMS_EC_FAILURE)) {
+            expired++;
+        }
+    }
+    return expired;
+}
+
+bool GetNextFlowDeadline(uint64_t *deadlineMs)
+{
+    bool found = false;
+    for (uint8_t i = 0; i < DMS_MAX_FLOWS; i++) {
+        const DmsFlow *flow = &g_flows[i];
+        if (flow->state == FLOW_IDLE) {
+            continue;
+        }
+        uint64_t deadline = flow->beginMs + DMS_FLOW_TIMEOUT_MS;
+        if (!found || deadline < *deadlineMs) {
+            *deadlineMs = deadline;
+            found = true;
+        }
+    }
+    return found;
+}
+
+uint8_t GetActiveFlowNum()
+{
+    return g_activeFlowNum;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_histogram.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "dmslite_log.h"
+#include "dmslite_tlv_common.h"
+
+#define HISTOGRAM_MAX_VALUE ((1U << DMS_HISTOGRAM_MAX_BITS) - 1)
+#define PERCENT_50 50
+#define PERCENT_90 90
+#define PERCENT_99 99
+#define PERCENT_BASE 100
+#define INVALID_COMMAND_INDEX (-1)
+
+/* only commands answered by the peer have a latency */
+static const uint16_t g_trackedCommands[] = {
+    DMS_MSG_CMD_START_FA,
+    DMS_MSG_CMD_CAPABILITY_REQUEST,
+};
+
+#define TRACKED_COMMAND_NUM (sizeof(g_trackedCommands) / sizeof(g_trackedCommands[0]))
+
+typedef struct {
+    atomic_uint counts[DMS_HISTOGRAM_BUCKET_NUM];
+    atomic_uint max;
+} AtomicHistogram;
+
+static AtomicHistogram g_commandLatency[TRACKED_COMMAND_NUM][DMS_LATENCY_SIDE_NUM];
+
+static uint16_t GetBucketIndex(uint32_t value)
+{
+    if (value > HISTOGRAM_MAX_VALUE) {
+        value = HISTOGRAM_MAX_VALUE;
+    }
+    if (value < DMS_HISTOGRAM_SUB_NUM) {
+        return (uint16_t)value;
+    }
+    uint8_t shift = 0;
+    while ((value >> shift) >= (DMS_HISTOGRAM_SUB_NUM << 1)) {
+        shift++;
+    }
+    /* (value >> shift) keeps the SUB_BITS + 1 highest bits, the top one selects the power of 2 */
+    return (uint16_t)((shift + 1) * DMS_HISTOGRAM_SUB_NUM + (value >> shift) - DMS_HISTOGRAM_SUB_NUM);
+}
+
+static uint32_t GetBucketUpperBound(uint16_t index)
+{
+    if (index < DMS_HISTOGRAM_SUB_NUM) {
+        return index;
+    }
+    uint8_t shift = (uint8_t)(index / DMS_HISTOGRAM_SUB_NUM - 1);
+    uint32_t lower = (uint32_t)(DMS_HISTOGRAM_SUB_NUM + index % DMS_HISTOGRAM_SUB_NUM) << shift;
+    return lower + (1U << shift) - 1;
+}
+
+void RecordHistogram(DmsHistogram *histogram, uint32_t value)
+{
+    if (histogram == NULL) {
+        return;
+    }
+    histogram->counts[GetBucketIndex(value)]++;
+    histogram->total++;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+static uint32_t GetPercentile(const DmsHistogram *histogram, uint8_t percent)
+{
+    /* nearest rank, as GetPeerRttStats does over raw samples */
+    uint64_t rank = ((uint64_t)percent * histogram->total + PERCENT_BASE - 1) / PERCENT_BASE;
+    uint64_t seen = 0;
+    for (uint16_t i = 0; i < DMS_HISTOGRAM_BUCKET_NUM; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint32_t bound = GetBucketUpperBound(i);
+            return (bound < histogram->max) ? bound : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void GetHistogramStats(const DmsHistogram *histogram, DmsLatencyStats *stats)
+{
+    if (histogram == NULL || stats == NULL) {
+        return;
+    }
+    stats->count = histogram->total;
+    if (histogram->total == 0) {
+        stats->p50 = 0;
+        stats->p90 = 0;
+        stats->p99 = 0;
+        stats->max = 0;
+        return;
+    }
+    stats->p50 = GetPercentile(histogram, PERCENT_50);
+    stats->p90 = GetPercentile(histogram, PERCENT_90);
+    stats->p99 = GetPercentile(histogram, PERCENT_99);
+    stats->max = histogram->max;
+}
+
+static int8_t GetCommandIndex(uint16_t commandId)
+{
+    for (uint8_t i = 0; i < TRACKED_COMMAND_NUM; i++) {
+        if (g_trackedCommands[i] == commandId) {
+            return (int8_t)i;
+        }
+    }
+    return INVALID_COMMAND_INDEX;
+}
+
+void RecordCommandLatency(uint16_t commandId, DmsLatencySide side, uint32_t latencyMs)
+{
+    int8_t index = GetCommandIndex(commandId);
+    if (index == INVALID_COMMAND_INDEX || side >= DMS_LATENCY_SIDE_NUM) {
+        return;
+    }
+    AtomicHistogram *histogram = &g_commandLatency[index][side];
+    atomic_fetch_add_explicit(&histogram->counts[GetBucketIndex(latencyMs)], 1, memory_order_relaxed);
+    uint32_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (latencyMs > max && !atomic_compare_exchange_weak_explicit(&histogram->max, &max, latencyMs,
+        memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+/* buckets are read one by one, the total is summed from them so the percentiles stay consistent */
+static void SnapshotHistogram(AtomicHistogram *source, DmsHistogram *snapshot)
+{
+    snapshot->total = 0;
+    for (uint16_t i = 0; i < DMS_HISTOGRAM_BUCKET_NUM; i++) {
+        snapshot->counts[i] = atomic_load_explicit(&source->counts[i], memory_order_relaxed);
+        snapshot->total += snapshot->counts[i];
+    }
+    snapshot->max = atomic_load_explicit(&source->max, memory_order_relaxed);
+}
+
+int32_t GetCommandLatency(uint16_t commandId, DmsLatencySide side, DmsLatencyStats *stats)
+{
+    int8_t index = GetCommandIndex(commandId);
+    if (index == INVALID_COMMAND_INDEX || side >= DMS_LATENCY_SIDE_NUM || stats == NULL) {
+        return DMS_EC_INVALID_PARAMETER;
+    }
+    DmsHistogram snapshot;
+    SnapshotHistogram(&g_commandLatency[index][side], &snapshot);
+    GetHistogramStats(&snapshot, stats);
+    return DMS_EC_SUCCESS;
+}
+
+void ResetCommandLatency()
+{
+    for (uint8_t i = 0; i < TRACKED_COMMAND_NUM; i++) {
+        for (uint8_t side = 0; side < DMS_LATENCY_SIDE_NUM; side++) {
+            AtomicHistogram *histogram = &g_commandLatency[i][side];
+            for (uint16_t j = 0; j < DMS_HISTOGRAM_BUCKET_NUM; j++) {
+                atomic_store_explicit(&histogram->counts[j], 0, memory_order_relaxed);
+            }
+            atomic_store_explicit(&histogram->max, 0, memory_order_relaxed);
+        }
+    }
+}
+
+void DumpCommandLatency()
+{
+    DmsLatencyStats stats;
+    for (uint8_t i = 0; i < TRACKED_COMMAND_NUM; i++) {
+        for (uint8_t side = 0; side < DMS_LATENCY_SIDE_NUM; side++) {
+            if (GetCommandLatency(g_trackedCommands[i], (DmsLatencySide)side, &stats) != DMS_EC_SUCCESS
+                || stats.count == 0) {
+                continue;
+            }
+            HILOGI("[command %hu %{public}s latency: %u samples, p50 %u, p90 %u, p99 %u, max %u ms]",
+                g_trackedCommands[i], (side == DMS_LATENCY_CALLER) ? "caller" : "callee", stats.count,
+                stats.p50, stats.p90, stats.p99, stats.max);
+        }
+    }
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_ingress.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "dmslite_feature.h"
+#include "dmslite_log.h"
+#include "dmslite_utils.h"
+
+#include "ohos_errno.h"
+#include "samgr_lite.h"
+
+#define INGRESS_RING_MASK (DMS_INGRESS_RING_SIZE - 1)
+
+_Static_assert((DMS_INGRESS_RING_SIZE & INGRESS_RING_MASK) == 0, "ring size must be a power of 2");
+
+/*
+ * bounded queue with a sequence per slot: a producer claims a position by advancing the tail, fills the slot
+ * and publishes it by bumping its sequence, so producers never wait on each other or on the consumer.
+ * sequences are stored relative to the slot index, which lets a zeroed ring start out empty
+ */
+typedef struct {
+    atomic_uint sequence;
+    DmsIngressEvent event;
+} IngressSlot;
+
+typedef struct {
+    IngressSlot slots[DMS_INGRESS_RING_SIZE];
+    atomic_uint tail;
+    atomic_uint head;
+    /* set by the producer that posted the wakeup, cleared by the dms task before it drains */
+    atomic_bool drainPending;
+    atomic_uint pushed;
+    atomic_uint dropped;
+    atomic_uint highWater;
+    atomic_uint wakeups;
+    /* written by the dms task only, atomic because GetDmsStats runs on the thread of its caller */
+    atomic_uint drained;
+} IngressRing;
+
+static IngressRing g_ring;
+
+static void UpdateHighWater(uint32_t occupancy)
+{
+    uint32_t highWater = atomic_load_explicit(&g_ring.highWater, memory_order_relaxed);
+    while (occupancy > highWater
+        && !atomic_compare_exchange_weak_explicit(&g_ring.highWater, &highWater, occupancy,
+            memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void WakeDmsTask()
+{
+    if (atomic_exchange_explicit(&g_ring.drainPending, true, memory_order_seq_cst)) {
+        return;
+    }
+    Request request = {
+        .msgId = INGRESS_READY,
+        .len = 0,
+        .data = NULL,
+        .msgValue = 0
+    };
+    int32_t result = SAMGR_SendRequest((const Identity*)&(GetDmsLiteFeature()->identity), &request, NULL);
+    if (result != EC_SUCCESS) {
+        /* the events stay buffered, the next push tries to wake the dms task again */
+        atomic_store_explicit(&g_ring.drainPending, false, memory_order_release);
+        HILOGE("[WakeDmsTask errCode = %d]", result);
+        return;
+    }
+    atomic_fetch_add_explicit(&g_ring.wakeups, 1, memory_order_relaxed);
+}
+
+int32_t PushIngressEvent(uint16_t msgId, int32_t sessionId, void *data, uint32_t len)
+{
+    uint32_t pos = atomic_load_explicit(&g_ring.tail, memory_order_relaxed);
+    IngressSlot *slot = NULL;
+    for (;;) {
+        uint32_t index = pos & INGRESS_RING_MASK;
+        slot = &g_ring.slots[index];
+        uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire) + index;
+        int32_t diff = (int32_t)(sequence - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_ring.tail, &pos, pos + 1,
+                memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&g_ring.dropped, 1, memory_order_relaxed);
+            HILOGE("[PushIngressEvent ring full, msgId = %hu]", msgId);
+            return EC_FAILURE;
+        } else {
+            pos = atomic_load_explicit(&g_ring.tail, memory_order_relaxed);
+        }
+    }
+    slot->event.msgId = msgId;
+    slot->event.sessionId = sessionId;
+    slot->event.data = data;
+    slot->event.len = len;
+    uint32_t index = pos & INGRESS_RING_MASK;
+    atomic_store_explicit(&slot->sequence, pos + 1 - index, memory_order_release);
+
+    atomic_fetch_add_explicit(&g_ring.pushed, 1, memory_order_relaxed);
+    /* head may be read stale here, which only overestimates the occupancy */
+    uint32_t occupancy = pos + 1 - atomic_load_explicit(&g_ring.head, memory_order_relaxed);
+    UpdateHighWater((occupancy > DMS_INGRESS_RING_SIZE) ? DMS_INGRESS_RING_SIZE : occupancy);
+    WakeDmsTask();
+    return EC_SUCCESS;
+}
+
+static bool PopIngressEvent(DmsIngressEvent *event)
+{
+    uint32_t pos = atomic_load_explicit(&g_ring.head, memory_order_relaxed);
+    uint32_t index = pos & INGRESS_RING_MASK;
+    IngressSlot *slot = &g_ring.slots[index];
+    uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire) + index;
+    if ((int32_t)(sequence - (pos + 1)) < 0) {
+        return false;
+    }
+    *event = slot->event;
+    atomic_store_explicit(&slot->sequence, pos + DMS_INGRESS_RING_SIZE - index, memory_order_release);
+    atomic_store_explicit(&g_ring.head, pos + 1, memory_order_relaxed);
+    return true;
+}
+
+uint32_t DrainIngressEvents(IngressHandler handler)
+{
+    /*
+     * cleared first, an event pushed while draining wakes the dms task once more. a plain store could be
+     * reordered after the slot loads below, then a producer sees the flag still set and the consumer an
+     * empty slot. with both sides exchanging the flag, a producer that finds it set has published its slot
+     * to this drain
+     */
+    (void)atomic_exchange_explicit(&g_ring.drainPending, false, memory_order_seq_cst);
+    uint32_t num = 0;
+    DmsIngressEvent event;
+    while (PopIngressEvent(&event)) {
+        if (handler != NULL) {
+            handler(&event);
+        }
+        DMS_FREE(event.data);
+        num++;
+    }
+    atomic_fetch_add_explicit(&g_ring.drained, num, memory_order_relaxed);
+    return num;
+}
+
+void GetIngressStats(DmsIngressStats *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    stats->pushed = atomic_load_explicit(&g_ring.pushed, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&g_ring.dropped, memory_order_relaxed);
+    stats->highWater = atomic_load_explicit(&g_ring.highWater, memory_order_relaxed);
+    stats->wakeups = atomic_load_explicit(&g_ring.wakeups, memory_order_relaxed);
+    stats->drained = atomic_load_explicit(&g_ring.drained, memory_order_relaxed);
+}
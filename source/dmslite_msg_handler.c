@@ -15,36 +15,87 @@
 #include "dmslite_msg_handler.h"
 
 #include "dmsfwk_interface.h"
+#include "dmslite_devmgr.h"
+#include "dmslite_event.h"
 #include "dmslite_famgr.h"
 #include "dmslite_log.h"
 #include "dmslite_permission.h"
 #include "dmslite_session.h"
+#include "dmslite_stats.h"
 #include "dmslite_tlv_common.h"
 #include "dmslite_utils.h"
+#include "ohos_errno.h"
+#include "softbus_common.h"
 
-int32_t StartAbilityFromRemoteHandler(const TlvNode *tlvHead, StartAbilityCallback onStartAbilityDone)
+int32_t StartAbilityFromRemoteHandler(const TlvNode *tlvHead, int32_t sessionId,
+    StartAbilityCallback onStartAbilityDone)
 {
     const char *calleeBundleName = UnMarshallString(tlvHead, CALLEE_BUNDLE_NAME);
     const char *calleeAbilityName = UnMarshallString(tlvHead, CALLEE_ABILITY_NAME);
-    const char *callerSignature = UnMarshallString(tlvHead, CALLER_SIGNATURE);
 
     PermissionCheckInfo permissionCheckInfo;
     permissionCheckInfo.calleeAbilityName = calleeAbilityName;
     permissionCheckInfo.calleeBundleName = calleeBundleName;
-    permissionCheckInfo.callerSignature = callerSignature;
-    int32_t errCode = CheckRemotePermission(&permissionCheckInfo);
+    permissionCheckInfo.callerSignature = NULL;
+    permissionCheckInfo.callerDigest = NULL;
+    if (UnMarshallUint16(tlvHead, DMS_VERSION) >= DMS_VERSION_SIGNATURE_DIGEST) {
+        uint16_t digestLen = 0;
+        const uint8_t *digest = UnMarshallRawData(tlvHead, CALLER_SIGNATURE, &digestLen);
+        permissionCheckInfo.callerDigest = (digestLen == SIGNATURE_DIGEST_LEN) ? digest : NULL;
+    } else {
+        permissionCheckInfo.callerSignature = UnMarshallString(tlvHead, CALLER_SIGNATURE);
+    }
+
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    bool hasPeer = (GetSessionPeerId(sessionId, networkId, NETWORK_ID_BUF_LEN) == EC_SUCCESS);
+    int32_t errCode = hasPeer ? CheckRemoteDenial(networkId, &permissionCheckInfo) : DMS_EC_SUCCESS;
+    if (errCode != DMS_EC_SUCCESS) {
+        HILOGD("[Remote start refused again]");
+        AddDmsStat(DMS_STAT_PERMISSION_DENIALS, 1);
+        (void)CountPeerRejection(networkId);
+        return errCode;
+    }
+    errCode = CheckRemotePermission(&permissionCheckInfo);
     if (errCode != DMS_EC_SUCCESS) {
         HILOGE("[Remote permission check failed]");
+        AddDmsStat(DMS_STAT_PERMISSION_DENIALS, 1);
+        if (hasPeer) {
+            RecordRemoteDenial(networkId, &permissionCheckInfo, errCode);
+            (void)CountPeerRejection(networkId);
+        }
         return errCode;
     }
-    return StartAbilityFromRemote(calleeBundleName, calleeAbilityName, onStartAbilityDone);
+    if (hasPeer) {
+        (void)SetPeerLastBundle(networkId, calleeBundleName);
+    }
+    return StartAbilityFromRemote(calleeBundleName, calleeAbilityName, sessionId, onStartAbilityDone);
 }
 
-int32_t ReplyMsgHandler(const TlvNode *tlvHead)
+int32_t ReplyMsgHandler(const TlvNode *tlvHead, int32_t sessionId)
 {
     int32_t ret = UnMarshallInt32(tlvHead, REPLY_ERR_CODE);
-    HILOGD("[ReplyMsgHandler ret = %d]", ret);
-    InvokeCallback(NULL, ret);
-    CloseDMSSession();
+    RecordDmsEvent(DMS_EVENT_REPLY, sessionId, ret);
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    if (ret == DMS_EC_OVERLOADED && GetSessionPeerId(sessionId, networkId, NETWORK_ID_BUF_LEN) == EC_SUCCESS) {
+        (void)SetPeerBackoff(networkId, UnMarshallUint32(tlvHead, RETRY_AFTER));
+    }
+    if (!HandleFlowReply(sessionId, ret)) {
+        HILOGW("[ReplyMsgHandler no flow waits on the session]");
+    }
     return ret;
+}
+
+int32_t CapabilityMsgHandler(const TlvNode *tlvHead, int32_t sessionId, uint16_t commandId)
+{
+    DmsPeerCapability capability = {
+        .version = UnMarshallUint16(tlvHead, DMS_VERSION),
+        .maxFrameSize = UnMarshallUint16(tlvHead, MAX_FRAME_SIZE),
+        .features = UnMarshallUint32(tlvHead, FEATURE_FLAGS),
+        .state = CAPABILITY_KNOWN
+    };
+    HILOGD("[CapabilityMsgHandler version = %hu, maxFrameSize = %hu]", capability.version, capability.maxFrameSize);
+    if (capability.version == 0 || capability.maxFrameSize == 0) {
+        return DMS_EC_PARSE_TLV_FAILURE;
+    }
+    return HandlePeerCapability(sessionId, &capability, commandId == DMS_MSG_CMD_CAPABILITY_REQUEST);
 }
\ No newline at end of file
@@ -106,6 +106,26 @@ bool MarshallInt64(int64_t field, FieldType fieldType)
     return MarshallInt(field, fieldType, sizeof(int64_t));
 }
 
+bool PrependFrameHeader(uint16_t commandId, uint32_t requestId)
+{
+    if (g_counter + DMS_FRAME_HEADER_LEN > PACKET_DATA_SIZE) {
+        HILOGE("PrependFrameHeader frame is too big to fit");
+        return false;
+    }
+    if (memmove_s(g_buffer + DMS_FRAME_HEADER_LEN, PACKET_DATA_SIZE - DMS_FRAME_HEADER_LEN,
+        g_buffer, g_counter) != EOK) {
+        return false;
+    }
+    DmsFrameHeader header = {
+        .commandId = commandId,
+        .bodyLength = g_counter,
+        .requestId = requestId
+    };
+    (void)WriteFrameHeader(&header, (uint8_t *)g_buffer, DMS_FRAME_HEADER_LEN);
+    g_counter += DMS_FRAME_HEADER_LEN;
+    return true;
+}
+
 uint16_t GetPacketSize()
 {
     return g_counter;
@@ -19,8 +19,10 @@
 #include <unistd.h>
 
 #include "dmsfwk_interface.h"
+#include "dmslite_event.h"
 #include "dmslite_log.h"
 #include "dmslite_msg_handler.h"
+#include "dmslite_stats.h"
 #include "dmslite_tlv_common.h"
 #include "securec.h"
 
@@ -58,7 +60,6 @@ static TlvErrorCode TlvBytesToLength(const uint8_t *bytesBuffer, uint16_t bufLen
         TlvByteToLength(bytesBuffer[i], &len);
         bytesNum++;
         if (IsNextTlvLength(bytesBuffer[i])) {
-            HILOGD("[bytesNum = %hhu, byte = %x]", bytesNum, bytesBuffer[i]);
             break;
         }
         if (bytesNum >= TLV_MAX_LENGTH_BYTES) {
@@ -78,7 +79,7 @@ static TlvErrorCode TlvBytesToLength(const uint8_t *bytesBuffer, uint16_t bufLen
 }
 
 static TlvErrorCode TlvFillNode(const uint8_t *byteBuffer, uint16_t bufLength,
-    TlvNode *node, uint16_t *actualHandledLen)
+    uint8_t *type, uint16_t *length, uint16_t *actualHandledLen)
 {
     if (bufLength <= TLV_TYPE_LEN) {
         HILOGE("[Bad bufLength %hu]", bufLength);
@@ -86,24 +87,21 @@ static TlvErrorCode TlvFillNode(const uint8_t *byteBuffer, uint16_t bufLength,
     }
 
     /* fill TLV's T(type) */
-    node->type = *byteBuffer;
+    *type = *byteBuffer;
     uint16_t curTlvNodeLen = TLV_TYPE_LEN;
 
     /* fill TLV's L(length) */
-    uint16_t length = 0;
     uint8_t bytesNum = 0;
     const uint8_t *lengthPartAddr = byteBuffer + curTlvNodeLen;
     TlvErrorCode errCode = TlvBytesToLength(lengthPartAddr, bufLength - curTlvNodeLen,
-        &length, &bytesNum);
+        length, &bytesNum);
     if (errCode != DMS_TLV_SUCCESS) {
         return DMS_TLV_ERR_LEN;
     }
-    node->length = length;
     curTlvNodeLen += bytesNum;
 
-    /* fill TLV's V(value) */
-    node->value = byteBuffer + curTlvNodeLen;
-    curTlvNodeLen += length;
+    /* V(value) starts right after, only its bounds are checked */
+    curTlvNodeLen += *length;
     if (curTlvNodeLen > bufLength) {
         return DMS_TLV_ERR_LEN;
     } else {
@@ -113,56 +111,35 @@ static TlvErrorCode TlvFillNode(const uint8_t *byteBuffer, uint16_t bufLength,
     return DMS_TLV_SUCCESS;
 }
 
-static void TlvFreeNodeList(TlvNode *node)
+static inline TlvErrorCode CheckNodeSequence(const TlvNode *tlv, uint8_t curType)
 {
-    TlvNode *next = NULL;
-    while (node != NULL) {
-        next = node->next;
-        free(node);
-        node = next;
-    }
-}
-
-static inline TlvNode* MallocTlvNode()
-{
-    TlvNode *node = (TlvNode *)malloc(sizeof(TlvNode));
-    if (node == NULL) {
-        HILOGE("[Out of memory]");
-        return NULL;
-    }
-    /* won't fail */
-    (void) memset_s(node, sizeof(TlvNode), 0x00, sizeof(TlvNode));
-
-    return node;
-}
-
-static inline TlvErrorCode CheckNodeSequence(const TlvNode *lastNode, const TlvNode *curNode)
-{
-    if (lastNode == curNode) {
+    if (tlv->num == 0) {
         return DMS_TLV_SUCCESS;
     }
-    if (lastNode->type >= curNode->type) {
+    uint8_t lastType = tlv->types[tlv->num - 1];
+    if (lastType >= curType) {
         HILOGE("[Bad node type sequence '%hhu' is expected but '%hhu' appears]",
-            lastNode->type, curNode->type);
+            lastType, curType);
         return DMS_TLV_ERR_OUT_OF_ORDER;
     }
 
     return DMS_TLV_SUCCESS;
 }
 
-static inline TlvErrorCode MoveToNextTlvNode(TlvNode **curNode)
+static inline TlvErrorCode AppendTlvNode(TlvNode *tlv, uint8_t type, uint16_t offset, uint16_t length)
 {
-    TlvNode *next = MallocTlvNode();
-    if (next == NULL) {
-        return DMS_TLV_ERR_NO_MEM;
+    if (tlv->num >= MAX_TLV_NODE_NUM) {
+        HILOGE("[More than %d nodes]", MAX_TLV_NODE_NUM);
+        return DMS_TLV_ERR_BAD_NODE_NUM;
     }
-
-    (*curNode)->next = next;
-    *curNode = next;
+    tlv->types[tlv->num] = type;
+    tlv->offsets[tlv->num] = offset;
+    tlv->lengths[tlv->num] = length;
+    tlv->num++;
     return DMS_TLV_SUCCESS;
 }
 
-TlvErrorCode TlvBytesToNode(const uint8_t *byteBuffer, uint16_t bufLength, TlvNode **tlv)
+static TlvErrorCode TlvBytesToNode(const uint8_t *byteBuffer, uint16_t bufLength, TlvNode *tlv)
 {
     if ((tlv == NULL) || (byteBuffer == NULL)) {
         HILOGE("[Bad parameter]");
@@ -174,72 +151,86 @@ TlvErrorCode TlvBytesToNode(const uint8_t *byteBuffer, uint16_t bufLength, TlvNo
         return DMS_TLV_ERR_LEN;
     }
 
-    TlvNode *head = MallocTlvNode();
-    if (head == NULL) {
-        return DMS_TLV_ERR_NO_MEM;
-    }
-    TlvNode *curNode = head;
-    TlvNode *lastNode = curNode;
+    tlv->buffer = byteBuffer;
+    tlv->num = 0;
 
     /* translate bytes to tlv node until the end of buffer */
-    uint16_t remainingLen = bufLength;
-    uint8_t handledNodeNum = 0;
-    const uint8_t *nodeStartAddr = byteBuffer;
+    uint16_t nodeOffset = 0;
     TlvErrorCode errCode = DMS_TLV_SUCCESS;
-    while (true) {
+    while (nodeOffset < bufLength) {
+        uint8_t type = 0;
+        uint16_t length = 0;
         uint16_t curTlvNodeLen = 0;
-        errCode = TlvFillNode(nodeStartAddr, remainingLen, curNode, &curTlvNodeLen);
+        errCode = TlvFillNode(byteBuffer + nodeOffset, bufLength - nodeOffset, &type, &length, &curTlvNodeLen);
         BREAK_IF_FAILURE(errCode);
 
-        /* check whether there is need to continue processing the remaining nodes */
-        handledNodeNum++;
-
         /* check node type sequence: the type of node must appear in strictly increasing order */
-        errCode = CheckNodeSequence(lastNode, curNode);
+        errCode = CheckNodeSequence(tlv, type);
         BREAK_IF_FAILURE(errCode);
+        RecordDmsEvent(DMS_EVENT_TLV_NODE, type, length);
 
-        remainingLen -= curTlvNodeLen;
-        if (remainingLen == 0) {
-            break;
-        }
+        /* the value follows the type and the length bytes, and ends the node */
+        errCode = AppendTlvNode(tlv, type, nodeOffset + curTlvNodeLen - length, length);
+        BREAK_IF_FAILURE(errCode);
 
-        HILOGD("[curNode length:%hu type:%hhu handledNodeNum:%hhu]", curNode->length,
-            curNode->type, handledNodeNum);
         /* if all is ok, then move to the T part of the next tlv node */
-        nodeStartAddr += curTlvNodeLen;
-        lastNode = curNode;
-        errCode = MoveToNextTlvNode(&curNode);
-        BREAK_IF_FAILURE(errCode);
+        nodeOffset += curTlvNodeLen;
     }
 
-    if (errCode == DMS_TLV_SUCCESS && handledNodeNum < MIN_VALID_NODES) {
+    if (errCode == DMS_TLV_SUCCESS && tlv->num < MIN_VALID_NODES) {
         HILOGE("[Parse done, but node num is invalid]");
         errCode = DMS_TLV_ERR_BAD_NODE_NUM;
     }
 
     if (errCode != DMS_TLV_SUCCESS) {
-        TlvFreeNodeList(head);
-        head = NULL;
+        tlv->num = 0;
     }
-    *tlv = head;
 
     return errCode;
 }
 
-static int32_t Parse(const uint8_t *payload, uint16_t length, TlvNode **head)
+static int32_t Parse(const uint8_t *payload, uint16_t length, TlvNode *tlv)
 {
     if (length > MAX_DMS_MSG_LENGTH) {
         HILOGE("[Bad parameters][length = %hu]", length);
+        CountParseError(DMS_TLV_ERR_PARAM);
         return DMS_TLV_ERR_PARAM;
     }
 
-    TlvNode *tlvHead = NULL;
-    TlvErrorCode errCode = TlvBytesToNode(payload, length, &tlvHead);
-    *head = tlvHead;
-    HILOGI("[errCode = %d]", errCode);
+    TlvErrorCode errCode = TlvBytesToNode(payload, length, tlv);
+    RecordDmsEvent(DMS_EVENT_PARSE_DONE, errCode, length);
+    if (errCode != DMS_TLV_SUCCESS) {
+        CountParseError(errCode);
+    }
     return errCode;
 }
 
+/* a frame with the fixed header is refused on its header alone, only the body behind it is parsed */
+static int32_t ParseFrame(const uint8_t *frame, uint16_t length, TlvNode *tlv)
+{
+    if (!HasFrameHeader(frame, length)) {
+        return Parse(frame, length, tlv);
+    }
+    DmsFrameHeader header;
+    TlvErrorCode errCode = ReadFrameHeader(frame, length, &header);
+    if (errCode == DMS_TLV_SUCCESS && !IsKnownCommand(header.commandId)) {
+        HILOGW("[Unkonwn command id %hu]", header.commandId);
+        errCode = DMS_TLV_ERR_UNKNOWN_TYPE;
+    }
+    if (errCode != DMS_TLV_SUCCESS) {
+        RecordDmsEvent(DMS_EVENT_PARSE_DONE, errCode, length);
+        CountParseError(errCode);
+        return errCode;
+    }
+    int32_t ret = Parse(frame + DMS_FRAME_HEADER_LEN, header.bodyLength, tlv);
+    if (ret == DMS_TLV_SUCCESS && UnMarshallUint16(tlv, COMMAND_ID) != header.commandId) {
+        HILOGE("[Command id %hu of the header differs from the body]", header.commandId);
+        CountParseError(DMS_TLV_ERR_BAD_HEADER);
+        ret = DMS_TLV_ERR_BAD_HEADER;
+    }
+    return ret;
+}
+
 static bool CanCall()
 {
 #ifndef WEARABLE_PRODUCT
@@ -263,25 +254,36 @@ int32_t ProcessCommuMsg(const CommuMessage *commuMessage, const IDmsFeatureCallb
         return DMS_EC_FAILURE;
     }
 
-    TlvNode *tlvHead = NULL;
-    int32_t errCode = Parse(commuMessage->payload, commuMessage->payloadLength, &tlvHead);
+    /* the nodes only point into the payload, which outlives them */
+    TlvNode tlv;
+    int32_t errCode = ParseFrame(commuMessage->payload, commuMessage->payloadLength, &tlv);
+    const TlvNode *tlvHead = (errCode == DMS_TLV_SUCCESS) ? &tlv : NULL;
     /* mainly for xts testsuit convenient, in non-test mode the onTlvParseDone should be set NULL */
     if (dmsFeatureCallback->onTlvParseDone != NULL) {
         dmsFeatureCallback->onTlvParseDone(errCode, tlvHead);
     }
+    if (errCode == DMS_TLV_ERR_UNKNOWN_TYPE) {
+        return DMS_EC_UNKNOWN_COMMAND_ID;
+    }
     if (errCode != DMS_TLV_SUCCESS) {
         return DMS_EC_PARSE_TLV_FAILURE;
     }
 
     uint16_t commandId = UnMarshallUint16(tlvHead, COMMAND_ID);
-    HILOGI("[ProcessCommuMsg commandId %hu]", commandId);
+    RecordDmsEvent(DMS_EVENT_COMMAND, commandId, commuMessage->sessionId);
     switch (commandId) {
         case DMS_MSG_CMD_START_FA: {
-            errCode = StartAbilityFromRemoteHandler(tlvHead, dmsFeatureCallback->onStartAbilityDone);
+            errCode = StartAbilityFromRemoteHandler(tlvHead, commuMessage->sessionId,
+                dmsFeatureCallback->onStartAbilityDone);
+            break;
+        }
+        case DMS_MSG_CMD_CAPABILITY_REQUEST:
+        case DMS_MSG_CMD_CAPABILITY_RESPONSE: {
+            errCode = CapabilityMsgHandler(tlvHead, commuMessage->sessionId, commandId);
             break;
         }
         case DMS_MSG_CMD_REPLY: {
-            errCode = ReplyMsgHandler(tlvHead);
+            errCode = ReplyMsgHandler(tlvHead, commuMessage->sessionId);
             break;
         }
         default: {
@@ -290,6 +292,5 @@ int32_t ProcessCommuMsg(const CommuMessage *commuMessage, const IDmsFeatureCallb
             break;
         }
     }
-    TlvFreeNodeList(tlvHead);
     return errCode;
 }
\ No newline at end of file
@@ -15,101 +15,172 @@
 
 #include "dmslite_permission.h"
 
+#include <dirent.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
-#ifdef WEARABLE_PRODUCT
 #include "bundle_manager.h"
-#else
-#include "bundle_inner_interface.h"
-#include "bundle_manager.h"
-#endif
+#include "dmslite_bms.h"
 #include "dmslite_log.h"
+#include "dmslite_tlv_common.h"
 #include "dmslite_utils.h"
-#include "samgr_lite.h"
+#include "mbedtls/sha256.h"
+#include "ohos_errno.h"
 #include "securec.h"
 
 #define DELIMITER_LENGTH 1
-#define GET_BUNDLE_WITHOUT_ABILITIES 0
+#define ENDING_SYMBOL_LEN 1
 #ifndef WEARABLE_PRODUCT
 #define NATIVE_APPID_DIR "/system/native_appid/"
 #define APPID_FILE_PREFIX "uid_"
 #define APPID_FILE_SUFFIX "_appid"
 #define MAX_FILE_PATH_LEN 64
 #define MAX_NATIVE_SERVICE_UID 99
+#define NATIVE_APPID_CHECK_INTERVAL 60
+#define DECIMAL_BASE 10
+#define INVALID_OFFSET (-1)
 #endif
+#define CALLER_CACHE_SIZE 8
+#define CALLEE_CACHE_SIZE 4
+#define PERMISSION_CACHE_TTL 600
+#define DENIAL_CACHE_SIZE 16
+#define DENIAL_CACHE_TTL 30
+#define DENIAL_KEY_OFFSET_BASIS 14695981039346656037ULL
+#define DENIAL_KEY_PRIME 1099511628211ULL
+#define ANY_UID (-1)
+
+typedef struct {
+    int32_t uid;
+    uint32_t generation;
+    uint32_t lastUsed;
+    time_t updateTime;
+    char *bundleName;
+    char *appId;
+    /* sha256 of the signature, computed once when the entry is filled */
+    uint8_t digest[SIGNATURE_DIGEST_LEN];
+} PermissionCacheEntry;
+
+typedef int32_t (*FetchBundleInfo)(int32_t uid, const char *bundleName, BundleInfo *bundleInfo);
+typedef const char *(*SignatureOf)(const PermissionCacheEntry *entry);
+
+typedef struct {
+    PermissionCacheEntry *entries;
+    uint8_t size;
+    uint32_t tick;
+    FetchBundleInfo fetch;
+    SignatureOf signatureOf;
+    DmsCacheStats stats;
+} PermissionCache;
+
+static int32_t FetchCallerBundleInfo(int32_t uid, const char *bundleName, BundleInfo *bundleInfo);
+static int32_t FetchCalleeBundleInfo(int32_t uid, const char *bundleName, BundleInfo *bundleInfo);
+static const char *CallerSignatureOf(const PermissionCacheEntry *entry);
+static const char *CalleeSignatureOf(const PermissionCacheEntry *entry);
+
+static PermissionCacheEntry g_callerEntries[CALLER_CACHE_SIZE];
+static PermissionCacheEntry g_calleeEntries[CALLEE_CACHE_SIZE];
+/* caller side: (uid, bundleName) -> appId of the local caller */
+static PermissionCache g_callerCache = {
+    g_callerEntries, CALLER_CACHE_SIZE, 0, FetchCallerBundleInfo, CallerSignatureOf, {0}
+};
+/* callee side: bundleName -> appId of the local callee, whose signature remote callers are checked against */
+static PermissionCache g_calleeCache = {
+    g_calleeEntries, CALLEE_CACHE_SIZE, 0, FetchCalleeBundleInfo, CalleeSignatureOf, {0}
+};
+/* bumped from the bms callback thread whenever any bundle is installed, updated or uninstalled */
+static atomic_uint g_bundleGeneration = 0;
+static atomic_uint g_prefetchGeneration = 0;
+/* the callee cache is checked on the start lane and scanned for prefetching on the dms task */
+static pthread_mutex_t g_calleeLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* a refused (peer, callee, signature), the key is a 64-bit fnv-1a hash of the three */
+typedef struct {
+    uint64_t key;
+    int32_t errCode;
+    uint32_t generation;
+    time_t expireTime;
+} DenialEntry;
+
+/* direct mapped by the key, a colliding denial simply replaces the older one */
+static DenialEntry g_denials[DENIAL_CACHE_SIZE];
+
+static int32_t LookupPermissionCache(PermissionCache *cache, int32_t uid, const char *bundleName,
+    const PermissionCacheEntry **result);
+static void OnBundleStateChanged(const uint8_t installType, const uint8_t resultCode,
+    const void *resultMessage, const char *bundleName, void *data);
+
+static BundleStatusCallback g_bundleStatusCallback = {
+    .callBack = OnBundleStateChanged,
+    .bundleName = NULL,
+    .data = NULL
+};
 
 #ifndef WEARABLE_PRODUCT
-static bool GetBmsInterface(struct BmsServerProxy **bmsInterface)
+/* every native appId file loaded into one blob, indexed by uid */
+typedef struct {
+    char *blob;
+    int32_t offsets[MAX_NATIVE_SERVICE_UID + 1];
+    struct timespec dirMtime;
+    time_t checkTime;
+    uint32_t generation;
+    bool loaded;
+} NativeAppIdIndex;
+
+static NativeAppIdIndex g_nativeAppIds = { 0 };
+#endif
+
+static int32_t GetCalleeBundleInfo(const char *calleeBundleName, BundleInfo *bundleInfo)
 {
-    IUnknown *iUnknown = SAMGR_GetInstance()->GetFeatureApi(BMS_SERVICE, BMS_FEATURE);
-    if (iUnknown == NULL) {
-        HILOGE("[GetFeatureApi failed]");
-        return false;
+    int32_t errCode = DmsGetBundleInfo(calleeBundleName, GET_BUNDLE_WITHOUT_ABILITIES, bundleInfo);
+    if (errCode != DMS_EC_SUCCESS) {
+        HILOGE("[GetBundleInfo errCode = %d]", errCode);
     }
+    return errCode;
+}
 
-    int32_t errCode = iUnknown->QueryInterface(iUnknown, DEFAULT_VERSION, (void **) bmsInterface);
-    if (errCode != EC_SUCCESS) {
-        HILOGE("[QueryInterface failed]");
-        return false;
+/* constant time, so the comparison leaks nothing about where the digests differ */
+static bool IsSameDigest(const uint8_t *digest, const uint8_t *other)
+{
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < SIGNATURE_DIGEST_LEN; i++) {
+        diff |= digest[i] ^ other[i];
     }
-
-    return true;
+    return diff == 0;
 }
-#endif
 
 int32_t CheckRemotePermission(const PermissionCheckInfo *permissionCheckInfo)
 {
-    if (permissionCheckInfo == NULL) {
+    if (permissionCheckInfo == NULL || permissionCheckInfo->calleeBundleName == NULL) {
         return DMS_EC_FAILURE;
     }
-
-    BundleInfo bundleInfo;
-    if (memset_s(&bundleInfo, sizeof(BundleInfo), 0x00, sizeof(BundleInfo)) != EOK) {
-        HILOGE("[bundleInfo memset failed]");
+    if (permissionCheckInfo->callerSignature == NULL && permissionCheckInfo->callerDigest == NULL) {
+        HILOGE("[Signature is null]");
         return DMS_EC_FAILURE;
     }
 
-    int32_t errCode;
-#ifndef WEARABLE_PRODUCT
-    uid_t callerUid = getuid();
-    if (callerUid == FOUNDATION_UID) {
-        /* inner-process mode */
-        struct BmsServerProxy *bmsInterface = NULL;
-        if (!GetBmsInterface(&bmsInterface)) {
-            HILOGE("[GetBmsInterface query null]");
-            return DMS_EC_GET_BMS_FAILURE;
-        }
-        errCode = bmsInterface->GetBundleInfo(permissionCheckInfo->calleeBundleName,
-            GET_BUNDLE_WITHOUT_ABILITIES, &bundleInfo);
-    } else if (callerUid == SHELL_UID) {
-        /* inter-process mode (mainly called in xts testsuit process started by shell) */
-        errCode = GetBundleInfo(permissionCheckInfo->calleeBundleName,
-            GET_BUNDLE_WITHOUT_ABILITIES, &bundleInfo);
-    } else {
-        errCode = EC_FAILURE;
-    }
-#else
-    errCode = GetBundleInfo(permissionCheckInfo->calleeBundleName,
-        GET_BUNDLE_WITHOUT_ABILITIES, &bundleInfo);
-#endif
-    if (errCode != EC_SUCCESS) {
-        HILOGE("[GetBundleInfo errCode = %d]", errCode);
-        return DMS_EC_GET_BUNDLEINFO_FAILURE;
+    pthread_mutex_lock(&g_calleeLock);
+    const PermissionCacheEntry *callee = NULL;
+    int32_t errCode = LookupPermissionCache(&g_calleeCache, ANY_UID, permissionCheckInfo->calleeBundleName, &callee);
+    if (errCode != DMS_EC_SUCCESS) {
+        pthread_mutex_unlock(&g_calleeLock);
+        return errCode;
     }
 
-    /* appId: bundleName + "_" + signature */
-    const char *calleeSignature = bundleInfo.appId + strlen(permissionCheckInfo->calleeBundleName)
-        + DELIMITER_LENGTH;
-    ClearBundleInfo(&bundleInfo);
-    if ((permissionCheckInfo->callerSignature == NULL) || (calleeSignature == NULL)) {
-        HILOGE("[Signature is null]");
-        return DMS_EC_FAILURE;
+    bool matched;
+    if (permissionCheckInfo->callerDigest != NULL) {
+        matched = IsSameDigest(permissionCheckInfo->callerDigest, callee->digest);
+    } else {
+        matched = (strcmp(permissionCheckInfo->callerSignature, CalleeSignatureOf(callee)) == 0);
     }
-
-    if (strcmp(permissionCheckInfo->callerSignature, calleeSignature) != 0) {
+    pthread_mutex_unlock(&g_calleeLock);
+    if (!matched) {
         HILOGE("[Signature unmatched]");
         return DMS_EC_CHECK_PERMISSION_FAILURE;
     }
@@ -117,39 +188,54 @@ int32_t CheckRemotePermission(const PermissionCheckInfo *permissionCheckInfo)
     return DMS_EC_SUCCESS;
 }
 
-static int32_t GetBundleInfoFromFile(const char *filePath, BundleInfo *bundleInfo)
+#ifndef WEARABLE_PRODUCT
+static int32_t GetNativeAppIdPath(int32_t uid, char *filePath)
 {
-    int32_t fd = open(filePath, O_RDONLY, S_IRUSR);
-    if (fd < 0) {
-        HILOGE("[open file failed]");
-        return DMS_EC_FAILURE;
+    return sprintf_s(filePath, MAX_FILE_PATH_LEN, "%s%s%d%s", NATIVE_APPID_DIR, APPID_FILE_PREFIX,
+        uid, APPID_FILE_SUFFIX);
+}
+
+/* file names look like uid_7_appid */
+static int32_t ParseNativeUid(const char *fileName)
+{
+    size_t prefixLen = strlen(APPID_FILE_PREFIX);
+    if (strncmp(fileName, APPID_FILE_PREFIX, prefixLen) != 0) {
+        return INVALID_OFFSET;
     }
-    int32_t fileLen = lseek(fd, 0, SEEK_END);
-    if (fileLen <= 0) {
-        HILOGE("[fileLen is invalid, fileLen=%d]", fileLen);
-        close(fd);
-        return DMS_EC_FAILURE;
+    char *end = NULL;
+    long uid = strtol(fileName + prefixLen, &end, DECIMAL_BASE);
+    if (end == fileName + prefixLen || strcmp(end, APPID_FILE_SUFFIX) != 0
+        || uid < 0 || uid > MAX_NATIVE_SERVICE_UID) {
+        return INVALID_OFFSET;
     }
-    int32_t ret = lseek(fd, 0, SEEK_SET);
-    if (ret < 0) {
-        HILOGE("[lseek failed, ret=%d]", ret);
-        close(fd);
-        return DMS_EC_FAILURE;
+    return (int32_t)uid;
+}
+
+static bool GetNativeDirMtime(struct timespec *mtime)
+{
+    struct stat dirStat;
+    if (stat(NATIVE_APPID_DIR, &dirStat) != 0) {
+        return false;
     }
-    int32_t appIdLen = fileLen + 1;
-    char *appId = (char *)DMS_ALLOC(appIdLen);
-    if (appId == NULL) {
-        HILOGE("[DMS_ALLOC appId failed]");
-        close(fd);
-        return DMS_EC_FAILURE;
+    *mtime = dirStat.st_mtim;
+    return true;
+}
+
+static int32_t ReadAppIdFile(int32_t uid, char *appId, uint32_t size)
+{
+    char filePath[MAX_FILE_PATH_LEN] = {0};
+    if (GetNativeAppIdPath(uid, filePath) < 0) {
+        return INVALID_OFFSET;
     }
-    (void)memset_s(appId, appIdLen, 0x00, appIdLen);
-    ret = read(fd, appId, fileLen);
-    if (ret < 0) {
-        HILOGE("[read appId failed, ret=%d]", ret);
-        DMS_FREE(appId);
-        close(fd);
-        return DMS_EC_FAILURE;
+    int32_t fd = open(filePath, O_RDONLY, S_IRUSR);
+    if (fd < 0) {
+        return INVALID_OFFSET;
+    }
+    ssize_t fileLen = read(fd, appId, size);
+    close(fd);
+    if (fileLen <= 0) {
+        HILOGE("[read appId failed, uid = %d]", uid);
+        return INVALID_OFFSET;
     }
     for (; fileLen > 0; --fileLen) {
         if (appId[fileLen - 1] != '\n') {
@@ -157,48 +243,142 @@ static int32_t GetBundleInfoFromFile(const char *filePath, BundleInfo *bundleInf
         }
     }
     appId[fileLen] = '\0';
+    return (int32_t)fileLen;
+}
+
+static uint32_t CollectNativeAppIdSizes(uint32_t *sizes)
+{
+    DIR *dir = opendir(NATIVE_APPID_DIR);
+    if (dir == NULL) {
+        return 0;
+    }
+    uint32_t totalSize = 0;
+    struct dirent *entry = NULL;
+    while ((entry = readdir(dir)) != NULL) {
+        int32_t uid = ParseNativeUid(entry->d_name);
+        struct stat fileStat;
+        if (uid == INVALID_OFFSET || fstatat(dirfd(dir), entry->d_name, &fileStat, 0) != 0
+            || fileStat.st_size <= 0) {
+            continue;
+        }
+        sizes[uid] = (uint32_t)fileStat.st_size;
+        totalSize += sizes[uid] + ENDING_SYMBOL_LEN;
+    }
+    closedir(dir);
+    return totalSize;
+}
+
+static void BuildNativeAppIdIndex(uint32_t generation)
+{
+    NativeAppIdIndex *index = &g_nativeAppIds;
+    DMS_FREE(index->blob);
+    for (int32_t uid = 0; uid <= MAX_NATIVE_SERVICE_UID; uid++) {
+        index->offsets[uid] = INVALID_OFFSET;
+    }
+    index->loaded = true;
+    index->generation = generation;
+    index->checkTime = time(NULL);
+    if (!GetNativeDirMtime(&index->dirMtime)) {
+        return;
+    }
+
+    uint32_t sizes[MAX_NATIVE_SERVICE_UID + 1] = {0};
+    uint32_t totalSize = CollectNativeAppIdSizes(sizes);
+    if (totalSize == 0) {
+        return;
+    }
+    index->blob = (char *)DMS_ALLOC(totalSize);
+    if (index->blob == NULL) {
+        HILOGE("[DMS_ALLOC native appId index failed]");
+        return;
+    }
+    uint32_t offset = 0;
+    for (int32_t uid = 0; uid <= MAX_NATIVE_SERVICE_UID; uid++) {
+        if (sizes[uid] == 0 || offset + sizes[uid] + ENDING_SYMBOL_LEN > totalSize) {
+            continue;
+        }
+        int32_t len = ReadAppIdFile(uid, index->blob + offset, sizes[uid]);
+        if (len < 0) {
+            continue;
+        }
+        index->offsets[uid] = (int32_t)offset;
+        offset += (uint32_t)len + ENDING_SYMBOL_LEN;
+    }
+}
+
+static bool IsNativeDirChanged()
+{
+    struct timespec mtime;
+    if (!GetNativeDirMtime(&mtime)) {
+        return g_nativeAppIds.blob != NULL;
+    }
+    return mtime.tv_sec != g_nativeAppIds.dirMtime.tv_sec || mtime.tv_nsec != g_nativeAppIds.dirMtime.tv_nsec;
+}
+
+/* returns a pointer into the index, which stays valid until the index is rebuilt */
+static const char *LookupNativeAppId(int32_t uid)
+{
+    NativeAppIdIndex *index = &g_nativeAppIds;
+    uint32_t generation = atomic_load_explicit(&g_bundleGeneration, memory_order_acquire);
+    time_t now = time(NULL);
+    if (!index->loaded || index->generation != generation) {
+        BuildNativeAppIdIndex(generation);
+    } else if (index->offsets[uid] == INVALID_OFFSET
+        || difftime(now, index->checkTime) >= NATIVE_APPID_CHECK_INTERVAL) {
+        /* a single stat tells whether files were added or removed since the index was built */
+        index->checkTime = now;
+        if (IsNativeDirChanged()) {
+            BuildNativeAppIdIndex(generation);
+        }
+    }
+    return (index->offsets[uid] == INVALID_OFFSET) ? NULL : index->blob + index->offsets[uid];
+}
+
+static int32_t GetBundleInfoFromIndex(int32_t uid, BundleInfo *bundleInfo)
+{
+    const char *nativeAppId = LookupNativeAppId(uid);
+    if (nativeAppId == NULL) {
+        HILOGE("[native appId not found, uid = %d]", uid);
+        return DMS_EC_FAILURE;
+    }
+    uint32_t appIdLen = strlen(nativeAppId) + ENDING_SYMBOL_LEN;
+    /* ClearBundleInfo of the bms may release it */
+    char *appId = (char *)DMS_ALLOC_SHARED(appIdLen);
+    if (appId == NULL || strcpy_s(appId, appIdLen, nativeAppId) != EOK) {
+        HILOGE("[DMS_ALLOC appId failed]");
+        DMS_FREE(appId);
+        return DMS_EC_FAILURE;
+    }
     bundleInfo->appId = appId;
-    close(fd);
     return DMS_EC_SUCCESS;
 }
+#endif
+
+void LoadNativeAppIdIndex()
+{
+#ifndef WEARABLE_PRODUCT
+    BuildNativeAppIdIndex(atomic_load_explicit(&g_bundleGeneration, memory_order_acquire));
+#endif
+}
 
 static int32_t GetBundleInfoFromBms(const CallerInfo *callerInfo, BundleInfo *bundleInfo)
 {
-    int32_t errCode;
 #ifndef WEARABLE_PRODUCT
     char *bundleName = NULL;
-    uid_t callerUid = getuid();
-    if (callerUid == FOUNDATION_UID) {
-        /* inner-process mode */
-        struct BmsServerProxy *bmsServerProxy = NULL;
-        if (!GetBmsInterface(&bmsServerProxy)) {
-            HILOGE("[GetBmsInterface query null]");
-            return DMS_EC_GET_BMS_FAILURE;
-        }
-        if (bmsServerProxy->GetBundleNameForUid(callerInfo->uid, &bundleName) != EC_SUCCESS) {
-            HILOGE("[GetBundleNameForUid failed]");
-            return DMS_EC_FAILURE;
-        }
-        errCode = bmsServerProxy->GetBundleInfo(bundleName, GET_BUNDLE_WITHOUT_ABILITIES, bundleInfo);
-    } else if (callerUid == SHELL_UID) {
-        /* inter-process mode (mainly called in xts testsuit process started by shell) */
-        if (GetBundleNameForUid(callerInfo->uid, &bundleName) != EC_SUCCESS) {
-            HILOGE("[GetBundleNameForUid failed]");
-            return DMS_EC_FAILURE;
-        }
-        errCode = GetBundleInfo(bundleName, GET_BUNDLE_WITHOUT_ABILITIES, bundleInfo);
-    } else {
-        errCode = DMS_EC_FAILURE;
+    int32_t errCode = DmsGetBundleNameForUid(callerInfo->uid, &bundleName);
+    if (errCode != DMS_EC_SUCCESS) {
+        HILOGE("[GetBundleNameForUid failed]");
+        return errCode;
     }
+    errCode = DmsGetBundleInfo(bundleName, GET_BUNDLE_WITHOUT_ABILITIES, bundleInfo);
     DMS_FREE(bundleName);
 #else
-    errCode = GetBundleInfo(callerInfo->bundleName, GET_BUNDLE_WITHOUT_ABILITIES, bundleInfo);
+    int32_t errCode = DmsGetBundleInfo(callerInfo->bundleName, GET_BUNDLE_WITHOUT_ABILITIES, bundleInfo);
 #endif
-    if (errCode != EC_SUCCESS) {
+    if (errCode != DMS_EC_SUCCESS) {
         HILOGE("[GetBundleInfo failed]");
-        return DMS_EC_GET_BUNDLEINFO_FAILURE;
     }
-    return DMS_EC_SUCCESS;
+    return errCode;
 }
 
 int32_t GetCallerBundleInfo(const CallerInfo *callerInfo, BundleInfo *bundleInfo)
@@ -208,17 +388,322 @@ int32_t GetCallerBundleInfo(const CallerInfo *callerInfo, BundleInfo *bundleInfo
         return DMS_EC_INVALID_PARAMETER;
     }
 #ifndef WEARABLE_PRODUCT
-    if (callerInfo->uid <= MAX_NATIVE_SERVICE_UID) {
-        char filePath[MAX_FILE_PATH_LEN] = {0};
-        int32_t ret = sprintf_s(filePath, MAX_FILE_PATH_LEN, "%s%s%d%s", NATIVE_APPID_DIR, APPID_FILE_PREFIX,
-            callerInfo->uid, APPID_FILE_SUFFIX);
-        if (ret < 0) {
-            HILOGE("[filePath sprintf failed]");
-            return DMS_EC_FAILURE;
-        }
+    if (callerInfo->uid >= 0 && callerInfo->uid <= MAX_NATIVE_SERVICE_UID) {
         bundleInfo->uid = callerInfo->uid;
-        return GetBundleInfoFromFile(filePath, bundleInfo);
+        return GetBundleInfoFromIndex(callerInfo->uid, bundleInfo);
     }
 #endif
     return GetBundleInfoFromBms(callerInfo, bundleInfo);
 }
+
+static bool IsSameKey(const PermissionCacheEntry *entry, int32_t uid, const char *bundleName)
+{
+    if (entry->appId == NULL || entry->uid != uid) {
+        return false;
+    }
+    if (entry->bundleName == NULL || bundleName == NULL) {
+        return entry->bundleName == bundleName;
+    }
+    return strcmp(entry->bundleName, bundleName) == 0;
+}
+
+static bool IsEntryValid(const PermissionCacheEntry *entry, uint32_t generation, time_t now)
+{
+    return (entry->generation == generation) && (difftime(now, entry->updateTime) < PERMISSION_CACHE_TTL);
+}
+
+static void ClearCacheEntry(PermissionCacheEntry *entry)
+{
+    DMS_FREE(entry->bundleName);
+    DMS_FREE(entry->appId);
+    (void)memset_s(entry, sizeof(PermissionCacheEntry), 0x00, sizeof(PermissionCacheEntry));
+}
+
+static PermissionCacheEntry *SelectCacheEntry(PermissionCache *cache, int32_t uid, const char *bundleName,
+    uint32_t generation, time_t now)
+{
+    for (uint8_t i = 0; i < cache->size; i++) {
+        if (IsSameKey(&cache->entries[i], uid, bundleName)) {
+            return &cache->entries[i];
+        }
+    }
+    /* prefer an empty slot, then an expired one, then the least recently used one */
+    PermissionCacheEntry *victim = &cache->entries[0];
+    for (uint8_t i = 0; i < cache->size; i++) {
+        PermissionCacheEntry *entry = &cache->entries[i];
+        if (entry->appId == NULL) {
+            return entry;
+        }
+        if (!IsEntryValid(entry, generation, now)) {
+            victim = entry;
+        } else if (IsEntryValid(victim, generation, now) && entry->lastUsed < victim->lastUsed) {
+            victim = entry;
+        }
+    }
+    return victim;
+}
+
+static int32_t FetchCallerBundleInfo(int32_t uid, const char *bundleName, BundleInfo *bundleInfo)
+{
+    CallerInfo callerInfo = {
+        .uid = uid,
+        .bundleName = (char *)bundleName
+    };
+    return GetCallerBundleInfo(&callerInfo, bundleInfo);
+}
+
+static int32_t FetchCalleeBundleInfo(int32_t uid, const char *bundleName, BundleInfo *bundleInfo)
+{
+    /* a prefetch issued under an older generation may carry stale bundle info */
+    if (atomic_load_explicit(&g_prefetchGeneration, memory_order_acquire)
+        == atomic_load_explicit(&g_bundleGeneration, memory_order_acquire)
+        && TakePrefetchedBundleInfo(bundleName, bundleInfo) == DMS_EC_SUCCESS) {
+        return DMS_EC_SUCCESS;
+    }
+    ClearBundleInfo(bundleInfo);
+    return GetCalleeBundleInfo(bundleName, bundleInfo);
+}
+
+static const char *CallerSignatureOf(const PermissionCacheEntry *entry)
+{
+    /* the whole appId of the caller is sent as its signature */
+    return entry->appId;
+}
+
+static const char *CalleeSignatureOf(const PermissionCacheEntry *entry)
+{
+    /* appId: bundleName + "_" + signature */
+    size_t prefixLen = strlen(entry->bundleName) + DELIMITER_LENGTH;
+    if (strlen(entry->appId) <= prefixLen) {
+        return NULL;
+    }
+    return entry->appId + prefixLen;
+}
+
+static int32_t FillCacheEntry(const PermissionCache *cache, PermissionCacheEntry *entry, int32_t uid,
+    const char *bundleName, uint32_t generation)
+{
+    ClearCacheEntry(entry);
+    BundleInfo bundleInfo = {0};
+    int32_t errCode = cache->fetch(uid, bundleName, &bundleInfo);
+    if (errCode != DMS_EC_SUCCESS || bundleInfo.appId == NULL) {
+        ClearBundleInfo(&bundleInfo);
+        return (errCode != DMS_EC_SUCCESS) ? errCode : DMS_EC_GET_BUNDLEINFO_FAILURE;
+    }
+    if (bundleName != NULL) {
+        uint32_t size = strlen(bundleName) + ENDING_SYMBOL_LEN;
+        entry->bundleName = (char *)DMS_ALLOC(size);
+        if (entry->bundleName == NULL || strcpy_s(entry->bundleName, size, bundleName) != EOK) {
+            HILOGE("[cache bundleName failed]");
+            ClearCacheEntry(entry);
+            ClearBundleInfo(&bundleInfo);
+            return DMS_EC_FAILURE;
+        }
+    }
+    /* take over the appId instead of copying it */
+    entry->appId = bundleInfo.appId;
+    bundleInfo.appId = NULL;
+    ClearBundleInfo(&bundleInfo);
+    const char *signature = cache->signatureOf(entry);
+    if (signature == NULL) {
+        HILOGE("[Bad appId]");
+        ClearCacheEntry(entry);
+        return DMS_EC_FAILURE;
+    }
+    if (mbedtls_sha256_ret((const unsigned char *)signature, strlen(signature), entry->digest, 0) != 0) {
+        HILOGE("[digest signature failed]");
+        ClearCacheEntry(entry);
+        return DMS_EC_FAILURE;
+    }
+    entry->uid = uid;
+    entry->generation = generation;
+    entry->updateTime = time(NULL);
+    return DMS_EC_SUCCESS;
+}
+
+static int32_t LookupPermissionCache(PermissionCache *cache, int32_t uid, const char *bundleName,
+    const PermissionCacheEntry **result)
+{
+    uint32_t generation = atomic_load_explicit(&g_bundleGeneration, memory_order_acquire);
+    time_t now = time(NULL);
+    PermissionCacheEntry *entry = SelectCacheEntry(cache, uid, bundleName, generation, now);
+    if (IsSameKey(entry, uid, bundleName) && IsEntryValid(entry, generation, now)) {
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+        int32_t errCode = FillCacheEntry(cache, entry, uid, bundleName, generation);
+        if (errCode != DMS_EC_SUCCESS) {
+            return errCode;
+        }
+    }
+    entry->lastUsed = ++cache->tick;
+    *result = entry;
+    return DMS_EC_SUCCESS;
+}
+
+int32_t GetCallerAppId(const CallerInfo *callerInfo, const char **appId)
+{
+    return GetCallerAppIdDigest(callerInfo, appId, NULL);
+}
+
+int32_t GetCallerAppIdDigest(const CallerInfo *callerInfo, const char **appId, const uint8_t **digest)
+{
+    if ((callerInfo == NULL) || (appId == NULL)) {
+        HILOGE("[invalid parameter]");
+        return DMS_EC_INVALID_PARAMETER;
+    }
+    const PermissionCacheEntry *entry = NULL;
+    int32_t errCode = LookupPermissionCache(&g_callerCache, callerInfo->uid, callerInfo->bundleName, &entry);
+    if (errCode != DMS_EC_SUCCESS) {
+        return errCode;
+    }
+    *appId = entry->appId;
+    if (digest != NULL) {
+        *digest = entry->digest;
+    }
+    return DMS_EC_SUCCESS;
+}
+
+void GetCallerCacheStats(DmsCacheStats *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    *stats = g_callerCache.stats;
+}
+
+void GetCalleeCacheStats(DmsCacheStats *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&g_calleeLock);
+    *stats = g_calleeCache.stats;
+    pthread_mutex_unlock(&g_calleeLock);
+}
+
+void PrefetchCalleeBundleInfo(const char *calleeBundleName)
+{
+    if (calleeBundleName == NULL) {
+        return;
+    }
+    /* a check holding the cache is fetching the bundle info already, the dms task must not wait for it */
+    if (pthread_mutex_trylock(&g_calleeLock) != 0) {
+        return;
+    }
+    uint32_t generation = atomic_load_explicit(&g_bundleGeneration, memory_order_acquire);
+    time_t now = time(NULL);
+    bool cached = false;
+    for (uint8_t i = 0; i < g_calleeCache.size && !cached; i++) {
+        const PermissionCacheEntry *entry = &g_calleeCache.entries[i];
+        cached = IsSameKey(entry, ANY_UID, calleeBundleName) && IsEntryValid(entry, generation, now);
+    }
+    pthread_mutex_unlock(&g_calleeLock);
+    if (!cached && PrefetchBundleInfo(calleeBundleName) == EC_SUCCESS) {
+        atomic_store_explicit(&g_prefetchGeneration, generation, memory_order_release);
+    }
+}
+
+static uint64_t HashDenialKey(uint64_t hash, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= DENIAL_KEY_PRIME;
+    }
+    return hash;
+}
+
+/*
+ * checked before every start request, so a legacy frame is not run through sha256 for its full appId;
+ * a collision can only come from requests of the same peer to the same callee
+ */
+static bool MakeDenialKey(const char *networkId, const PermissionCheckInfo *info, uint64_t *key)
+{
+    if (networkId == NULL || info == NULL || info->calleeBundleName == NULL) {
+        return false;
+    }
+    const uint8_t *signature = info->callerDigest;
+    size_t signatureLen = SIGNATURE_DIGEST_LEN;
+    uint8_t kind = 1;
+    if (signature == NULL) {
+        if (info->callerSignature == NULL) {
+            return false;
+        }
+        signature = (const uint8_t *)info->callerSignature;
+        signatureLen = strlen(info->callerSignature);
+        kind = 0;
+    }
+    /* networkId \0 bundleName \0 kind signature */
+    uint64_t hash = HashDenialKey(DENIAL_KEY_OFFSET_BASIS, (const uint8_t *)networkId,
+        strlen(networkId) + ENDING_SYMBOL_LEN);
+    hash = HashDenialKey(hash, (const uint8_t *)info->calleeBundleName,
+        strlen(info->calleeBundleName) + ENDING_SYMBOL_LEN);
+    hash = HashDenialKey(hash, &kind, sizeof(kind));
+    *key = HashDenialKey(hash, signature, signatureLen);
+    return true;
+}
+
+static DenialEntry *GetDenialSlot(uint64_t key)
+{
+    return &g_denials[key % DENIAL_CACHE_SIZE];
+}
+
+int32_t CheckRemoteDenial(const char *networkId, const PermissionCheckInfo *permissionCheckInfo)
+{
+    uint64_t key = 0;
+    if (!MakeDenialKey(networkId, permissionCheckInfo, &key)) {
+        return DMS_EC_SUCCESS;
+    }
+    const DenialEntry *entry = GetDenialSlot(key);
+    if (entry->expireTime == 0 || entry->key != key) {
+        return DMS_EC_SUCCESS;
+    }
+    /* installing or updating a bundle may turn the refused request into a valid one */
+    if (entry->generation != atomic_load_explicit(&g_bundleGeneration, memory_order_acquire)
+        || difftime(entry->expireTime, time(NULL)) <= 0) {
+        return DMS_EC_SUCCESS;
+    }
+    return entry->errCode;
+}
+
+void RecordRemoteDenial(const char *networkId, const PermissionCheckInfo *permissionCheckInfo, int32_t errCode)
+{
+    /*
+     * only refusals that stay the same until a bundle changes are remembered: a signature mismatch or
+     * a bundle the bms does not know, never a failed bms query
+     */
+    if (errCode != DMS_EC_CHECK_PERMISSION_FAILURE && errCode != DMS_EC_GET_BUNDLEINFO_FAILURE) {
+        return;
+    }
+    uint64_t key = 0;
+    if (!MakeDenialKey(networkId, permissionCheckInfo, &key)) {
+        return;
+    }
+    DenialEntry *entry = GetDenialSlot(key);
+    entry->key = key;
+    entry->errCode = errCode;
+    entry->generation = atomic_load_explicit(&g_bundleGeneration, memory_order_acquire);
+    entry->expireTime = time(NULL) + DENIAL_CACHE_TTL;
+}
+
+void InvalidatePermissionCache()
+{
+    atomic_fetch_add_explicit(&g_bundleGeneration, 1, memory_order_release);
+}
+
+static void OnBundleStateChanged(const uint8_t installType, const uint8_t resultCode,
+    const void *resultMessage, const char *bundleName, void *data)
+{
+    HILOGD("[bundle state changed, installType = %d]", installType);
+    InvalidatePermissionCache();
+}
+
+int32_t AddBundleStatusListener()
+{
+    return RegisterCallback(&g_bundleStatusCallback);
+}
+
+int32_t RemoveBundleStatusListener()
+{
+    return UnregisterCallback();
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#ifdef WEARABLE_PRODUCT
+#include "ohos_mem_pool.h"
+#endif
+
+/* every block size is a multiple of this, so blocks are aligned as malloc aligns */
+#define POOL_ALIGNMENT 16
+
+#define TINY_BLOCK_SIZE 32
+#define TINY_BLOCK_NUM 16
+#define SMALL_BLOCK_SIZE 64
+#define SMALL_BLOCK_NUM 32
+#define MEDIUM_BLOCK_SIZE 128
+#define MEDIUM_BLOCK_NUM 16
+#define LARGE_BLOCK_SIZE 256
+#define LARGE_BLOCK_NUM 8
+#define FRAME_BLOCK_SIZE 1024
+#define FRAME_BLOCK_NUM 4
+
+typedef struct FreeBlock {
+    struct FreeBlock *next;
+} FreeBlock;
+
+typedef struct {
+    uint8_t *base;
+    uint8_t *end;
+    pthread_mutex_t lock;
+    FreeBlock *freeList;
+    /* blocks from here on were never handed out, so the free list needs no setup */
+    uint16_t unused;
+    DmsPoolClassStats stats;
+} PoolClass;
+
+static _Alignas(POOL_ALIGNMENT) uint8_t g_tinyBlocks[TINY_BLOCK_NUM][TINY_BLOCK_SIZE];
+static _Alignas(POOL_ALIGNMENT) uint8_t g_smallBlocks[SMALL_BLOCK_NUM][SMALL_BLOCK_SIZE];
+static _Alignas(POOL_ALIGNMENT) uint8_t g_mediumBlocks[MEDIUM_BLOCK_NUM][MEDIUM_BLOCK_SIZE];
+static _Alignas(POOL_ALIGNMENT) uint8_t g_largeBlocks[LARGE_BLOCK_NUM][LARGE_BLOCK_SIZE];
+static _Alignas(POOL_ALIGNMENT) uint8_t g_frameBlocks[FRAME_BLOCK_NUM][FRAME_BLOCK_SIZE];
+
+#define POOL_CLASS(blocks, size, num) { \
+    .base = (uint8_t *)(blocks), \
+    .end = (uint8_t *)(blocks) + sizeof(blocks), \
+    .lock = PTHREAD_MUTEX_INITIALIZER, \
+    .stats = { .blockSize = (size), .blockNum = (num) } \
+}
+
+/* ordered by block size, the first class that fits is taken */
+static PoolClass g_classes[DMS_POOL_CLASS_NUM] = {
+    POOL_CLASS(g_tinyBlocks, TINY_BLOCK_SIZE, TINY_BLOCK_NUM),
+    POOL_CLASS(g_smallBlocks, SMALL_BLOCK_SIZE, SMALL_BLOCK_NUM),
+    POOL_CLASS(g_mediumBlocks, MEDIUM_BLOCK_SIZE, MEDIUM_BLOCK_NUM),
+    POOL_CLASS(g_largeBlocks, LARGE_BLOCK_SIZE, LARGE_BLOCK_NUM),
+    POOL_CLASS(g_frameBlocks, FRAME_BLOCK_SIZE, FRAME_BLOCK_NUM),
+};
+
+static atomic_uint g_oversized;
+static atomic_uint g_heapFrees;
+
+void *DmsHeapAlloc(size_t size)
+{
+#ifdef WEARABLE_PRODUCT
+    return OhosMalloc(MEM_TYPE_APPFMK_LSRAM, size);
+#else
+    return malloc(size);
+#endif
+}
+
+static void HeapFree(void *ptr)
+{
+#ifdef WEARABLE_PRODUCT
+    (void)OhosFree(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static PoolClass *ClassForSize(size_t size)
+{
+    for (uint8_t i = 0; i < DMS_POOL_CLASS_NUM; i++) {
+        if (size <= g_classes[i].stats.blockSize) {
+            return &g_classes[i];
+        }
+    }
+    return NULL;
+}
+
+static PoolClass *ClassOf(const void *ptr)
+{
+    const uint8_t *address = (const uint8_t *)ptr;
+    for (uint8_t i = 0; i < DMS_POOL_CLASS_NUM; i++) {
+        if (address >= g_classes[i].base && address < g_classes[i].end) {
+            return &g_classes[i];
+        }
+    }
+    return NULL;
+}
+
+static void *TakeBlock(PoolClass *poolClass, size_t size)
+{
+    pthread_mutex_lock(&poolClass->lock);
+    DmsPoolClassStats *stats = &poolClass->stats;
+    void *block = NULL;
+    if (poolClass->freeList != NULL) {
+        block = poolClass->freeList;
+        poolClass->freeList = poolClass->freeList->next;
+    } else if (poolClass->unused < stats->blockNum) {
+        block = poolClass->base + (size_t)poolClass->unused * stats->blockSize;
+        poolClass->unused++;
+    } else {
+        stats->exhausted++;
+        pthread_mutex_unlock(&poolClass->lock);
+        return NULL;
+    }
+    stats->allocs++;
+    stats->requestedBytes += (uint32_t)size;
+    stats->inUse++;
+    if (stats->inUse > stats->peakInUse) {
+        stats->peakInUse = stats->inUse;
+    }
+    pthread_mutex_unlock(&poolClass->lock);
+    return block;
+}
+
+void *DmsPoolAlloc(size_t size)
+{
+    PoolClass *poolClass = ClassForSize(size);
+    if (poolClass == NULL) {
+        atomic_fetch_add_explicit(&g_oversized, 1, memory_order_relaxed);
+        return DmsHeapAlloc(size);
+    }
+    void *block = TakeBlock(poolClass, size);
+    return (block != NULL) ? block : DmsHeapAlloc(size);
+}
+
+void DmsPoolFree(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    PoolClass *poolClass = ClassOf(ptr);
+    if (poolClass == NULL) {
+        atomic_fetch_add_explicit(&g_heapFrees, 1, memory_order_relaxed);
+        HeapFree(ptr);
+        return;
+    }
+    FreeBlock *block = (FreeBlock *)ptr;
+    pthread_mutex_lock(&poolClass->lock);
+    block->next = poolClass->freeList;
+    poolClass->freeList = block;
+    poolClass->stats.inUse--;
+    pthread_mutex_unlock(&poolClass->lock);
+}
+
+void GetDmsPoolStats(DmsPoolStats *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    for (uint8_t i = 0; i < DMS_POOL_CLASS_NUM; i++) {
+        pthread_mutex_lock(&g_classes[i].lock);
+        stats->classes[i] = g_classes[i].stats;
+        pthread_mutex_unlock(&g_classes[i].lock);
+    }
+    stats->oversized = atomic_load_explicit(&g_oversized, memory_order_relaxed);
+    stats->heapFrees = atomic_load_explicit(&g_heapFrees, memory_order_relaxed);
+}
@@ -16,15 +16,26 @@
 #include "dmslite_session.h"
 
 #include <pthread.h>
+#include <signal.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "dmsfwk_interface.h"
+#include "dmslite_admission.h"
+#include "dmslite_devmgr.h"
+#include "dmslite_event.h"
 #include "dmslite_feature.h"
+#include "dmslite_flow.h"
+#include "dmslite_histogram.h"
+#include "dmslite_ingress.h"
 #include "dmslite_log.h"
 #include "dmslite_packet.h"
 #include "dmslite_parser.h"
+#include "dmslite_permission.h"
+#include "dmslite_stats.h"
 #include "dmslite_utils.h"
+#include "dmslite_worker.h"
 
 #include "securec.h"
 #include "session.h"
@@ -33,14 +44,49 @@
 #define DMS_SESSION_NAME "ohos.distributedschedule.dms.proxymanager"
 #define DMS_MODULE_NAME "dms"
 
-#define INVALID_SESSION_ID (-1)
 #define MAX_DATA_SIZE 1024
-#define TIMEOUT 60
+#define MAX_MESSAGE_MODE_SIZE 128
+#define MAX_PENDING_REQUESTS 16
+#define INVALID_SESSION_ID (-1)
+
+/* every target of a batch runs as its own flow, the batch only aggregates their results */
+typedef struct {
+    /* frames the targets share, released when the last flow of the batch has finished */
+    char *frames[DMS_MAX_BATCH_TARGETS];
+    uint8_t num;
+    uint8_t finished;
+    uint8_t successNum;
+    const IDmsBatchListener *listener;
+} DmsBatch;
+
+static DmsBatch g_batch = { 0 };
 
-static int32_t g_curSessionId = INVALID_SESSION_ID;
-static bool g_curBusy = false;
-static time_t g_begin;
-static IDmsListener *g_listener = NULL;
+/* a request of a peer still waiting for its reply, the slot is free while arriveMs is 0 */
+typedef struct {
+    int32_t sessionId;
+    uint16_t commandId;
+    /* the request came with the fixed header, its reply carries the same request id back */
+    bool framed;
+    uint32_t requestId;
+    /* softbus only takes sends in the mode the session was opened in, so the reply goes back the same way */
+    int32_t dataType;
+    /* a start request holds the queue slot of its peer from being admitted until it is handled */
+    bool admitted;
+    int32_t admissionKey;
+    uint64_t arriveMs;
+} PendingRequest;
+
+/* requests arrive on the softbus thread and are answered on the dms task */
+static pthread_mutex_t g_pendingLock = PTHREAD_MUTEX_INITIALIZER;
+static PendingRequest g_pendingRequests[MAX_PENDING_REQUESTS];
+
+/* armed and handled on the dms task only, g_flowTimerDeadlineMs is 0 while the timer is not armed */
+static timer_t g_flowTimer;
+static bool g_flowTimerCreated = false;
+static uint64_t g_flowTimerDeadlineMs = 0;
+
+/* request ids of the frames sent with the fixed header, only taken on the dms task */
+static uint32_t g_lastRequestId = 0;
 
 /* session callback */
 static void OnBytesReceived(int32_t sessionId, const void *data, uint32_t dataLen);
@@ -48,8 +94,15 @@ static void OnSessionClosed(int32_t sessionId);
 static int32_t OnSessionOpened(int32_t sessionId, int result);
 static void OnMessageReceived(int sessionId, const void *data, unsigned int len);
 
-static bool IsTimeout();
-static void OnStartAbilityDone(int8_t errCode);
+static void OnStartAbilityDone(int32_t sessionId, int8_t errCode);
+static void PostReceivedData(int32_t sessionId, int32_t dataType, const void *data, uint32_t dataLen);
+static int32_t SendDmsFrame(int32_t sessionId, int32_t dataType, const void *data, uint32_t dataLen);
+static int32_t SendDmsReply(int32_t sessionId, int32_t errCode);
+static void ReplyRemoteStart(int32_t sessionId, int32_t errCode);
+static void RecordCalleeLatency(int32_t sessionId, uint16_t commandId);
+static void DropRemoteReply(int32_t sessionId, uint16_t commandId);
+static void OnBatchFlowDone(const DmsFlow *flow, int32_t result);
+static void ArmFlowTimer();
 
 static ISessionListener g_sessionCallback = {
     .OnBytesReceived = OnBytesReceived,
@@ -64,118 +117,565 @@ static IDmsFeatureCallback g_dmsFeatureCallback = {
     .onStartAbilityDone = OnStartAbilityDone,
 };
 
-void OnStartAbilityDone(int8_t errCode)
+/* a start handled on the worker lane hands its reply back, so all sending stays on the dms task */
+static void ReplyRemoteStart(int32_t sessionId, int32_t errCode)
+{
+    if (IsWorkerLaneEnabled()) {
+        int32_t *result = (int32_t *)DMS_ALLOC_SHARED(sizeof(int32_t));
+        if (result == NULL) {
+            DropRemoteReply(sessionId, DMS_MSG_CMD_START_FA);
+            return;
+        }
+        *result = errCode;
+        Request request = {
+            .msgId = REMOTE_START_DONE,
+            .len = sizeof(int32_t),
+            .data = result,
+            .msgValue = sessionId
+        };
+        int32_t ret = SAMGR_SendRequest((const Identity*)&(GetDmsLiteFeature()->identity), &request, NULL);
+        if (ret != EC_SUCCESS) {
+            DMS_FREE(result);
+            HILOGE("[ReplyRemoteStart SendRequest errCode = %d]", ret);
+            DropRemoteReply(sessionId, DMS_MSG_CMD_START_FA);
+        }
+        return;
+    }
+    HandleRemoteStartDone(sessionId, errCode);
+}
+
+void HandleIngressEvent(const DmsIngressEvent *event)
+{
+    switch (event->msgId) {
+        case SESSION_OPEN:
+            HandleSessionOpened(event->sessionId);
+            break;
+        case SESSION_OPEN_FAILED:
+            HandleSessionOpenFailed(event->sessionId);
+            break;
+        case SESSION_CLOSE:
+            HandleSessionClosed(event->sessionId);
+            break;
+        case BYTES_RECEIVED:
+            HandleBytesReceived(event->sessionId, event->data, event->len);
+            break;
+        case REMOTE_START_OVERLOADED:
+            HandleRemoteStartDone(event->sessionId, DMS_EC_OVERLOADED);
+            break;
+        case FLOW_TIMER:
+            /* the one-shot timer is spent, the expiry after the drain arms it again */
+            g_flowTimerDeadlineMs = 0;
+            break;
+        default: {
+            HILOGW("[Unkonwn ingress msgId = %hu]", event->msgId);
+            break;
+        }
+    }
+}
+
+void HandleRemoteStartDone(int32_t sessionId, int32_t errCode)
+{
+    int32_t ret = SendDmsReply(sessionId, errCode);
+    if (ret != 0) {
+        HILOGE("[SendDmsReply errCode = %d]", ret);
+        AddDmsStat(DMS_STAT_REPLY_FAILURES, 1);
+    }
+    RecordCalleeLatency(sessionId, DMS_MSG_CMD_START_FA);
+}
+
+void OnStartAbilityDone(int32_t sessionId, int8_t errCode)
 {
     HILOGD("[onStartAbilityDone errCode = %d]", errCode);
+    ReplyRemoteStart(sessionId, errCode);
 }
 
 void OnBytesReceived(int32_t sessionId, const void *data, uint32_t dataLen)
 {
-    HILOGD("[OnBytesReceived dataLen = %u]", dataLen);
+    RecordDmsEvent(DMS_EVENT_BYTES_RECEIVED, sessionId, (int32_t)dataLen);
+    PostReceivedData(sessionId, TYPE_BYTES, data, dataLen);
+}
+
+/* a refused start is answered from the dms task, the event carries no data so it still fits a busy ring */
+static void RefuseRemoteStart(int32_t sessionId)
+{
+    int32_t result = PushIngressEvent(REMOTE_START_OVERLOADED, sessionId, NULL, 0);
+    if (result != EC_SUCCESS) {
+        HILOGE("[RefuseRemoteStart errCode = %d]", result);
+    }
+}
+
+static bool IsAnsweredRequest(uint16_t commandId)
+{
+    return commandId == DMS_MSG_CMD_START_FA || commandId == DMS_MSG_CMD_CAPABILITY_REQUEST;
+}
+
+/* callers hold g_pendingLock */
+static PendingRequest *FindPendingRequest(int32_t sessionId, uint16_t commandId)
+{
+    for (uint8_t i = 0; i < MAX_PENDING_REQUESTS; i++) {
+        PendingRequest *request = &g_pendingRequests[i];
+        if (request->arriveMs != 0 && request->sessionId == sessionId && request->commandId == commandId) {
+            return request;
+        }
+    }
+    return NULL;
+}
+
+/* callers hold g_pendingLock */
+static void ReleaseRequestAdmission(PendingRequest *request)
+{
+    if (request->admitted) {
+        request->admitted = false;
+        ReleaseAdmission(ADMISSION_REMOTE, request->admissionKey);
+    }
+}
+
+/* a request that never gets its reply keeps its slot until it is the oldest one and a new request needs it */
+static void MarkRequestArrival(int32_t sessionId, uint16_t commandId, int32_t dataType, const DmsFrameHeader *header)
+{
+    pthread_mutex_lock(&g_pendingLock);
+    PendingRequest *slot = FindPendingRequest(sessionId, commandId);
+    if (slot == NULL) {
+        slot = &g_pendingRequests[0];
+        for (uint8_t i = 1; i < MAX_PENDING_REQUESTS; i++) {
+            if (g_pendingRequests[i].arriveMs < slot->arriveMs) {
+                slot = &g_pendingRequests[i];
+            }
+        }
+        /* an evicted start gives its queue slot back, it may still be handled but is counted no more */
+        ReleaseRequestAdmission(slot);
+    }
+    slot->sessionId = sessionId;
+    slot->commandId = commandId;
+    slot->framed = (header != NULL);
+    slot->requestId = (header != NULL) ? header->requestId : 0;
+    slot->dataType = dataType;
+    slot->arriveMs = GetMonotonicMs();
+    pthread_mutex_unlock(&g_pendingLock);
+}
+
+/* the reply to a request follows the format and the session mode the request came in */
+static bool GetPendingRequest(int32_t sessionId, uint16_t commandId, uint32_t *requestId, int32_t *dataType)
+{
+    bool framed = false;
+    /* a request that is no longer pending came on a session a peer opened to start an ability */
+    *dataType = TYPE_BYTES;
+    pthread_mutex_lock(&g_pendingLock);
+    const PendingRequest *request = FindPendingRequest(sessionId, commandId);
+    if (request != NULL) {
+        framed = request->framed;
+        *requestId = request->requestId;
+        *dataType = request->dataType;
+    }
+    pthread_mutex_unlock(&g_pendingLock);
+    return framed;
+}
+
+/* frees the slot of an answered request, returns 0 when the request was not pending */
+static uint64_t TakePendingRequest(int32_t sessionId, uint16_t commandId)
+{
+    uint64_t arriveMs = 0;
+    pthread_mutex_lock(&g_pendingLock);
+    PendingRequest *request = FindPendingRequest(sessionId, commandId);
+    if (request != NULL) {
+        arriveMs = request->arriveMs;
+        request->arriveMs = 0;
+        ReleaseRequestAdmission(request);
+    }
+    pthread_mutex_unlock(&g_pendingLock);
+    return arriveMs;
+}
+
+/*
+ * the quota of a peer has to hold across the sessions it opens, so it is keyed by the networkId of the
+ * session. the key is kept with the pending request, the session may be gone when the start is released
+ */
+static bool AdmitRemoteStart(int32_t sessionId)
+{
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    int32_t key = sessionId;
+    if (GetPeerDeviceId(sessionId, networkId, NETWORK_ID_BUF_LEN) == 0) {
+        key = (int32_t)HashString(networkId, NETWORK_ID_BUF_LEN);
+    }
+    if (!AcquireAdmission(ADMISSION_REMOTE, key)) {
+        return false;
+    }
+    pthread_mutex_lock(&g_pendingLock);
+    PendingRequest *request = FindPendingRequest(sessionId, DMS_MSG_CMD_START_FA);
+    if (request == NULL) {
+        /* already evicted by newer requests, nothing would give the slot back later */
+        ReleaseAdmission(ADMISSION_REMOTE, key);
+    } else {
+        /* a second start on the same session takes over the slot of the first one */
+        ReleaseRequestAdmission(request);
+        request->admitted = true;
+        request->admissionKey = key;
+    }
+    pthread_mutex_unlock(&g_pendingLock);
+    return true;
+}
+
+static void ReleaseRemoteStart(int32_t sessionId)
+{
+    pthread_mutex_lock(&g_pendingLock);
+    PendingRequest *request = FindPendingRequest(sessionId, DMS_MSG_CMD_START_FA);
+    if (request != NULL) {
+        ReleaseRequestAdmission(request);
+    }
+    pthread_mutex_unlock(&g_pendingLock);
+}
+
+/* a reply that never reaches the dms task leaves the peer to its own timeout, but must not keep the slot */
+static void DropRemoteReply(int32_t sessionId, uint16_t commandId)
+{
+    (void)TakePendingRequest(sessionId, commandId);
+    AddDmsStat(DMS_STAT_REPLY_FAILURES, 1);
+}
+
+static void RecordCalleeLatency(int32_t sessionId, uint16_t commandId)
+{
+    uint64_t arriveMs = TakePendingRequest(sessionId, commandId);
+    if (arriveMs == 0) {
+        return;
+    }
+    uint32_t latencyMs = (uint32_t)(GetMonotonicMs() - arriveMs);
+    RecordCommandLatency(commandId, DMS_LATENCY_CALLEE, latencyMs);
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    if (GetPeerDeviceId(sessionId, networkId, NETWORK_ID_BUF_LEN) == 0) {
+        (void)RecordPeerLatency(networkId, DMS_LATENCY_CALLEE, latencyMs);
+    }
+}
+
+static bool AcceptFrameHeader(const void *data, uint16_t dataLen, DmsFrameHeader *header)
+{
+    TlvErrorCode errCode = ReadFrameHeader((const uint8_t *)data, dataLen, header);
+    if (errCode == DMS_TLV_SUCCESS && !IsKnownCommand(header->commandId)) {
+        errCode = DMS_TLV_ERR_UNKNOWN_TYPE;
+    }
+    if (errCode != DMS_TLV_SUCCESS) {
+        RecordDmsEvent(DMS_EVENT_PARSE_DONE, errCode, dataLen);
+        CountParseError(errCode);
+        return false;
+    }
+    return true;
+}
+
+/* frames received here belong to the peer, failures are never reported to the local listener */
+static void PostReceivedData(int32_t sessionId, int32_t dataType, const void *data, uint32_t dataLen)
+{
     if (data == NULL || dataLen > MAX_DATA_SIZE) {
-        HILOGE("[OnBytesReceived param error");
-        InvokeCallback(NULL, DMS_EC_INVALID_PARAMETER);
+        HILOGE("[PostReceivedData param error");
         return;
     }
-    char *message = (char *)DMS_ALLOC(dataLen);
-    if (message == NULL) {
-        InvokeCallback(NULL, DMS_EC_FAILURE);
+    AddDmsStat(DMS_STAT_MESSAGES_IN, 1);
+    AddDmsStat(DMS_STAT_BYTES_IN, dataLen);
+    /* frames with the fixed header are refused before anything is allocated or queued for them */
+    DmsFrameHeader header;
+    bool framed = HasFrameHeader((const uint8_t *)data, (uint16_t)dataLen);
+    if (framed && !AcceptFrameHeader(data, (uint16_t)dataLen, &header)) {
         return;
     }
-    if (memcpy_s(message, dataLen, (char *)data, dataLen) != EOK) {
+    uint16_t commandId = framed ? header.commandId : PeekCommandId((const uint8_t *)data, (uint16_t)dataLen);
+    if (IsAnsweredRequest(commandId)) {
+        MarkRequestArrival(sessionId, commandId, dataType, framed ? &header : NULL);
+    }
+    bool isStart = (commandId == DMS_MSG_CMD_START_FA);
+    if (isStart && !AdmitRemoteStart(sessionId)) {
+        RefuseRemoteStart(sessionId);
+        return;
+    }
+    /* start requests may take a bms query, they go to the worker lane if there is one */
+    bool toWorker = isStart && IsWorkerLaneEnabled();
+    char *message = (char *)(toWorker ? DMS_ALLOC_SHARED(dataLen) : DMS_ALLOC(dataLen));
+    if (message == NULL || memcpy_s(message, dataLen, (char *)data, dataLen) != EOK) {
         DMS_FREE(message);
-        InvokeCallback(NULL, DMS_EC_FAILURE);
+        if (isStart) {
+            ReleaseRemoteStart(sessionId);
+        }
         return;
     }
-    Request request = {
-        .msgId = BYTES_RECEIVED,
-        .len = dataLen,
-        .data = message,
-        .msgValue = sessionId
-    };
-    int32_t result = SAMGR_SendRequest((const Identity*)&(GetDmsLiteFeature()->identity), &request, NULL);
+    int32_t result;
+    if (toWorker) {
+        Request request = {
+            .msgId = BYTES_RECEIVED,
+            .len = dataLen,
+            .data = message,
+            .msgValue = sessionId
+        };
+        result = SAMGR_SendRequest(GetStartLaneIdentity(), &request, NULL);
+    } else {
+        result = PushIngressEvent(BYTES_RECEIVED, sessionId, message, dataLen);
+    }
     if (result != EC_SUCCESS) {
         DMS_FREE(message);
-        InvokeCallback(NULL, DMS_EC_FAILURE);
-        HILOGD("[OnBytesReceived errCode = %d]", result);
+        HILOGD("[PostReceivedData errCode = %d]", result);
+        if (isStart) {
+            ReleaseRemoteStart(sessionId);
+            RefuseRemoteStart(sessionId);
+        }
     }
 }
 
+/* a reply with the fixed header has to carry the request id of the frame the flow of its session sent */
+static bool IsExpectedReply(int32_t sessionId, const void *data, uint16_t dataLen)
+{
+    DmsFrameHeader reply;
+    DmsFrameHeader request;
+    const DmsFlow *flow = FindFlowBySession(sessionId);
+    if (flow == NULL || ReadFrameHeader((const uint8_t *)data, dataLen, &reply) != DMS_TLV_SUCCESS
+        || reply.commandId != DMS_MSG_CMD_REPLY
+        || ReadFrameHeader((const uint8_t *)flow->frame, flow->frameLen, &request) != DMS_TLV_SUCCESS) {
+        return true;
+    }
+    return reply.requestId == request.requestId;
+}
+
 void HandleBytesReceived(int32_t sessionId, const void *data, uint32_t dataLen)
 {
+    uint16_t commandId = PeekCommandId((const uint8_t *)data, dataLen);
+    /* starts may run on the worker task, only replies stay on the dms task and are matched against its flows */
+    if (commandId == DMS_MSG_CMD_REPLY && !IsExpectedReply(sessionId, data, (uint16_t)dataLen)) {
+        HILOGW("[HandleBytesReceived reply to another request]");
+        return;
+    }
     CommuMessage commuMessage;
     commuMessage.payloadLength = dataLen;
     commuMessage.payload = (uint8_t *)data;
+    commuMessage.sessionId = sessionId;
     int32_t errCode = ProcessCommuMsg(&commuMessage, &g_dmsFeatureCallback);
-    HILOGI("[ProcessCommuMsg errCode = %d]", errCode);
+    RecordDmsEvent(DMS_EVENT_COMMAND_DONE, sessionId, errCode);
+
+    if (commandId != DMS_MSG_CMD_START_FA) {
+        return;
+    }
+    ReleaseRemoteStart(sessionId);
+    /* a start request that failed before being scheduled is answered right away */
+    if (errCode != DMS_EC_START_ABILITY_ASYNC_SUCCESS) {
+        ReplyRemoteStart(sessionId, errCode);
+    }
 }
 
 void OnSessionClosed(int32_t sessionId)
 {
-    Request request = {
-        .msgId = SESSION_CLOSE,
-        .len = 0,
-        .data = NULL,
-        .msgValue = sessionId
-    };
-    int32_t result = SAMGR_SendRequest((const Identity*)&(GetDmsLiteFeature()->identity), &request, NULL);
+    /* a lost event leaves the flow to its timeout */
+    int32_t result = PushIngressEvent(SESSION_CLOSE, sessionId, NULL, 0);
     if (result != EC_SUCCESS) {
-        InvokeCallback(NULL, DMS_EC_FAILURE);
-        HILOGD("[OnSessionClosed SendRequest errCode = %d]", result);
+        HILOGD("[OnSessionClosed PushIngressEvent errCode = %d]", result);
     }
 }
 
 void HandleSessionClosed(int32_t sessionId)
 {
-    if (g_curSessionId == sessionId && !g_curBusy) {
-        g_curSessionId = INVALID_SESSION_ID;
-        g_listener = NULL;
-        g_curBusy = false;
+    DmsFlow *flow = FindFlowBySession(sessionId);
+    if (flow == NULL) {
+        /* sessions of flows are counted when the flow closes them */
+        AddDmsStat(DMS_STAT_SESSION_CLOSES, 1);
+        return;
     }
+    /* closed by the peer before it replied */
+    (void)AdvanceFlow(flow, FLOW_EVENT_FAIL, DMS_EC_FAILURE);
 }
 
 int32_t OnSessionOpened(int32_t sessionId, int32_t result)
 {
     HILOGD("[OnSessionOpened result = %d]", result);
-    if (sessionId < 0 || result != 0) {
-        InvokeCallback(NULL, DMS_EC_INVALID_PARAMETER);
+    if (sessionId < 0) {
         HILOGD("[OnSessionOpened errCode = %d]", result);
         return result;
     }
 
-    Request request = {
-        .msgId = SESSION_OPEN,
-        .len = 0,
-        .data = NULL,
-        .msgValue = sessionId
-    };
-    int32_t ret = SAMGR_SendRequest((const Identity*)&(GetDmsLiteFeature()->identity), &request, NULL);
+    /* failures are routed on the dms task as well, the flow of the session lives there */
+    int32_t ret = PushIngressEvent((result == 0) ? SESSION_OPEN : SESSION_OPEN_FAILED, sessionId, NULL, 0);
     if (ret != EC_SUCCESS) {
-        InvokeCallback(NULL, DMS_EC_FAILURE);
-        HILOGD("[OnSessionOpened SendRequest errCode = %d]", ret);
+        HILOGD("[OnSessionOpened PushIngressEvent errCode = %d]", ret);
+    }
+    return (result == 0) ? ret : result;
+}
+
+void HandleSessionOpenFailed(int32_t sessionId)
+{
+    AddDmsStat(DMS_STAT_SESSION_OPEN_FAILURES, 1);
+    (void)AdvanceFlow(FindFlowBySession(sessionId), FLOW_EVENT_FAIL, DMS_REC_OPEN_SESSION_FAIL);
+}
+
+/* the rtt covers the frame on the wire only, the latency the whole flow from the request being made */
+static void RecordReplyLatency(const DmsFlow *flow)
+{
+    uint64_t nowMs = GetMonotonicMs();
+    uint32_t latencyMs = (uint32_t)(nowMs - flow->beginMs);
+    RecordCommandLatency(PeekCommandId((const uint8_t *)flow->frame, flow->frameLen), DMS_LATENCY_CALLER, latencyMs);
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    if (GetPeerDeviceId(flow->sessionId, networkId, NETWORK_ID_BUF_LEN) != 0) {
+        return;
+    }
+    if (flow->sendMs != 0) {
+        (void)RecordPeerRtt(networkId, (uint32_t)(nowMs - flow->sendMs));
+    }
+    (void)RecordPeerLatency(networkId, DMS_LATENCY_CALLER, latencyMs);
+}
+
+bool HandleFlowReply(int32_t sessionId, int32_t result)
+{
+    DmsFlow *flow = FindFlowBySession(sessionId);
+    if (flow == NULL) {
+        return false;
+    }
+    RecordReplyLatency(flow);
+    return AdvanceFlow(flow, FLOW_EVENT_REPLY, result);
+}
+
+int32_t SendDmsCapability(int32_t sessionId, int32_t dataType, uint16_t commandId)
+{
+    if (sessionId < 0) {
+        return EC_FAILURE;
+    }
+    if (!PreprareBuild()) {
+        return EC_FAILURE;
     }
+    int32_t ret = EC_FAILURE;
+    if (MarshallUint16(commandId, COMMAND_ID)
+        && MarshallUint16(DMS_VERSION_VALUE, DMS_VERSION)
+        && MarshallUint16(MAX_DMS_MSG_LENGTH, MAX_FRAME_SIZE)
+        && MarshallUint32(DMS_LOCAL_FEATURES, FEATURE_FLAGS)) {
+        ret = SendDmsFrame(sessionId, dataType, GetPacketBufPtr(), GetPacketSize());
+    }
+    CleanBuild();
     return ret;
 }
 
+int32_t HandlePeerCapability(int32_t sessionId, const DmsPeerCapability *capability, bool needResponse)
+{
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    if (capability == NULL || GetPeerDeviceId(sessionId, networkId, NETWORK_ID_BUF_LEN) != 0) {
+        return DMS_EC_FAILURE;
+    }
+    if (UpdatePeerCapability(networkId, capability) != EC_SUCCESS) {
+        HILOGW("[HandlePeerCapability peer is not online]");
+    }
+    if (!needResponse) {
+        return DMS_EC_SUCCESS;
+    }
+    uint32_t requestId = 0;
+    int32_t dataType = TYPE_BYTES;
+    (void)GetPendingRequest(sessionId, DMS_MSG_CMD_CAPABILITY_REQUEST, &requestId, &dataType);
+    int32_t ret = SendDmsCapability(sessionId, dataType, DMS_MSG_CMD_CAPABILITY_RESPONSE);
+    if (ret != 0) {
+        AddDmsStat(DMS_STAT_REPLY_FAILURES, 1);
+    }
+    RecordCalleeLatency(sessionId, DMS_MSG_CMD_CAPABILITY_REQUEST);
+    return (ret == 0) ? DMS_EC_SUCCESS : DMS_EC_FAILURE;
+}
+
+/* records the session on the peer, the opening side also starts the one-time capability exchange */
+static void LinkSessionToPeer(int32_t sessionId, int32_t dataType, bool isOpener)
+{
+    char networkId[NETWORK_ID_BUF_LEN] = { 0 };
+    if (GetPeerDeviceId(sessionId, networkId, NETWORK_ID_BUF_LEN) != 0) {
+        return;
+    }
+    (void)UpdatePeerLink(networkId, sessionId);
+    if (isOpener && ClaimPeerCapabilityRequest(networkId, sessionId)) {
+        int32_t ret = SendDmsCapability(sessionId, dataType, DMS_MSG_CMD_CAPABILITY_REQUEST);
+        HILOGD("[SendDmsCapability errCode = %d]", ret);
+        if (ret != 0) {
+            ReleasePeerCapabilityRequest(sessionId);
+        }
+    }
+    /* a peer usually starts the same callee again, fetch its bundle info while the frame is in flight */
+    char bundleName[MAX_PEER_BUNDLE_LEN] = { 0 };
+    if (!isOpener && GetPeerLastBundle(networkId, bundleName, MAX_PEER_BUNDLE_LEN) == EC_SUCCESS) {
+        PrefetchCalleeBundleInfo(bundleName);
+    }
+}
+
+int32_t GetSessionPeerId(int32_t sessionId, char *networkId, uint16_t len)
+{
+    if (sessionId < 0 || networkId == NULL || GetPeerDeviceId(sessionId, networkId, len) != 0) {
+        return EC_FAILURE;
+    }
+    return EC_SUCCESS;
+}
+
 int32_t HandleSessionOpened(int32_t sessionId)
 {
-    if (g_curSessionId != sessionId) {
-        InvokeCallback(NULL, DMS_EC_INVALID_PARAMETER);
+    AddDmsStat(DMS_STAT_SESSION_OPENS, 1);
+    DmsFlow *flow = FindFlowBySession(sessionId);
+    if (flow == NULL) {
+        /* opened by a peer to start an ability here */
+        LinkSessionToPeer(sessionId, TYPE_BYTES, false);
         return EC_SUCCESS;
     }
-    int32_t ret = SendBytes(g_curSessionId, GetPacketBufPtr(), GetPacketSize());
+    LinkSessionToPeer(sessionId, flow->dataType, true);
+    if (!AdvanceFlow(flow, FLOW_EVENT_OPENED, DMS_EC_SUCCESS)) {
+        return EC_FAILURE;
+    }
+    int32_t ret = SendDmsFrame(sessionId, flow->dataType, flow->frame, flow->frameLen);
     if (ret != 0) {
-        InvokeCallback(NULL, DMS_EC_FAILURE);
-        HILOGD("[OnSessionOpened SendBytes errCode = %d]", ret);
-        CloseDMSSession();
+        HILOGD("[OnSessionOpened SendDmsFrame errCode = %d]", ret);
+        (void)AdvanceFlow(flow, FLOW_EVENT_FAIL, DMS_EC_FAILURE);
+        return ret;
     }
-    CleanBuild();
+    flow->sendMs = GetMonotonicMs();
+    (void)AdvanceFlow(flow, FLOW_EVENT_SEND_DONE, DMS_EC_SUCCESS);
     return ret;
 }
 
 void OnMessageReceived(int32_t sessionId, const void *data, uint32_t len)
 {
-    return;
+    RecordDmsEvent(DMS_EVENT_BYTES_RECEIVED, sessionId, (int32_t)len);
+    PostReceivedData(sessionId, TYPE_MESSAGE, data, len);
+}
+
+static int32_t SendDmsFrame(int32_t sessionId, int32_t dataType, const void *data, uint32_t dataLen)
+{
+    AddDmsStat(DMS_STAT_MESSAGES_OUT, 1);
+    AddDmsStat(DMS_STAT_BYTES_OUT, dataLen);
+    if (dataType == TYPE_MESSAGE) {
+        return SendMessage(sessionId, data, dataLen);
+    }
+    return SendBytes(sessionId, data, dataLen);
+}
+
+static int32_t SendDmsReply(int32_t sessionId, int32_t errCode)
+{
+    if (sessionId < 0) {
+        return EC_FAILURE;
+    }
+    if (!PreprareBuild()) {
+        return EC_FAILURE;
+    }
+    uint32_t requestId = 0;
+    int32_t dataType = TYPE_BYTES;
+    bool framed = GetPendingRequest(sessionId, DMS_MSG_CMD_START_FA, &requestId, &dataType);
+    int32_t ret = EC_FAILURE;
+    if (MarshallUint16(DMS_MSG_CMD_REPLY, COMMAND_ID)
+        && MarshallUint16(DMS_VERSION_VALUE, DMS_VERSION)
+        && (errCode != DMS_EC_OVERLOADED || MarshallUint32(GetRetryAfterMs(), RETRY_AFTER))
+        && MarshallInt32(errCode, REPLY_ERR_CODE)
+        && (!framed || PrependFrameHeader(DMS_MSG_CMD_REPLY, requestId))) {
+        ret = SendDmsFrame(sessionId, dataType, GetPacketBufPtr(), GetPacketSize());
+    }
+    CleanBuild();
+    return ret;
+}
+
+static bool IsControlFrame(uint16_t commandId)
+{
+    switch (commandId) {
+        case DMS_MSG_CMD_REPLY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int32_t SelectSessionDataType(const char *data, uint16_t len)
+{
+    /* small control frames go through the lighter message mode, everything else keeps using bytes mode */
+    if (data == NULL || len > MAX_MESSAGE_MODE_SIZE) {
+        return TYPE_BYTES;
+    }
+    return IsControlFrame(PeekCommandId((const uint8_t *)data, len)) ? TYPE_MESSAGE : TYPE_BYTES;
 }
 
 int32_t CreateDMSSessionServer()
@@ -188,68 +688,279 @@ int32_t CloseDMSSessionServer()
     return RemoveSessionServer(DMS_MODULE_NAME, DMS_SESSION_NAME);
 }
 
+static void OnSingleFlowDone(const DmsFlow *flow, int32_t result)
+{
+    if (flow->listener != NULL && flow->listener->OnResultCallback != NULL) {
+        flow->listener->OnResultCallback(NULL, result);
+    }
+}
+
+/* opens the session of a flow, its frame goes out once the session is reported open */
+static bool OpenFlowSession(DmsFlow *flow, const char *deviceId)
+{
+    SessionAttribute attr = {
+        .dataType = flow->dataType
+    };
+    int32_t sessionId = OpenSession(DMS_SESSION_NAME, DMS_SESSION_NAME, deviceId, DMS_MODULE_NAME, &attr);
+    if (sessionId < 0) {
+        return false;
+    }
+    flow->sessionId = sessionId;
+    return AdvanceFlow(flow, FLOW_EVENT_OPEN, DMS_EC_SUCCESS);
+}
+
+static bool FitsPeerFrameSize(const char *deviceId, uint16_t len)
+{
+    DmsPeerCapability capability;
+    if (GetPeerCapability(deviceId, &capability) != EC_SUCCESS) {
+        /* every peer accepts frames up to MAX_DATA_SIZE, the same as before negotiation existed */
+        return true;
+    }
+    return len <= capability.maxFrameSize;
+}
+
+/* peers of the fixed header version get it in front of the frames of their flows, if it still fits */
+static bool TakesFrameHeader(const char *deviceId, const char *data, uint16_t len)
+{
+    DmsPeerCapability capability;
+    if (!IsKnownCommand(PeekCommandId((const uint8_t *)data, len))
+        || GetPeerCapability(deviceId, &capability) != EC_SUCCESS) {
+        return false;
+    }
+    return capability.version >= DMS_VERSION_FIXED_HEADER
+        && len + DMS_FRAME_HEADER_LEN <= capability.maxFrameSize && len + DMS_FRAME_HEADER_LEN <= MAX_DATA_SIZE;
+}
+
+/* copies a marshalled frame for a flow, behind a fixed header with a new request id if withHeader is set */
+static char *CopyFlowFrame(const char *data, uint16_t len, bool withHeader, uint16_t *frameLen)
+{
+    uint16_t headerLen = withHeader ? DMS_FRAME_HEADER_LEN : 0;
+    char *frame = (char *)DMS_ALLOC(headerLen + len);
+    if (frame == NULL) {
+        return NULL;
+    }
+    DmsFrameHeader header = {
+        .commandId = PeekCommandId((const uint8_t *)data, len),
+        .bodyLength = len,
+        .requestId = withHeader ? ++g_lastRequestId : 0
+    };
+    if ((withHeader && !WriteFrameHeader(&header, (uint8_t *)frame, headerLen))
+        || memcpy_s(frame + headerLen, len, data, len) != EOK) {
+        DMS_FREE(frame);
+        return NULL;
+    }
+    *frameLen = headerLen + len;
+    return frame;
+}
+
 int32_t SendDmsMessage(const char *data, int32_t len, const char *deviceId, IDmsListener *callback)
 {
     HILOGI("[SendMessage]");
-    if (data == NULL || len > MAX_DATA_SIZE) {
+    if (data == NULL || len <= 0 || len > MAX_DATA_SIZE) {
         HILOGE("[SendMessage params error]");
         return EC_FAILURE;
     }
 
+    if (!FitsPeerFrameSize(deviceId, len)) {
+        HILOGE("[SendMessage frame exceeds the peer limit]");
+        return EC_FAILURE;
+    }
     if (CreateDMSSessionServer() != EC_SUCCESS) {
         HILOGE("[CreateDMSSessionServer error]");
         return EC_FAILURE;
     }
 
-    g_curBusy = true;
-    g_listener = callback;
-    g_begin = time(NULL);
-
-    SessionAttribute attr = {
-        .dataType = TYPE_BYTES
-    };
-    g_curSessionId = OpenSession(DMS_SESSION_NAME, DMS_SESSION_NAME, deviceId, DMS_MODULE_NAME, &attr);
-    if (g_curSessionId < 0) {
-        g_curSessionId = INVALID_SESSION_ID;
-        g_listener = NULL;
-        g_curBusy = false;
+    /* the flow keeps its own copy, so the packet buffer is free for other messages right away */
+    uint16_t frameLen = 0;
+    char *frame = CopyFlowFrame(data, (uint16_t)len, TakesFrameHeader(deviceId, data, (uint16_t)len), &frameLen);
+    if (frame == NULL) {
+        return EC_FAILURE;
+    }
+    DmsFlow *flow = CreateFlow(frame, frameLen, true, OnSingleFlowDone);
+    if (flow == NULL) {
+        DMS_FREE(frame);
+        return EC_FAILURE;
+    }
+    flow->dataType = SelectSessionDataType(frame, frameLen);
+    if (!OpenFlowSession(flow, deviceId)) {
+        /* failed before anything was sent, the caller reports the error itself */
+        flow->listener = NULL;
+        (void)AdvanceFlow(flow, FLOW_EVENT_FAIL, DMS_REC_OPEN_SESSION_FAIL);
         return EC_FAILURE;
     }
+    flow->listener = callback;
+    ArmFlowTimer();
     return EC_SUCCESS;
 }
 
-void CloseDMSSession()
+bool IsDmsBusy()
 {
-    CloseSession(g_curSessionId);
-    g_curSessionId = INVALID_SESSION_ID;
-    g_listener = NULL;
-    g_curBusy = false;
+    (void)ExpireFlows(GetMonotonicMs());
+    return GetActiveFlowNum() >= DMS_MAX_FLOWS;
 }
 
-void InvokeCallback(const void *data, int32_t result)
+/* the timer only wakes the dms task through the ingress ring, a full ring is drained and expires flows anyway */
+static void OnFlowTimer(union sigval value)
 {
-    g_curBusy = false;
-    if (g_listener == NULL) {
+    (void)value;
+    if (PushIngressEvent(FLOW_TIMER, INVALID_SESSION_ID, NULL, 0) != EC_SUCCESS) {
+        HILOGW("[OnFlowTimer ingress ring is full]");
+    }
+}
+
+/* a peer that never answers sends no event either, so the flow timer fires at the oldest flow deadline */
+static void ArmFlowTimer()
+{
+    uint64_t deadlineMs = 0;
+    if (!GetNextFlowDeadline(&deadlineMs) || deadlineMs == g_flowTimerDeadlineMs) {
         return;
     }
-    if (g_listener->OnResultCallback == NULL) {
+    if (!g_flowTimerCreated) {
+        struct sigevent event;
+        (void)memset_s(&event, sizeof(event), 0x00, sizeof(event));
+        event.sigev_notify = SIGEV_THREAD;
+        event.sigev_notify_function = OnFlowTimer;
+        if (timer_create(CLOCK_MONOTONIC, &event, &g_flowTimer) != 0) {
+            HILOGE("[ArmFlowTimer create timer failed]");
+            return;
+        }
+        g_flowTimerCreated = true;
+    }
+    uint64_t nowMs = GetMonotonicMs();
+    uint64_t delayMs = (deadlineMs > nowMs) ? (deadlineMs - nowMs) : 1;
+    struct itimerspec spec;
+    (void)memset_s(&spec, sizeof(spec), 0x00, sizeof(spec));
+    spec.it_value.tv_sec = (time_t)(delayMs / MS_PER_SECOND);
+    spec.it_value.tv_nsec = (long)(delayMs % MS_PER_SECOND) * NS_PER_MS;
+    if (timer_settime(g_flowTimer, 0, &spec, NULL) != 0) {
+        HILOGE("[ArmFlowTimer set timer failed]");
         return;
     }
-    g_listener->OnResultCallback(data, result);
+    g_flowTimerDeadlineMs = deadlineMs;
 }
 
-static bool IsTimeout()
+void ExpireDmsFlows()
 {
-    time_t now = time(NULL);
-    HILOGI("[IsTimeout diff %f]", difftime(now, g_begin));
-    return ((int)difftime(now, g_begin)) - TIMEOUT >= 0;
+    (void)ExpireFlows(GetMonotonicMs());
+    ArmFlowTimer();
 }
 
-bool IsDmsBusy()
+static void ClearBatch()
 {
-    if (g_curBusy && IsTimeout() && g_curSessionId >= 0) {
-        CloseDMSSession();
+    for (uint8_t i = 0; i < g_batch.num; i++) {
+        DMS_FREE(g_batch.frames[i]);
     }
+    if (memset_s(&g_batch, sizeof(DmsBatch), 0x00, sizeof(DmsBatch)) != EOK) {
+        HILOGW("[Batch is not cleared]");
+        g_batch.num = 0;
+    }
+}
 
-    return g_curBusy;
-}
\ No newline at end of file
+static void OnBatchFlowDone(const DmsFlow *flow, int32_t result)
+{
+    if (flow->batchIndex < 0 || flow->batchIndex >= g_batch.num) {
+        return;
+    }
+    g_batch.finished++;
+    if (result == DMS_EC_SUCCESS) {
+        g_batch.successNum++;
+    }
+
+    const IDmsBatchListener *listener = g_batch.listener;
+    if (listener != NULL && listener->OnDeviceResult != NULL) {
+        listener->OnDeviceResult((uint8_t)flow->batchIndex, result);
+    }
+    if (g_batch.finished < g_batch.num) {
+        return;
+    }
+    uint8_t successNum = g_batch.successNum;
+    uint8_t totalNum = g_batch.num;
+    ClearBatch();
+    if (listener != NULL && listener->OnBatchResult != NULL) {
+        listener->OnBatchResult(successNum, totalNum);
+    }
+}
+
+/* a target that never got a flow is reported through the same path as a finished one */
+static void FailBatchTarget(uint8_t index, int32_t result)
+{
+    DmsFlow failed = {
+        .batchIndex = (int8_t)index
+    };
+    OnBatchFlowDone(&failed, result);
+}
+
+static int32_t StartBatchFlow(const DmsBatchEntry *entry, uint8_t index)
+{
+    if (IsPeerBackingOff(entry->deviceId)) {
+        return DMS_EC_OVERLOADED;
+    }
+    if (!FitsPeerFrameSize(entry->deviceId, entry->frameLen)) {
+        return DMS_EC_FAILURE;
+    }
+    /* the frame may be shared with other targets, a peer taking the fixed header gets a copy of its own */
+    char *frame = entry->frame;
+    uint16_t frameLen = entry->frameLen;
+    bool withHeader = TakesFrameHeader(entry->deviceId, entry->frame, entry->frameLen);
+    if (withHeader) {
+        frame = CopyFlowFrame(entry->frame, entry->frameLen, true, &frameLen);
+        if (frame == NULL) {
+            return DMS_EC_FAILURE;
+        }
+    }
+    DmsFlow *flow = CreateFlow(frame, frameLen, withHeader, NULL);
+    if (flow == NULL) {
+        if (withHeader) {
+            DMS_FREE(frame);
+        }
+        return DMS_EC_OVERLOADED;
+    }
+    flow->dataType = SelectSessionDataType(frame, frameLen);
+    if (!OpenFlowSession(flow, entry->deviceId)) {
+        (void)AdvanceFlow(flow, FLOW_EVENT_FAIL, DMS_REC_OPEN_SESSION_FAIL);
+        return DMS_REC_OPEN_SESSION_FAIL;
+    }
+    flow->batchIndex = (int8_t)index;
+    flow->onDone = OnBatchFlowDone;
+    ArmFlowTimer();
+    return DMS_EC_SUCCESS;
+}
+
+int32_t SendDmsBatchMessage(DmsBatchEntry *entries, uint8_t num, const IDmsBatchListener *callback)
+{
+    if (entries == NULL || num == 0 || num > DMS_MAX_BATCH_TARGETS) {
+        return EC_FAILURE;
+    }
+    /* the batch takes over the frames first, so every failure below releases them the same way */
+    ClearBatch();
+    for (uint8_t i = 0; i < num; i++) {
+        g_batch.frames[i] = entries[i].ownsFrame ? entries[i].frame : NULL;
+    }
+    g_batch.num = num;
+    if (CreateDMSSessionServer() != EC_SUCCESS) {
+        HILOGE("[CreateDMSSessionServer error]");
+        ClearBatch();
+        return EC_FAILURE;
+    }
+    g_batch.listener = callback;
+
+    /* sessions open concurrently, each frame goes out as soon as its own session is ready */
+    int32_t results[DMS_MAX_BATCH_TARGETS];
+    for (uint8_t i = 0; i < num; i++) {
+        results[i] = StartBatchFlow(&entries[i], i);
+    }
+    /* report failures only after every target has been tried, the last report ends the batch */
+    for (uint8_t i = 0; i < num; i++) {
+        if (g_batch.num != 0 && results[i] != DMS_EC_SUCCESS) {
+            FailBatchTarget(i, results[i]);
+        }
+    }
+    return EC_SUCCESS;
+}
+
+bool IsDmsBatchBusy()
+{
+    /* timed out flows report their targets, the batch ends with its last one */
+    (void)ExpireFlows(GetMonotonicMs());
+    return (g_batch.num != 0);
+}
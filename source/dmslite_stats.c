@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_stats.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "dmslite_admission.h"
+#include "dmslite_devmgr.h"
+#include "dmslite_histogram.h"
+#include "dmslite_ingress.h"
+#include "dmslite_log.h"
+#include "dmslite_permission.h"
+#include "dmslite_tlv_common.h"
+
+_Static_assert(DMS_PARSE_ERROR_NUM > DMS_TLV_ERR_BAD_HEADER, "every tlv error code needs a counter");
+
+/* plain counters updated from the softbus threads, the dms task and the worker lane, never locked */
+static atomic_uint g_counters[DMS_STAT_COUNTER_NUM];
+static atomic_uint g_parseErrors[DMS_PARSE_ERROR_NUM];
+
+void AddDmsStat(DmsStatCounter counter, uint32_t value)
+{
+    if (counter >= DMS_STAT_COUNTER_NUM) {
+        return;
+    }
+    atomic_fetch_add_explicit(&g_counters[counter], value, memory_order_relaxed);
+}
+
+void CountParseError(int32_t errCode)
+{
+    if (errCode <= 0 || errCode >= DMS_PARSE_ERROR_NUM) {
+        return;
+    }
+    atomic_fetch_add_explicit(&g_parseErrors[errCode], 1, memory_order_relaxed);
+}
+
+static uint32_t ReadCounter(DmsStatCounter counter)
+{
+    return atomic_load_explicit(&g_counters[counter], memory_order_relaxed);
+}
+
+int32_t GetDmsStats(DmsStats *stats)
+{
+    if (stats == NULL) {
+        return DMS_EC_INVALID_PARAMETER;
+    }
+    stats->messagesIn = ReadCounter(DMS_STAT_MESSAGES_IN);
+    stats->bytesIn = ReadCounter(DMS_STAT_BYTES_IN);
+    stats->messagesOut = ReadCounter(DMS_STAT_MESSAGES_OUT);
+    stats->bytesOut = ReadCounter(DMS_STAT_BYTES_OUT);
+    for (uint8_t i = 0; i < DMS_PARSE_ERROR_NUM; i++) {
+        stats->parseErrors[i] = atomic_load_explicit(&g_parseErrors[i], memory_order_relaxed);
+    }
+    stats->permissionDenials = ReadCounter(DMS_STAT_PERMISSION_DENIALS);
+    stats->busyRejections = ReadCounter(DMS_STAT_BUSY_REJECTIONS);
+    stats->timeouts = ReadCounter(DMS_STAT_TIMEOUTS);
+    stats->sessionOpens = ReadCounter(DMS_STAT_SESSION_OPENS);
+    stats->sessionOpenFailures = ReadCounter(DMS_STAT_SESSION_OPEN_FAILURES);
+    stats->sessionCloses = ReadCounter(DMS_STAT_SESSION_CLOSES);
+    stats->replyFailures = ReadCounter(DMS_STAT_REPLY_FAILURES);
+    GetAdmissionStats(ADMISSION_LOCAL, &stats->localStarts);
+    GetAdmissionStats(ADMISSION_REMOTE, &stats->remoteStarts);
+    GetCallerCacheStats(&stats->callerCache);
+    GetCalleeCacheStats(&stats->calleeCache);
+    GetIngressStats(&stats->ingress);
+    return DMS_EC_SUCCESS;
+}
+
+void DumpDmsStats()
+{
+    DmsStats stats;
+    (void)GetDmsStats(&stats);
+    HILOGI("[messages in %u (%u bytes), out %u (%u bytes)]", stats.messagesIn, stats.bytesIn,
+        stats.messagesOut, stats.bytesOut);
+    for (uint8_t i = 1; i < DMS_PARSE_ERROR_NUM; i++) {
+        if (stats.parseErrors[i] != 0) {
+            HILOGI("[parse error %hhu: %u]", i, stats.parseErrors[i]);
+        }
+    }
+    HILOGI("[permission denials %u, busy rejections %u, timeouts %u]", stats.permissionDenials,
+        stats.busyRejections, stats.timeouts);
+    HILOGI("[sessions opened %u, failed to open %u, closed %u, failed replies %u]", stats.sessionOpens,
+        stats.sessionOpenFailures, stats.sessionCloses, stats.replyFailures);
+    HILOGI("[local starts admitted %u, rejected %u, pending %u]", stats.localStarts.admitted,
+        stats.localStarts.rejected, stats.localStarts.pending);
+    HILOGI("[remote starts admitted %u, rejected %u, pending %u]", stats.remoteStarts.admitted,
+        stats.remoteStarts.rejected, stats.remoteStarts.pending);
+    HILOGI("[caller cache hits %u, misses %u, callee cache hits %u, misses %u]", stats.callerCache.hits,
+        stats.callerCache.misses, stats.calleeCache.hits, stats.calleeCache.misses);
+    HILOGI("[ingress events pushed %u, dropped %u, high water %u, wakeups %u, drained %u]", stats.ingress.pushed,
+        stats.ingress.dropped, stats.ingress.highWater, stats.ingress.wakeups, stats.ingress.drained);
+    DumpPeerRejections();
+    DumpCommandLatency();
+}
+
+void ResetDmsLatency()
+{
+    ResetCommandLatency();
+    ResetPeerLatency();
+}
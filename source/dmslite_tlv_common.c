@@ -15,6 +15,7 @@
 
 #include "dmslite_tlv_common.h"
 
+#include "dmslite_event.h"
 #include "dmslite_inner_common.h"
 #include "dmslite_utils.h"
 
@@ -25,16 +26,16 @@
 
 #include "dmslite_log.h"
 
-TlvNode* GetNodeByType(uint8_t nodeType, const TlvNode *tlvHead)
+#define COMMAND_ID_NODE_SIZE (TLV_TYPE_LEN + 1 + INT_16)
+
+/* index of the node of nodeType, or tlvHead->num if there is none */
+static uint8_t GetNodeByType(uint8_t nodeType, const TlvNode *tlvHead)
 {
-    TlvNode* tlvNode = (TlvNode *)tlvHead;
-    while (tlvNode != NULL) {
-        if (tlvNode->type == nodeType) {
-            return tlvNode;
-        }
-        tlvNode = tlvNode->next;
+    uint8_t index = 0;
+    while (index < tlvHead->num && tlvHead->types[index] != nodeType) {
+        index++;
     }
-    return NULL;
+    return index;
 }
 
 static uint64_t ConvertIntDataBig2Little(const uint8_t *dataIn, uint8_t typeSize)
@@ -77,17 +78,115 @@ static uint64_t UnMarshallInt(const TlvNode *tlvHead, uint8_t nodeType, uint8_t
     if (tlvHead == NULL) {
         return 0;
     }
-    TlvNode* tlvNode = GetNodeByType(nodeType, tlvHead);
-    if (tlvNode == NULL || tlvNode->value == NULL) {
+    uint8_t index = GetNodeByType(nodeType, tlvHead);
+    if (index == tlvHead->num || tlvHead->buffer == NULL) {
         HILOGE("[Bad node type %hhu]", nodeType);
         return 0;
     }
-    if (fieldSize != tlvNode->length) {
-        HILOGE("[Mismatched fieldSize=%hhu while nodeLength=%hu]", fieldSize, tlvNode->length);
+    if (fieldSize != tlvHead->lengths[index]) {
+        HILOGE("[Mismatched fieldSize=%hhu while nodeLength=%hu]", fieldSize, tlvHead->lengths[index]);
         return 0;
     }
-    return IsBigEndian() ? ConvertIntByDefault(tlvNode->value, fieldSize)
-        : ConvertIntDataBig2Little(tlvNode->value, fieldSize);
+    const uint8_t *value = tlvHead->buffer + tlvHead->offsets[index];
+    return IsBigEndian() ? ConvertIntByDefault(value, fieldSize) : ConvertIntDataBig2Little(value, fieldSize);
+}
+
+/* offsets of the fields of the fixed header */
+#define HEADER_MAGIC_OFFSET      0
+#define HEADER_VERSION_OFFSET    2
+#define HEADER_FLAGS_OFFSET      3
+#define HEADER_COMMAND_OFFSET    4
+#define HEADER_BODY_LEN_OFFSET   6
+#define HEADER_REQUEST_ID_OFFSET 8
+#define BYTE_BITS                8
+#define BYTE_MASK                0xFF
+
+static void PutUint16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)(value >> BYTE_BITS);
+    buffer[1] = (uint8_t)(value & BYTE_MASK);
+}
+
+static void PutUint32(uint8_t *buffer, uint32_t value)
+{
+    PutUint16(buffer, (uint16_t)(value >> (INT_16 * BYTE_BITS)));
+    PutUint16(buffer + INT_16, (uint16_t)value);
+}
+
+bool HasFrameHeader(const uint8_t *frame, uint16_t length)
+{
+    if (frame == NULL || length < DMS_FRAME_HEADER_LEN) {
+        return false;
+    }
+    uint16_t magic = 0;
+    Convert16DataBig2Little(frame + HEADER_MAGIC_OFFSET, &magic);
+    return magic == DMS_FRAME_MAGIC;
+}
+
+TlvErrorCode ReadFrameHeader(const uint8_t *frame, uint16_t length, DmsFrameHeader *header)
+{
+    if (header == NULL || !HasFrameHeader(frame, length)) {
+        return DMS_TLV_ERR_BAD_HEADER;
+    }
+    header->version = frame[HEADER_VERSION_OFFSET];
+    header->flags = frame[HEADER_FLAGS_OFFSET];
+    Convert16DataBig2Little(frame + HEADER_COMMAND_OFFSET, &header->commandId);
+    Convert16DataBig2Little(frame + HEADER_BODY_LEN_OFFSET, &header->bodyLength);
+    Convert32DataBig2Little(frame + HEADER_REQUEST_ID_OFFSET, &header->requestId);
+    if (header->version != DMS_FRAME_HEADER_VERSION || header->flags != 0) {
+        HILOGE("[Unsupported frame header version %hhu, flags %hhu]", header->version, header->flags);
+        return DMS_TLV_ERR_BAD_HEADER;
+    }
+    if (header->bodyLength != length - DMS_FRAME_HEADER_LEN || length > MAX_DMS_MSG_LENGTH) {
+        HILOGE("[Bad body length %hu of a %hu bytes frame]", header->bodyLength, length);
+        return DMS_TLV_ERR_LEN;
+    }
+    return DMS_TLV_SUCCESS;
+}
+
+bool WriteFrameHeader(const DmsFrameHeader *header, uint8_t *buffer, uint16_t bufferLen)
+{
+    if (header == NULL || buffer == NULL || bufferLen < DMS_FRAME_HEADER_LEN) {
+        return false;
+    }
+    PutUint16(buffer + HEADER_MAGIC_OFFSET, DMS_FRAME_MAGIC);
+    buffer[HEADER_VERSION_OFFSET] = DMS_FRAME_HEADER_VERSION;
+    buffer[HEADER_FLAGS_OFFSET] = header->flags;
+    PutUint16(buffer + HEADER_COMMAND_OFFSET, header->commandId);
+    PutUint16(buffer + HEADER_BODY_LEN_OFFSET, header->bodyLength);
+    PutUint32(buffer + HEADER_REQUEST_ID_OFFSET, header->requestId);
+    return true;
+}
+
+bool IsKnownCommand(uint16_t commandId)
+{
+    switch (commandId) {
+        case DMS_MSG_CMD_START_FA:
+        case DMS_MSG_CMD_CAPABILITY_REQUEST:
+        case DMS_MSG_CMD_CAPABILITY_RESPONSE:
+        case DMS_MSG_CMD_REPLY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint16_t PeekCommandId(const uint8_t *payload, uint16_t length)
+{
+    if (HasFrameHeader(payload, length)) {
+        DmsFrameHeader header;
+        return (ReadFrameHeader(payload, length, &header) == DMS_TLV_SUCCESS) ? header.commandId : 0;
+    }
+    if (payload == NULL || length < COMMAND_ID_NODE_SIZE) {
+        return 0;
+    }
+    /* COMMAND_ID is always the first node and is marshalled with one length byte */
+    if (payload[0] != COMMAND_ID || payload[TLV_TYPE_LEN] != INT_16) {
+        return 0;
+    }
+    uint16_t commandId = 0;
+    Convert16DataBig2Little(payload + TLV_TYPE_LEN + 1, &commandId);
+    return commandId;
 }
 
 uint8_t UnMarshallUint8(const TlvNode *tlvHead, uint8_t nodeType)
@@ -132,20 +231,35 @@ int64_t UnMarshallInt64(const TlvNode *tlvHead, uint8_t nodeType)
 
 const char* UnMarshallString(const TlvNode *tlvHead, uint8_t nodeType)
 {
-    HILOGI("[Get string value for node %hhu]", nodeType);
     if (tlvHead == NULL) {
         return "";
     }
-    TlvNode* tlvNode = GetNodeByType(nodeType, tlvHead);
-    if (tlvNode == NULL || tlvNode->value == NULL) {
+    uint8_t index = GetNodeByType(nodeType, tlvHead);
+    if (index == tlvHead->num || tlvHead->buffer == NULL) {
         HILOGE("[Bad node type %hhu]", nodeType);
         return "";
     }
-    const char* value = (const char*)tlvNode->value;
-    if (value[tlvNode->length - 1] != '\0') {
-        HILOGE("[Non-zero ending string, length:%hu, ending:%d]", tlvNode->length, value[tlvNode->length - 1]);
+    const char* value = (const char*)(tlvHead->buffer + tlvHead->offsets[index]);
+    uint16_t length = tlvHead->lengths[index];
+    if (value[length - 1] != '\0') {
+        HILOGE("[Non-zero ending string, length:%hu, ending:%d]", length, value[length - 1]);
         return "";
     } else {
+        RecordDmsEvent(DMS_EVENT_STRING_FIELD, nodeType, length);
         return value;
     }
+}
+
+const uint8_t *UnMarshallRawData(const TlvNode *tlvHead, uint8_t nodeType, uint16_t *length)
+{
+    if (tlvHead == NULL || length == NULL) {
+        return NULL;
+    }
+    uint8_t index = GetNodeByType(nodeType, tlvHead);
+    if (index == tlvHead->num || tlvHead->buffer == NULL) {
+        HILOGE("[Bad node type %hhu]", nodeType);
+        return NULL;
+    }
+    *length = tlvHead->lengths[index];
+    return tlvHead->buffer + tlvHead->offsets[index];
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2020 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dmslite_worker.h"
+
+#include <stdatomic.h>
+
+#include "dmslite.h"
+#include "dmslite_famgr.h"
+#include "dmslite_feature.h"
+#include "dmslite_log.h"
+#include "dmslite_session.h"
+#include "dmslite_utils.h"
+
+#include "ohos_init.h"
+
+#ifdef DMS_MULTI_WORKER
+#define WORKER_STACK_SIZE 0x1000
+#define WORKER_QUEUE_SIZE 20
+#define EMPTY_SERVICE_NAME ""
+
+static const char *GetName(Service *service);
+static BOOL Initialize(Service *service, Identity identity);
+static BOOL MessageHandle(Service *service, Request *request);
+static TaskConfig GetTaskConfig(Service *service);
+
+static DistributedService g_workerService = {
+    .GetName = GetName,
+    .Initialize = Initialize,
+    .MessageHandle = MessageHandle,
+    .GetTaskConfig = GetTaskConfig
+};
+
+/* set once the worker task is up, read from the softbus callback threads */
+static atomic_bool g_workerReady = false;
+
+static const char *GetName(Service *service)
+{
+    if (service == NULL) {
+        return EMPTY_SERVICE_NAME;
+    }
+    return DMS_WORKER_SERVICE;
+}
+
+static BOOL Initialize(Service *service, Identity identity)
+{
+    if (service == NULL) {
+        return FALSE;
+    }
+
+    ((DistributedService*) service)->identity = identity;
+    atomic_store_explicit(&g_workerReady, true, memory_order_release);
+    return TRUE;
+}
+
+static BOOL MessageHandle(Service *service, Request *request)
+{
+    if (request == NULL || service == NULL) {
+        return FALSE;
+    }
+
+    /* only start requests are routed here, everything else stays on the dms task */
+    switch (request->msgId) {
+        case BYTES_RECEIVED:
+            HandleBytesReceived(request->msgValue, request->data, request->len);
+            break;
+        case START_ABILITY_FROM_REMOTE:
+            HandleStartAbilityFromRemote((const RemoteStartData *)request->data);
+            break;
+        default: {
+            HILOGW("[Unkonwn msgId = %d]", request->msgId);
+            break;
+        }
+    }
+    DMS_HANDOFF(request->data);
+    return TRUE;
+}
+
+static TaskConfig GetTaskConfig(Service *service)
+{
+    TaskConfig config = {LEVEL_HIGH, PRI_NORMAL, WORKER_STACK_SIZE, WORKER_QUEUE_SIZE, SINGLE_TASK};
+    return config;
+}
+
+static void Init()
+{
+    BOOL result = SAMGR_GetInstance()->RegisterService((Service *)&g_workerService);
+    HILOGI("[dms worker start %s]", result ? "success" : "failed");
+}
+SYS_SERVICE_INIT(Init);
+#endif
+
+bool IsWorkerLaneEnabled()
+{
+#ifdef DMS_MULTI_WORKER
+    return atomic_load_explicit(&g_workerReady, memory_order_acquire);
+#else
+    return false;
+#endif
+}
+
+const Identity *GetStartLaneIdentity()
+{
+#ifdef DMS_MULTI_WORKER
+    if (IsWorkerLaneEnabled()) {
+        return (const Identity *)&g_workerService.identity;
+    }
+#endif
+    return (const Identity *)&(GetDmsLiteFeature()->identity);
+}